@@ -5,6 +5,7 @@
 #include <bench/bench.h>
 
 #include <crypto/sha256.h>
+#include <crypto/sha3.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 
@@ -52,6 +53,7 @@ int main(int argc, char **argv) {
     ArgsManager argsman;
     SetupBenchArgs(argsman);
     SHA256AutoDetect();
+    SHA3AutoDetect();
     std::string error;
     if (!argsman.ParseParameters(argc, argv, error)) {
         tfm::format(std::cerr, "Error parsing command line arguments: %s\n",
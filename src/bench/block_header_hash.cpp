@@ -0,0 +1,51 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <primitives/block.h>
+#include <random.h>
+
+#include <vector>
+
+/* Number of headers in a full HEADERS message */
+static const size_t NUM_HEADERS = 2000;
+
+static std::vector<CBlockHeader> CreateHeaders() {
+    FastRandomContext rng(true);
+    std::vector<CBlockHeader> headers(NUM_HEADERS);
+    for (CBlockHeader &header : headers) {
+        header.hashPrevBlock = BlockHash(rng.rand256());
+        header.nBits = rng.rand32();
+        header.SetBlockTime(rng.randbits(48));
+        header.nNonce = rng.rand64();
+        header.nHeaderVersion = 1;
+        header.SetSize(rng.randbits(32));
+        header.nHeight = rng.rand32();
+        header.hashEpochBlock = rng.rand256();
+        header.hashMerkleRoot = rng.rand256();
+        header.hashExtendedMetadata = rng.rand256();
+    }
+    return headers;
+}
+
+static void BlockHeaderHashScalar(benchmark::Bench &bench) {
+    const std::vector<CBlockHeader> headers = CreateHeaders();
+    std::vector<BlockHash> hashes(headers.size());
+    bench.batch(headers.size()).unit("header").run([&] {
+        for (size_t i = 0; i < headers.size(); ++i) {
+            hashes[i] = headers[i].GetHash();
+        }
+    });
+}
+
+static void BlockHeaderHashBatch(benchmark::Bench &bench) {
+    const std::vector<CBlockHeader> headers = CreateHeaders();
+    std::vector<BlockHash> hashes;
+    bench.batch(headers.size()).unit("header").run(
+        [&] { hashes = GetBlockHeaderHashes(headers); });
+}
+
+BENCHMARK(BlockHeaderHashScalar);
+BENCHMARK(BlockHeaderHashBatch);
@@ -0,0 +1,133 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <pow/pow.h>
+#include <random.h>
+#include <tinyformat.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <iostream>
+#include <set>
+#include <vector>
+
+/* Number of block index entries, roughly a year of blocks */
+static const int NUM_BLOCKS = 200000;
+
+static std::vector<BlockHash> CreateHashes() {
+    FastRandomContext rng(true);
+    std::vector<BlockHash> hashes(NUM_BLOCKS);
+    for (BlockHash &hash : hashes) {
+        hash = BlockHash(rng.rand256());
+    }
+    return hashes;
+}
+
+/** Link the entries of hashes into a chain, as LoadBlockIndex does. */
+static CBlockIndex *BuildChain(BlockManager &blockman,
+                               const std::vector<BlockHash> &hashes)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    CBlockIndex *pprev = nullptr;
+    for (const BlockHash &hash : hashes) {
+        CBlockIndex *pindex = blockman.InsertBlockIndex(hash);
+        pindex->pprev = pprev;
+        pindex->nHeight = pprev ? pprev->nHeight + 1 : 0;
+        if (pprev) {
+            pindex->nChainWork = pprev->nChainWork + GetBlockProof(*pindex);
+        }
+        pindex->BuildSkip();
+        pprev = pindex;
+    }
+    return pprev;
+}
+
+// Creating and dropping the whole block index, the in-memory part of loading
+// it at startup.
+static void BlockIndexLoad(benchmark::Bench &bench) {
+    const std::vector<BlockHash> hashes = CreateHashes();
+    LOCK(cs_main);
+    BlockManager blockman;
+    bench.batch(hashes.size()).unit("block").run([&] {
+        BuildChain(blockman, hashes);
+        blockman.Unload();
+    });
+}
+
+static void BlockIndexGetAncestor(benchmark::Bench &bench) {
+    const std::vector<BlockHash> hashes = CreateHashes();
+    LOCK(cs_main);
+    BlockManager blockman;
+    const CBlockIndex *tip = BuildChain(blockman, hashes);
+
+    FastRandomContext rng(true);
+    bench.batch(1000).unit("walk").run([&] {
+        for (int i = 0; i < 1000; ++i) {
+            const CBlockIndex *pindex =
+                tip->GetAncestor(rng.randrange(NUM_BLOCKS));
+            ankerl::nanobench::doNotOptimizeAway(pindex);
+        }
+    });
+}
+
+// Loading the block index from a populated block tree database, as done at
+// startup without a snapshot. The memory held by the index before and after
+// loading it is printed once.
+static void BlockIndexLoadDB(benchmark::Bench &bench) {
+    SelectParams(CBaseChainParams::REGTEST);
+    const Consensus::Params &params = Params().GetConsensus();
+    LOCK(cs_main);
+
+    // Headers need a valid proof of work to be loaded.
+    BlockManager source;
+    std::vector<const CBlockIndex *> blocks;
+    blocks.reserve(NUM_BLOCKS);
+    CBlockIndex *pprev = nullptr;
+    CBlockHeader header;
+    header.nBits = UintToArith256(params.powLimit).GetCompact();
+    for (int height = 0; height < NUM_BLOCKS; ++height) {
+        header.hashPrevBlock = pprev ? pprev->GetBlockHash() : BlockHash();
+        header.nHeight = height;
+        header.SetBlockTime(height);
+        while (!CheckProofOfWork(header.GetHash(), header.nBits, params)) {
+            ++header.nNonce;
+        }
+        CBlockIndex *pindex = source.InsertBlockIndex(header.GetHash());
+        pindex->pprev = pprev;
+        pindex->nHeight = height;
+        pindex->nBits = header.nBits;
+        pindex->nTime = header.GetBlockTime();
+        pindex->nNonce = header.nNonce;
+        blocks.push_back(pindex);
+        pprev = pindex;
+    }
+    CBlockTreeDB db(64 << 20, /* fMemory */ true);
+    // Stamp the empty database with the current version.
+    db.Upgrade(params);
+    db.WriteBatchSync({}, 0, blocks);
+
+    BlockManager blockman;
+    std::set<CBlockIndex *, CBlockIndexWorkComparator> candidates;
+    const size_t memory_before = blockman.DynamicMemoryUsage();
+    size_t memory_after = 0;
+    bench.batch(NUM_BLOCKS).unit("block").run([&] {
+        blockman.LoadBlockIndex(params, db, candidates);
+        memory_after = blockman.DynamicMemoryUsage();
+        candidates.clear();
+        blockman.Unload();
+    });
+    tfm::format(std::cout,
+                "Block index of %d entries: %d bytes before loading, %d bytes "
+                "after (%d bytes per entry)\n",
+                NUM_BLOCKS, memory_before, memory_after,
+                (memory_after - memory_before) / NUM_BLOCKS);
+}
+
+BENCHMARK(BlockIndexLoad);
+BENCHMARK(BlockIndexGetAncestor);
+BENCHMARK(BlockIndexLoadDB);
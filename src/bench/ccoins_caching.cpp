@@ -5,6 +5,7 @@
 #include <bench/bench.h>
 #include <coins.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <script/signingprovider.h>
 #include <test/util/transaction_utils.h>
 
@@ -51,3 +52,33 @@ static void CCoinsCaching(benchmark::Bench &bench) {
 }
 
 BENCHMARK(CCoinsCaching);
+
+// Fill a cache with many coins, read them back and flush it, which exercises
+// the allocation of the cache's entries.
+static void CCoinsCacheAddAccessFlush(benchmark::Bench &bench) {
+    constexpr size_t NUM_COINS = 10000;
+
+    std::vector<COutPoint> outpoints;
+    outpoints.reserve(NUM_COINS);
+    FastRandomContext rng(true);
+    for (size_t i = 0; i < NUM_COINS; ++i) {
+        outpoints.emplace_back(TxId(rng.rand256()), 0);
+    }
+    const CTxOut txout(50 * COIN, CScript() << OP_TRUE);
+
+    CCoinsView coinsDummy;
+    CCoinsViewCache base(&coinsDummy);
+    bench.batch(NUM_COINS).unit("coin").run([&] {
+        CCoinsViewCache coins(&base);
+        for (const COutPoint &outpoint : outpoints) {
+            coins.AddCoin(outpoint, Coin(txout, 1, false), false);
+        }
+        for (const COutPoint &outpoint : outpoints) {
+            assert(!coins.AccessCoin(outpoint).IsSpent());
+        }
+        coins.Flush();
+        base.Flush();
+    });
+}
+
+BENCHMARK(CCoinsCacheAddAccessFlush);
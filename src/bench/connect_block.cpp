@@ -0,0 +1,107 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <config.h>
+#include <consensus/validation.h>
+#include <key.h>
+#include <miner.h>
+#include <pow/pow.h>
+#include <script/interpreter.h>
+#include <script/sighashtype.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+/**
+ * Check a block whose transactions were all seen before, as when connecting a
+ * block made of mempool transactions: every script check is a script cache
+ * hit.
+ */
+static void ConnectBlockAllCached(benchmark::Bench &bench) {
+    TestChain100Setup test_setup;
+    const Config &config = GetConfig();
+    const Consensus::Params &params = config.GetChainParams().GetConsensus();
+
+    // Every input spends an output locked to the same key.
+    const CKey &key = test_setup.coinbaseKey;
+    const CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey())
+                                           << OP_CHECKSIG;
+    const uint32_t flags = WITH_LOCK(
+        cs_main, return GetNextBlockScriptFlags(params, ::ChainActive().Tip()));
+    const auto Sign = [&](CMutableTransaction &tx, const Amount amount) {
+        std::vector<uint8_t> vchSig;
+        uint256 hash;
+        assert(SignatureHash(hash,
+                             std::optional(ScriptExecutionData(scriptPubKey)),
+                             scriptPubKey, CTransaction(tx), 0,
+                             SigHashType().withForkId(), amount, nullptr,
+                             flags));
+        assert(key.SignECDSA(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        tx.vin[0].scriptSig << vchSig;
+    };
+
+    constexpr size_t NUM_SPENDS = 1000;
+    const CTransactionRef &coinbase = test_setup.m_coinbase_txns[0];
+    CMutableTransaction fund;
+    fund.nVersion = 1;
+    fund.vin.resize(1);
+    fund.vin[0].prevout = COutPoint(coinbase->GetId(), 1);
+    const Amount value = coinbase->vout[1].nValue / int64_t(2 * NUM_SPENDS);
+    fund.vout.assign(NUM_SPENDS, CTxOut(value, scriptPubKey));
+    Sign(fund, coinbase->vout[1].nValue);
+    const CBlock fundBlock =
+        test_setup.CreateAndProcessBlock({fund}, scriptPubKey);
+    assert(WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash()) ==
+           fundBlock.GetHash());
+
+    CTxMemPool empty_pool;
+    CBlock block =
+        BlockAssembler(config, empty_pool).CreateNewBlock(scriptPubKey)->block;
+    for (size_t i = 0; i < NUM_SPENDS; i++) {
+        CMutableTransaction spend;
+        spend.nVersion = 1;
+        spend.vin.resize(1);
+        spend.vin[0].prevout = COutPoint(fund.GetId(), i);
+        spend.vout.assign(1, CTxOut(value / 2, scriptPubKey));
+        Sign(spend, value);
+        block.vtx.push_back(MakeTransactionRef(std::move(spend)));
+    }
+    std::sort(block.vtx.begin() + 1, block.vtx.end(),
+              [](const CTransactionRef &txa, const CTransactionRef &txb) {
+                  return txa->GetId() < txb->GetId();
+              });
+    // Claim the fees the spends pay.
+    const Amount fees = int64_t(NUM_SPENDS) * (value - value / 2);
+    CMutableTransaction blockCoinbase(*block.vtx[0]);
+    blockCoinbase.vout[0].nValue += GetBlockSubsidy(block.nBits, params) +
+                                    fees / 2 - block.vtx[0]->GetValueOut();
+    block.vtx[0] = MakeTransactionRef(std::move(blockCoinbase));
+    block.SetSize(::GetSerializeSize(block));
+
+    const BlockValidationOptions validationOptions =
+        BlockValidationOptions(config)
+            .withCheckPoW(false)
+            .withCheckMerkleRoot(false)
+            .withMinerFund(false);
+    LOCK(cs_main);
+    const auto TestBlock = [&] {
+        BlockValidationState state;
+        assert(TestBlockValidity(state, config.GetChainParams(), block,
+                                 ::ChainActive().Tip(), validationOptions));
+    };
+    // Checking the block once fills the script cache.
+    TestBlock();
+
+    bench.minEpochIterations(10).run(TestBlock);
+}
+
+BENCHMARK(ConnectBlockAllCached);
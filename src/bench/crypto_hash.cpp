@@ -38,6 +38,18 @@ static void SHA3_256_1M(benchmark::Bench &bench) {
         [&] { SHA3_256().Write(in).Finalize(hash); });
 }
 
+static void SHA3_256_32b(benchmark::Bench &bench) {
+    std::vector<uint8_t> in(32, 0);
+    bench.batch(in.size()).unit("byte").run(
+        [&] { SHA3_256().Write(in).Finalize(in); });
+}
+
+static void SHA3_256Multi_32b_1024(benchmark::Bench &bench) {
+    std::vector<uint8_t> in(32 * 1024, 0);
+    bench.batch(in.size()).unit("byte").run(
+        [&] { SHA3_256Multi(in.data(), in.data(), 32, 1024); });
+}
+
 static void SHA256_32b(benchmark::Bench &bench) {
     std::vector<uint8_t> in(32, 0);
     bench.batch(in.size()).unit("byte").run(
@@ -84,5 +96,7 @@ BENCHMARK(SHA3_256_1M);
 BENCHMARK(SHA256_32b);
 BENCHMARK(SipHash_32b);
 BENCHMARK(SHA256D64_1024);
+BENCHMARK(SHA3_256_32b);
+BENCHMARK(SHA3_256Multi_32b_1024);
 BENCHMARK(FastRandom_32bit);
 BENCHMARK(FastRandom_1bit);
@@ -22,9 +22,10 @@ struct BlockHash;
  */
 class CBlockIndex {
 public:
-    //! pointer to the hash of the block, if any. Memory is owned by this
-    //! CBlockIndex
-    const BlockHash *phashBlock{nullptr};
+    // Fields are laid out hottest first: the ones read while walking the tree
+    // (GetAncestor, LastCommonAncestor, chain work comparisons) share the
+    // first cache line, and the cold header fields are kept at the end. Within
+    // each group, larger fields come first so that no padding is needed.
 
     //! pointer to the index of the predecessor of this block
     CBlockIndex *pprev{nullptr};
@@ -32,6 +33,43 @@ public:
     //! pointer to the index of some further predecessor of this block
     CBlockIndex *pskip{nullptr};
 
+    //! height of the entry in the chain. The genesis block has height 0
+    int32_t nHeight{0};
+
+    //! Verification status of this block. See enum BlockStatus
+    BlockStatus nStatus{};
+
+    //! (memory only) Total amount of work (expected number of hashes) in the
+    //! chain up to and including this block
+    arith_uint256 nChainWork{};
+
+    //! pointer to the hash of the block, if any. Memory is owned by this
+    //! CBlockIndex
+    const BlockHash *phashBlock{nullptr};
+
+    //! (memory only) Maximum nTime in the chain up to and including this block.
+    int64_t nTimeMax{0};
+
+    //! block header
+    int64_t nTime{0};
+
+private:
+    //! (memory only) Size of all blocks in the chain up to and including this
+    //! block. This value will be non-zero only if and only if transactions for
+    //! this block and all its parents are available.
+    uint64_t nChainSize{0};
+
+public:
+    //! Size of this block.
+    //! Note: in a potential headers-first mode, this number cannot be relied
+    //! upon. It is covered by PoW thought.
+    uint64_t nSize{0};
+
+    uint64_t nNonce{0};
+
+    //! (memory only) block header metadata
+    uint64_t nTimeReceived{0};
+
     //! Which # file this block is stored in (blk?????.dat)
     int nFile{0};
 
@@ -41,10 +79,6 @@ public:
     //! Byte offset within rev?????.dat where this block's undo data is stored
     unsigned int nUndoPos{0};
 
-    //! (memory only) Total amount of work (expected number of hashes) in the
-    //! chain up to and including this block
-    arith_uint256 nChainWork{};
-
     //! Number of transactions in this block.
     //! Note: in a potential headers-first mode, this number cannot be relied
     //! upon
@@ -58,50 +92,31 @@ private:
     //! necessary; won't happen before 2030
     unsigned int nChainTx{0};
 
-    //! (memory only) Size of all blocks in the chain up to and including this
-    //! block. This value will be non-zero only if and only if transactions for
-    //! this block and all its parents are available.
-    uint64_t nChainSize{0};
-
 public:
-    //! Verification status of this block. See enum BlockStatus
-    BlockStatus nStatus{};
-
-    //! block header
     uint32_t nBits{0};
-    int64_t nTime{0};
-    uint16_t nReserved;
-    uint64_t nNonce{0};
-    uint8_t nHeaderVersion{0};
-    //! Size of this block.
-    //! Note: in a potential headers-first mode, this number cannot be relied
-    //! upon. It is covered by PoW thought.
-    uint64_t nSize{0};
-    //! height of the entry in the chain. The genesis block has height 0
-    int32_t nHeight{0};
-    uint256 hashEpochBlock{};
-    uint256 hashMerkleRoot{};
-    uint256 hashExtendedMetadata{};
 
     //! (memory only) Sequential id assigned to distinguish order in which
     //! blocks are received.
     int32_t nSequenceId{0};
 
-    //! (memory only) block header metadata
-    uint64_t nTimeReceived{0};
+    uint16_t nReserved{0};
+    uint8_t nHeaderVersion{0};
 
-    //! (memory only) Maximum nTime in the chain up to and including this block.
-    int64_t nTimeMax{0};
+    //! Cold header fields, only needed to rebuild the header.
+    uint256 hashEpochBlock{};
+    uint256 hashMerkleRoot{};
+    uint256 hashExtendedMetadata{};
 
     explicit CBlockIndex() = default;
 
     explicit CBlockIndex(const CBlockHeader &block)
-        : nBits{block.nBits}, nTime{block.GetBlockTime()},
-          nReserved{block.nReserved}, nNonce{block.nNonce},
-          nHeaderVersion{block.nHeaderVersion}, nSize{block.GetSize()},
-          nHeight{block.nHeight}, hashEpochBlock{block.hashEpochBlock},
+        : nHeight{block.nHeight}, nTime{block.GetBlockTime()},
+          nSize{block.GetSize()}, nNonce{block.nNonce}, nTimeReceived{0},
+          nBits{block.nBits}, nReserved{block.nReserved},
+          nHeaderVersion{block.nHeaderVersion},
+          hashEpochBlock{block.hashEpochBlock},
           hashMerkleRoot{block.hashMerkleRoot},
-          hashExtendedMetadata{block.hashExtendedMetadata}, nTimeReceived{0} {}
+          hashExtendedMetadata{block.hashExtendedMetadata} {}
 
     FlatFilePos GetBlockPos() const {
         FlatFilePos ret;
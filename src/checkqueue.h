@@ -8,6 +8,7 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <type_traits>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -15,10 +16,35 @@
 
 template <typename T> class CCheckQueueControl;
 
+/**
+ * Checks can defer part of their work, like signature verification, to a
+ * batch owned by the worker running them, which is verified once after each
+ * group of checks the worker takes from the queue. Such checks define a Batch
+ * type, with bool Verify() and void Clear() members, and provide an operator()
+ * taking the batch.
+ */
+template <typename T, typename = void> class CCheckBatch {
+public:
+    bool Run(T &check) { return check(); }
+    bool Verify() { return true; }
+    void Clear() {}
+};
+
+template <typename T>
+class CCheckBatch<T, std::void_t<typename T::Batch>> {
+private:
+    typename T::Batch batch;
+
+public:
+    bool Run(T &check) { return check(batch); }
+    bool Verify() { return batch.Verify(); }
+    void Clear() { batch.Clear(); }
+};
+
 /**
  * Queue for verifications that have to be performed.
  * The verifications are represented by a type T, which must provide an
- * operator(), returning a bool.
+ * operator(), returning a bool, or take a batch, see CCheckBatch.
  *
  * One thread (the master) is assumed to push batches of verifications onto the
  * queue, where they are processed by N-1 worker threads. When the master is
@@ -64,6 +90,7 @@ private:
         boost::condition_variable &cond = fMaster ? condMaster : condWorker;
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
+        CCheckBatch<T> batch;
         unsigned int nNow = 0;
         bool fOk = true;
         do {
@@ -122,9 +149,14 @@ private:
             // execute work
             for (T &check : vChecks) {
                 if (fOk) {
-                    fOk = check();
+                    fOk = batch.Run(check);
                 }
             }
+            // complete the work the checks deferred
+            if (fOk) {
+                fOk = batch.Verify();
+            }
+            batch.Clear();
             vChecks.clear();
         } while (true);
     }
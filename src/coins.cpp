@@ -61,7 +61,10 @@ SaltedOutpointHasher::SaltedOutpointHasher()
       k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
 CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn)
-    : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+    : CCoinsViewBacked(baseIn),
+      cacheCoins(0, SaltedOutpointHasher(), CCoinsMap::key_equal(),
+                 &m_cache_coins_memory_resource),
+      cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
@@ -141,6 +144,19 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin coin,
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
 }
 
+void CCoinsViewCache::CacheCoin(const COutPoint &outpoint, Coin &&coin) {
+    assert(!coin.IsSpent());
+    CCoinsMap::iterator it;
+    bool inserted;
+    std::tie(it, inserted) =
+        cacheCoins.emplace(std::piecewise_construct,
+                           std::forward_as_tuple(outpoint), std::tuple<>());
+    if (inserted) {
+        it->second.coin = std::move(coin);
+        cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    }
+}
+
 void AddCoins(CCoinsViewCache &cache, const CTransaction &tx, int nHeight,
               bool check_for_overwrite) {
     bool fCoinbase = tx.IsCoinBase();
@@ -272,9 +288,46 @@ bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
     cachedCoinsUsage = 0;
+    // The pool keeps the memory of the cleared entries, give it back.
+    ReallocateCache();
     return fOk;
 }
 
+void CCoinsViewCache::Freeze(CCoinsMapGeneration &generation, bool wipe) {
+    generation.hashBlock = GetBestBlock();
+    for (CCoinsMap::iterator it = cacheCoins.begin();
+         it != cacheCoins.end();) {
+        CCoinsCacheEntry &entry = it->second;
+        // Spent FRESH coins are unknown to the base, they can just be dropped.
+        if ((entry.flags & CCoinsCacheEntry::DIRTY) &&
+            !((entry.flags & CCoinsCacheEntry::FRESH) &&
+              entry.coin.IsSpent())) {
+            CCoinsCacheEntry &frozen = generation.coins[it->first];
+            if (wipe) {
+                frozen.coin = std::move(entry.coin);
+            } else {
+                frozen.coin = entry.coin;
+            }
+            frozen.flags = CCoinsCacheEntry::DIRTY;
+            generation.cachedCoinsUsage += frozen.coin.DynamicMemoryUsage();
+        }
+        if (wipe) {
+            ++it;
+        } else if (entry.coin.IsSpent()) {
+            cachedCoinsUsage -= entry.coin.DynamicMemoryUsage();
+            it = cacheCoins.erase(it);
+        } else {
+            entry.flags = 0;
+            ++it;
+        }
+    }
+    if (wipe) {
+        cacheCoins.clear();
+        cachedCoinsUsage = 0;
+        ReallocateCache();
+    }
+}
+
 void CCoinsViewCache::Uncache(const COutPoint &outpoint) {
     CCoinsMap::iterator it = cacheCoins.find(outpoint);
     if (it != cacheCoins.end() && it->second.flags == 0) {
@@ -305,7 +358,11 @@ void CCoinsViewCache::ReallocateCache() {
     // Cache should be empty when we're calling this.
     assert(cacheCoins.size() == 0);
     cacheCoins.~CCoinsMap();
-    ::new (&cacheCoins) CCoinsMap();
+    m_cache_coins_memory_resource.~CCoinsMapMemoryResource();
+    ::new (&m_cache_coins_memory_resource) CCoinsMapMemoryResource();
+    ::new (&cacheCoins)
+        CCoinsMap(0, SaltedOutpointHasher(), CCoinsMap::key_equal(),
+                  &m_cache_coins_memory_resource);
 }
 
 // TODO: merge with similar definition in undo.h.
@@ -11,6 +11,7 @@
 #include <memusage.h>
 #include <primitives/blockhash.h>
 #include <serialize.h>
+#include <support/allocators/pool.h>
 
 #include <cassert>
 #include <cstdint>
@@ -148,8 +149,37 @@ struct CCoinsCacheEntry {
         : coin(std::move(coinIn)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>
-    CCoinsMap;
+/**
+ * The map nodes are served from a PoolResource, which the map's user must
+ * provide and keep alive. This saves a malloc per cached coin and its
+ * overhead, so more coins fit in -dbcache. Up to 4 pointers are allowed on top
+ * of the key and value, which is what the node of any common std::unordered_map
+ * implementation needs.
+ */
+using CCoinsMap = std::unordered_map<
+    COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>,
+    PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                  sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) +
+                      sizeof(void *) * 4>>;
+
+using CCoinsMapMemoryResource = CCoinsMap::allocator_type::ResourceType;
+
+/**
+ * Dirty coins taken out of a CCoinsViewCache at hashBlock, together with the
+ * memory they live in. See CCoinsViewCache::Freeze.
+ */
+struct CCoinsMapGeneration {
+    CCoinsMapMemoryResource resource;
+    CCoinsMap coins{0, SaltedOutpointHasher(), CCoinsMap::key_equal(),
+                    &resource};
+    BlockHash hashBlock;
+    //! Dynamic memory usage of the coins themselves.
+    size_t cachedCoinsUsage{0};
+
+    size_t DynamicMemoryUsage() const {
+        return memusage::DynamicUsage(coins) + cachedCoinsUsage;
+    }
+};
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor {
@@ -235,6 +265,7 @@ protected:
      * declared as "const".
      */
     mutable BlockHash hashBlock;
+    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource{};
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -285,6 +316,12 @@ public:
      */
     void AddCoin(const COutPoint &outpoint, Coin coin, bool possible_overwrite);
 
+    /**
+     * Cache an unspent coin read from the base view, as if it had been
+     * fetched from there. Does nothing if the outpoint is cached already.
+     */
+    void CacheCoin(const COutPoint &outpoint, Coin &&coin);
+
     /**
      * Spend a coin. Pass moveto in order to get the deleted data.
      * If no unspent output exists for the passed outpoint, this call has no
@@ -300,6 +337,16 @@ public:
      */
     bool Flush();
 
+    /**
+     * Move the modifications applied to this cache into the given generation,
+     * so that they can be written to the base without holding up this cache.
+     * Until they are, the base must serve them itself (see
+     * CCoinsViewDB::WriteInBackground).
+     * If wipe is false, the coins stay cached, clean. Otherwise the cache is
+     * emptied, as by Flush().
+     */
+    void Freeze(CCoinsMapGeneration &generation, bool wipe);
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is not
      * modified.
@@ -3,7 +3,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <consensus/merkle.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
 #include <hash.h>
+#include <streams.h>
+#include <version.h>
+
+#include <cstring>
 
 uint256 ComputeMerkleRoot(std::vector<uint256> hashes, size_t &num_layers) {
     if (hashes.size() == 0) {
@@ -26,11 +32,14 @@ uint256 BlockMerkleRoot(const CBlock &block) {
     std::vector<uint256> leaves;
     leaves.resize(block.vtx.size());
     size_t num_layers;
+    // Each leaf is the hash of the tx hash followed by the txid.
+    std::vector<uint8_t> preimages(block.vtx.size() * 64);
     for (size_t i = 0; i < block.vtx.size(); i++) {
-        CHashWriter leaf_hash(SER_GETHASH, 0);
-        leaf_hash << block.vtx[i]->GetHash();
-        leaf_hash << block.vtx[i]->GetId();
-        leaves[i] = leaf_hash.GetHash();
+        memcpy(&preimages[i * 64], block.vtx[i]->GetHash().begin(), 32);
+        memcpy(&preimages[i * 64 + 32], block.vtx[i]->GetId().begin(), 32);
+    }
+    if (!leaves.empty()) {
+        SHA256DMulti(leaves[0].begin(), preimages.data(), 64, leaves.size());
     }
     return ComputeMerkleRoot(std::move(leaves), num_layers);
 }
@@ -38,11 +47,16 @@ uint256 BlockMerkleRoot(const CBlock &block) {
 uint256 TxInputsMerkleRoot(const std::vector<CTxIn> &vin, size_t &num_layers) {
     std::vector<uint256> leaves;
     leaves.resize(vin.size());
+    // Each leaf is the hash of the serialized prevout and nSequence.
+    std::vector<uint8_t> preimages(vin.size() * 40);
     for (size_t i = 0; i < vin.size(); i++) {
-        CHashWriter leaf_hash(SER_GETHASH, 0);
-        leaf_hash << vin[i].prevout;
-        leaf_hash << vin[i].nSequence;
-        leaves[i] = leaf_hash.GetHash();
+        uint8_t *ptr = &preimages[i * 40];
+        memcpy(ptr, vin[i].prevout.GetTxId().begin(), 32);
+        WriteLE32(ptr + 32, vin[i].prevout.GetN());
+        WriteLE32(ptr + 36, vin[i].nSequence);
+    }
+    if (!leaves.empty()) {
+        SHA256DMulti(leaves[0].begin(), preimages.data(), 40, leaves.size());
     }
     return ComputeMerkleRoot(std::move(leaves), num_layers);
 }
@@ -51,8 +65,29 @@ uint256 TxOutputsMerkleRoot(const std::vector<CTxOut> &vout,
                             size_t &num_layers) {
     std::vector<uint256> leaves;
     leaves.resize(vout.size());
-    for (size_t i = 0; i < vout.size(); i++) {
-        leaves[i] = SerializeHash(vout[i]);
+    std::vector<uint8_t> preimages;
+    std::vector<size_t> offsets;
+    offsets.reserve(vout.size() + 1);
+    for (const CTxOut &output : vout) {
+        offsets.push_back(preimages.size());
+        CVectorWriter(SER_GETHASH, PROTOCOL_VERSION, preimages,
+                      preimages.size(), output);
+    }
+    offsets.push_back(preimages.size());
+
+    // Outputs are variable length, but consecutive outputs usually share the
+    // same script template and hence the same length. Hash each such run in a
+    // single batch.
+    size_t begin = 0;
+    while (begin < vout.size()) {
+        const size_t len = offsets[begin + 1] - offsets[begin];
+        size_t end = begin + 1;
+        while (end < vout.size() && offsets[end + 1] - offsets[end] == len) {
+            end++;
+        }
+        SHA256DMulti(leaves[begin].begin(), &preimages[offsets[begin]], len,
+                     end - begin);
+        begin = end;
     }
     return ComputeMerkleRoot(std::move(leaves), num_layers);
 }
@@ -7,6 +7,7 @@
 #include <compat/cpuid.h>
 #include <crypto/common.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
@@ -22,16 +23,25 @@ namespace sha256d64_sse41 {
 void Transform_4way(uint8_t *out, const uint8_t *in);
 }
 
+namespace sha256_sse41 {
+void Transform_4way(uint32_t *s, const uint8_t *in);
+}
+
 namespace sha256d64_avx2 {
 void Transform_8way(uint8_t *out, const uint8_t *in);
 }
 
+namespace sha256_avx2 {
+void Transform_8way(uint32_t *s, const uint8_t *in);
+}
+
 namespace sha256d64_shani {
 void Transform_2way(uint8_t *out, const uint8_t *in);
 }
 
 namespace sha256_shani {
 void Transform(uint32_t *s, const uint8_t *chunk, size_t blocks);
+void Transform_2way(uint32_t *s, const uint8_t *in);
 }
 
 // Internal implementation code.
@@ -578,6 +588,7 @@ namespace sha256 {
 
 typedef void (*TransformType)(uint32_t *, const uint8_t *, size_t);
 typedef void (*TransformD64Type)(uint8_t *, const uint8_t *);
+typedef void (*TransformMultiType)(uint32_t *, const uint8_t *);
 
 template <TransformType tr>
 void TransformD64Wrapper(uint8_t *out, const uint8_t *in) {
@@ -618,6 +629,71 @@ TransformD64Type TransformD64 = sha256::TransformD64;
 TransformD64Type TransformD64_2way = nullptr;
 TransformD64Type TransformD64_4way = nullptr;
 TransformD64Type TransformD64_8way = nullptr;
+TransformMultiType Transform_2way = nullptr;
+TransformMultiType Transform_4way = nullptr;
+TransformMultiType Transform_8way = nullptr;
+
+/**
+ * Perform one SHA-256 transformation on each of several independent states.
+ * Lane i uses the 8 state words at s + 8 * i and the 64-byte chunk at
+ * in + 64 * i.
+ */
+void TransformMulti(uint32_t *s, const uint8_t *in, size_t lanes) {
+    if (Transform_8way) {
+        while (lanes >= 8) {
+            Transform_8way(s, in);
+            s += 64;
+            in += 512;
+            lanes -= 8;
+        }
+    }
+    if (Transform_4way) {
+        while (lanes >= 4) {
+            Transform_4way(s, in);
+            s += 32;
+            in += 256;
+            lanes -= 4;
+        }
+    }
+    if (Transform_2way) {
+        while (lanes >= 2) {
+            Transform_2way(s, in);
+            s += 16;
+            in += 128;
+            lanes -= 2;
+        }
+    }
+    while (lanes) {
+        Transform(s, in, 1);
+        s += 8;
+        in += 64;
+        --lanes;
+    }
+}
+
+/**
+ * Fill chunk with the 64-byte block number n of the padded SHA-256 message
+ * made of the len bytes at data.
+ */
+void PaddedBlock(uint8_t *chunk, const uint8_t *data, size_t len, size_t n,
+                 size_t blocks) {
+    const size_t offset = 64 * n;
+    if (offset + 64 <= len) {
+        memcpy(chunk, data + offset, 64);
+        return;
+    }
+    const size_t copied = offset < len ? len - offset : 0;
+    if (copied) {
+        memcpy(chunk, data + offset, copied);
+    }
+    memset(chunk + copied, 0, 64 - copied);
+    if (offset <= len) {
+        chunk[copied] = 0x80;
+    }
+    if (n + 1 == blocks) {
+        WriteBE64(chunk + 56, uint64_t(len) << 3);
+    }
+}
 
 bool SelfTest() {
     // Input state (equal to the initial SHA256 state)
@@ -729,6 +805,22 @@ bool SelfTest() {
         }
     }
 
+    // Test TransformMulti() for 0 through 8 lanes, lane i advancing the state
+    // after i chunks by one more chunk.
+    for (size_t i = 0; i <= 8; ++i) {
+        uint32_t states[64];
+        for (size_t j = 0; j < i; ++j) {
+            std::copy(result[j], result[j] + 8, states + 8 * j);
+        }
+        TransformMulti(states, data + 1, i);
+        for (size_t j = 0; j < i; ++j) {
+            if (!std::equal(states + 8 * j, states + 8 * j + 8,
+                            result[j + 1])) {
+                return false;
+            }
+        }
+    }
+
     return true;
 }
 
@@ -780,6 +872,7 @@ std::string SHA256AutoDetect() {
         Transform = sha256_shani::Transform;
         TransformD64 = TransformD64Wrapper<sha256_shani::Transform>;
         TransformD64_2way = sha256d64_shani::Transform_2way;
+        Transform_2way = sha256_shani::Transform_2way;
         ret = "shani(1way,2way)";
         have_sse4 = false; // Disable SSE4/AVX2;
         have_avx2 = false;
@@ -794,6 +887,7 @@ std::string SHA256AutoDetect() {
 #endif
 #if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
         TransformD64_4way = sha256d64_sse41::Transform_4way;
+        Transform_4way = sha256_sse41::Transform_4way;
         ret += ",sse41(4way)";
 #endif
     }
@@ -801,6 +895,7 @@ std::string SHA256AutoDetect() {
 #if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
     if (have_avx2 && have_avx && enabled_avx) {
         TransformD64_8way = sha256d64_avx2::Transform_8way;
+        Transform_8way = sha256_avx2::Transform_8way;
         ret += ",avx2(8way)";
     }
 #endif
@@ -895,3 +990,40 @@ void SHA256D64(uint8_t *out, const uint8_t *in, size_t blocks) {
         --blocks;
     }
 }
+
+void SHA256Multi(uint8_t *out, const uint8_t *in, size_t len, size_t count) {
+    // Number of 64-byte chunks in each padded message.
+    const size_t blocks = (len + 8) / 64 + 1;
+    uint32_t states[8 * 8];
+    uint8_t chunks[8 * 64];
+    while (count) {
+        const size_t lanes = std::min<size_t>(count, 8);
+        for (size_t i = 0; i < lanes; ++i) {
+            sha256::Initialize(states + 8 * i);
+        }
+        for (size_t n = 0; n < blocks; ++n) {
+            for (size_t i = 0; i < lanes; ++i) {
+                PaddedBlock(chunks + 64 * i, in + len * i, len, n, blocks);
+            }
+            TransformMulti(states, chunks, lanes);
+        }
+        for (size_t i = 0; i < 8 * lanes; ++i) {
+            WriteBE32(out + 4 * i, states[i]);
+        }
+        out += 32 * lanes;
+        in += len * lanes;
+        count -= lanes;
+    }
+}
+
+void SHA256DMulti(uint8_t *out, const uint8_t *in, size_t len, size_t count) {
+    uint8_t digests[8 * 32];
+    while (count) {
+        const size_t lanes = std::min<size_t>(count, 8);
+        SHA256Multi(digests, in, len, lanes);
+        SHA256Multi(out, digests, 32, lanes);
+        out += 32 * lanes;
+        in += len * lanes;
+        count -= lanes;
+    }
+}
@@ -39,4 +39,25 @@ std::string SHA256AutoDetect();
  */
 void SHA256D64(uint8_t *output, const uint8_t *input, size_t blocks);
 
+/**
+ * Compute the SHA256's of multiple messages sharing the same length, using the
+ * multi-lane transforms when available.
+ * output:  pointer to a count*32 byte output buffer
+ * input:   pointer to a count*len byte input buffer, messages back to back
+ * len:     the length of each message in bytes
+ * count:   the number of hashes to compute.
+ */
+void SHA256Multi(uint8_t *output, const uint8_t *input, size_t len,
+                 size_t count);
+
+/**
+ * Compute the double-SHA256's of multiple messages sharing the same length.
+ * output:  pointer to a count*32 byte output buffer
+ * input:   pointer to a count*len byte input buffer, messages back to back
+ * len:     the length of each message in bytes
+ * count:   the number of hashes to compute.
+ */
+void SHA256DMulti(uint8_t *output, const uint8_t *input, size_t len,
+                  size_t count);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
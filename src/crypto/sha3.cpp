@@ -5,13 +5,21 @@
 // Based on https://github.com/mjosaarinen/tiny_sha3/blob/master/sha3.c
 // by Markku-Juhani O. Saarinen <mjos@iki.fi>
 
-#include <crypto/common.h>
 #include <crypto/sha3.h>
+
+#include <compat/cpuid.h>
+#include <crypto/common.h>
 #include <span.h>
 
 #include <algorithm>
 #include <array> // For std::begin and std::end.
+#include <cassert>
 #include <cstdint>
+#include <cstring>
+
+namespace sha3_avx2 {
+void KeccakF_4way(uint64_t *st);
+}
 
 // Internal implementation code.
 namespace {
@@ -248,3 +256,137 @@ SHA3_256 &SHA3_256::Reset() {
     std::fill(std::begin(m_state), std::end(m_state), 0);
     return *this;
 }
+
+void (*KeccakF_4way)(uint64_t *st) = nullptr;
+
+namespace {
+//! SHA3-256 sponge rate in bytes.
+constexpr size_t RATE = 136;
+
+/**
+ * Fill block with the RATE-byte block number n of the padded SHA3-256 message
+ * made of the len bytes at data.
+ */
+void PaddedBlock(uint8_t *block, const uint8_t *data, size_t len, size_t n,
+                 size_t blocks) {
+    const size_t offset = RATE * n;
+    if (n + 1 < blocks) {
+        memcpy(block, data + offset, RATE);
+        return;
+    }
+    const size_t copied = len - offset;
+    if (copied) {
+        memcpy(block, data + offset, copied);
+    }
+    memset(block + copied, 0, RATE - copied);
+    block[copied] ^= 0x06;
+    block[RATE - 1] ^= 0x80;
+}
+
+bool SelfTest() {
+    if (!KeccakF_4way) {
+        return true;
+    }
+    uint64_t states[4][25];
+    uint64_t interleaved[4 * 25];
+    for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 25; ++i) {
+            states[j][i] = 0x0123456789abcdefULL * (25 * j + i + 1);
+            interleaved[4 * i + j] = states[j][i];
+        }
+    }
+    for (int round = 0; round < 2; ++round) {
+        for (int j = 0; j < 4; ++j) {
+            KeccakF(states[j]);
+        }
+        KeccakF_4way(interleaved);
+    }
+    for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 25; ++i) {
+            if (interleaved[4 * i + j] != states[j][i]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+#if defined(USE_ASM) &&                                                        \
+    (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled() {
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+std::string SHA3AutoDetect() {
+    std::string ret = "standard";
+#if defined(USE_ASM) && defined(HAVE_GETCPUID)
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)AVXEnabled;
+    (void)have_avx2;
+    (void)enabled_avx;
+
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    have_xsave = (ecx >> 27) & 1;
+    have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+    }
+    GetCPUID(7, 0, eax, ebx, ecx, edx);
+    have_avx2 = (ebx >> 5) & 1;
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && have_avx && enabled_avx) {
+        KeccakF_4way = sha3_avx2::KeccakF_4way;
+        ret += ",avx2(4way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
+void SHA3_256Multi(uint8_t *out, const uint8_t *in, size_t len, size_t count) {
+    // Number of RATE-byte blocks in each padded message.
+    const size_t blocks = len / RATE + 1;
+    if (KeccakF_4way) {
+        uint64_t states[4 * 25];
+        uint8_t block[RATE];
+        while (count >= 4) {
+            std::fill(std::begin(states), std::end(states), 0);
+            for (size_t n = 0; n < blocks; ++n) {
+                for (size_t j = 0; j < 4; ++j) {
+                    PaddedBlock(block, in + len * j, len, n, blocks);
+                    for (size_t i = 0; i < RATE / 8; ++i) {
+                        states[4 * i + j] ^= ReadLE64(block + 8 * i);
+                    }
+                }
+                KeccakF_4way(states);
+            }
+            for (size_t j = 0; j < 4; ++j) {
+                for (size_t i = 0; i < 4; ++i) {
+                    WriteLE64(out + 32 * j + 8 * i, states[4 * i + j]);
+                }
+            }
+            out += 32 * 4;
+            in += len * 4;
+            count -= 4;
+        }
+    }
+    while (count) {
+        SHA3_256().Write({in, len}).Finalize({out, SHA3_256::OUTPUT_SIZE});
+        out += SHA3_256::OUTPUT_SIZE;
+        in += len;
+        --count;
+    }
+}
@@ -9,10 +9,18 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <string>
 
 //! The Keccak-f[1600] transform.
 void KeccakF(uint64_t (&st)[25]);
 
+/**
+ * The Keccak-f[1600] transform on 4 independent states at once, or nullptr if
+ * this CPU has no multi-lane implementation. The states are interleaved: word
+ * i of state j is at st[4 * i + j].
+ */
+extern void (*KeccakF_4way)(uint64_t *st);
+
 class SHA3_256 {
 private:
     uint64_t m_state[25] = {0};
@@ -38,4 +46,21 @@ public:
     SHA3_256 &Reset();
 };
 
+/**
+ * Autodetect the best available Keccak-f implementation.
+ * Returns the name of the implementation.
+ */
+std::string SHA3AutoDetect();
+
+/**
+ * Compute the SHA3-256's of multiple messages sharing the same length, using
+ * the multi-lane transform when available.
+ * output:  pointer to a count*32 byte output buffer
+ * input:   pointer to a count*len byte input buffer, messages back to back
+ * len:     the length of each message in bytes
+ * count:   the number of hashes to compute.
+ */
+void SHA3_256Multi(uint8_t *output, const uint8_t *input, size_t len,
+                   size_t count);
+
 #endif // BITCOIN_CRYPTO_SHA3_H
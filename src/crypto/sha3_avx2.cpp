@@ -0,0 +1,186 @@
+// Copyright (c) 2021 The Logos Foundation
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <cstdint>
+#include <immintrin.h>
+
+namespace {
+
+template <int n> __m256i inline Rotl(__m256i x) {
+    return _mm256_or_si256(_mm256_slli_epi64(x, n),
+                           _mm256_srli_epi64(x, 64 - n));
+}
+
+__m256i inline Xor(__m256i x, __m256i y) {
+    return _mm256_xor_si256(x, y);
+}
+__m256i inline Xor(__m256i x, __m256i y, __m256i z, __m256i w, __m256i v) {
+    return Xor(Xor(Xor(x, y), Xor(z, w)), v);
+}
+
+/** x ^ (~y & z) */
+__m256i inline Chi(__m256i x, __m256i y, __m256i z) {
+    return Xor(x, _mm256_andnot_si256(y, z));
+}
+
+} // namespace
+
+namespace sha3_avx2 {
+
+void KeccakF_4way(uint64_t *st) {
+    static constexpr uint64_t RNDC[24] = {
+        0x0000000000000001, 0x0000000000008082, 0x800000000000808a,
+        0x8000000080008000, 0x000000000000808b, 0x0000000080000001,
+        0x8000000080008081, 0x8000000000008009, 0x000000000000008a,
+        0x0000000000000088, 0x0000000080008009, 0x000000008000000a,
+        0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
+        0x8000000000008003, 0x8000000000008002, 0x8000000000000080,
+        0x000000000000800a, 0x800000008000000a, 0x8000000080008081,
+        0x8000000000008080, 0x0000000080000001, 0x8000000080008008};
+    static constexpr int ROUNDS = 24;
+
+    __m256i s[25];
+    for (int i = 0; i < 25; ++i) {
+        s[i] = _mm256_loadu_si256((const __m256i *)(st + 4 * i));
+    }
+
+    for (int round = 0; round < ROUNDS; ++round) {
+        __m256i bc0, bc1, bc2, bc3, bc4, t;
+
+        // Theta
+        bc0 = Xor(s[0], s[5], s[10], s[15], s[20]);
+        bc1 = Xor(s[1], s[6], s[11], s[16], s[21]);
+        bc2 = Xor(s[2], s[7], s[12], s[17], s[22]);
+        bc3 = Xor(s[3], s[8], s[13], s[18], s[23]);
+        bc4 = Xor(s[4], s[9], s[14], s[19], s[24]);
+        t = Xor(bc4, Rotl<1>(bc1));
+        s[0] = Xor(s[0], t);
+        s[5] = Xor(s[5], t);
+        s[10] = Xor(s[10], t);
+        s[15] = Xor(s[15], t);
+        s[20] = Xor(s[20], t);
+        t = Xor(bc0, Rotl<1>(bc2));
+        s[1] = Xor(s[1], t);
+        s[6] = Xor(s[6], t);
+        s[11] = Xor(s[11], t);
+        s[16] = Xor(s[16], t);
+        s[21] = Xor(s[21], t);
+        t = Xor(bc1, Rotl<1>(bc3));
+        s[2] = Xor(s[2], t);
+        s[7] = Xor(s[7], t);
+        s[12] = Xor(s[12], t);
+        s[17] = Xor(s[17], t);
+        s[22] = Xor(s[22], t);
+        t = Xor(bc2, Rotl<1>(bc4));
+        s[3] = Xor(s[3], t);
+        s[8] = Xor(s[8], t);
+        s[13] = Xor(s[13], t);
+        s[18] = Xor(s[18], t);
+        s[23] = Xor(s[23], t);
+        t = Xor(bc3, Rotl<1>(bc0));
+        s[4] = Xor(s[4], t);
+        s[9] = Xor(s[9], t);
+        s[14] = Xor(s[14], t);
+        s[19] = Xor(s[19], t);
+        s[24] = Xor(s[24], t);
+
+        // Rho Pi
+        t = s[1];
+        bc0 = s[10];
+        s[10] = Rotl<1>(t);
+        t = bc0;
+        bc0 = s[7];
+        s[7] = Rotl<3>(t);
+        t = bc0;
+        bc0 = s[11];
+        s[11] = Rotl<6>(t);
+        t = bc0;
+        bc0 = s[17];
+        s[17] = Rotl<10>(t);
+        t = bc0;
+        bc0 = s[18];
+        s[18] = Rotl<15>(t);
+        t = bc0;
+        bc0 = s[3];
+        s[3] = Rotl<21>(t);
+        t = bc0;
+        bc0 = s[5];
+        s[5] = Rotl<28>(t);
+        t = bc0;
+        bc0 = s[16];
+        s[16] = Rotl<36>(t);
+        t = bc0;
+        bc0 = s[8];
+        s[8] = Rotl<45>(t);
+        t = bc0;
+        bc0 = s[21];
+        s[21] = Rotl<55>(t);
+        t = bc0;
+        bc0 = s[24];
+        s[24] = Rotl<2>(t);
+        t = bc0;
+        bc0 = s[4];
+        s[4] = Rotl<14>(t);
+        t = bc0;
+        bc0 = s[15];
+        s[15] = Rotl<27>(t);
+        t = bc0;
+        bc0 = s[23];
+        s[23] = Rotl<41>(t);
+        t = bc0;
+        bc0 = s[19];
+        s[19] = Rotl<56>(t);
+        t = bc0;
+        bc0 = s[13];
+        s[13] = Rotl<8>(t);
+        t = bc0;
+        bc0 = s[12];
+        s[12] = Rotl<25>(t);
+        t = bc0;
+        bc0 = s[2];
+        s[2] = Rotl<43>(t);
+        t = bc0;
+        bc0 = s[20];
+        s[20] = Rotl<62>(t);
+        t = bc0;
+        bc0 = s[14];
+        s[14] = Rotl<18>(t);
+        t = bc0;
+        bc0 = s[22];
+        s[22] = Rotl<39>(t);
+        t = bc0;
+        bc0 = s[9];
+        s[9] = Rotl<61>(t);
+        t = bc0;
+        bc0 = s[6];
+        s[6] = Rotl<20>(t);
+        t = bc0;
+        s[1] = Rotl<44>(t);
+
+        // Chi Iota
+        for (int y = 0; y < 25; y += 5) {
+            bc0 = s[y + 0];
+            bc1 = s[y + 1];
+            bc2 = s[y + 2];
+            bc3 = s[y + 3];
+            bc4 = s[y + 4];
+            s[y + 0] = Chi(bc0, bc1, bc2);
+            s[y + 1] = Chi(bc1, bc2, bc3);
+            s[y + 2] = Chi(bc2, bc3, bc4);
+            s[y + 3] = Chi(bc3, bc4, bc0);
+            s[y + 4] = Chi(bc4, bc0, bc1);
+        }
+        s[0] = Xor(s[0], _mm256_set1_epi64x(RNDC[round]));
+    }
+
+    for (int i = 0; i < 25; ++i) {
+        _mm256_storeu_si256((__m256i *)(st + 4 * i), s[i]);
+    }
+}
+
+} // namespace sha3_avx2
+
+#endif
@@ -430,8 +430,9 @@ public:
      * now in the table, one previously inserted element is evicted from the
      * table, the entry attempted to be inserted is evicted. If replace is true
      * and a matching element already exists, it is updated accordingly.
+     * @returns true if an element was evicted, false otherwise
      */
-    inline void insert(Element e, bool replace = false) {
+    inline bool insert(Element e, bool replace = false) {
         epoch_check();
         uint32_t last_loc = invalid();
         bool last_epoch = true;
@@ -445,7 +446,7 @@ public:
                 }
                 please_keep(loc);
                 epoch_flags[loc] = last_epoch;
-                return;
+                return false;
             }
         }
         for (uint8_t depth = 0; depth < depth_limit; ++depth) {
@@ -457,7 +458,7 @@ public:
                 table[loc] = std::move(e);
                 please_keep(loc);
                 epoch_flags[loc] = last_epoch;
-                return;
+                return false;
             }
             /**
              * Swap with the element at the location that was not the last one
@@ -487,6 +488,7 @@ public:
             // Recompute the locs -- unfortunately happens one too many times!
             locs = compute_hashes(e.getKey());
         }
+        return true;
     }
 
     /**
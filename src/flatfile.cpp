@@ -8,8 +8,18 @@
 #include <tinyformat.h>
 #include <util/system.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <stdexcept>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 FlatFileSeq::FlatFileSeq(fs::path dir, const char *prefix, size_t chunk_size)
     : m_dir(std::move(dir)), m_prefix(prefix), m_chunk_size(chunk_size) {
     if (chunk_size == 0) {
@@ -94,3 +104,91 @@ bool FlatFileSeq::Flush(const FlatFilePos &pos, bool finalize) {
     fclose(file);
     return true;
 }
+
+FlatFileMapping::~FlatFileMapping() {
+#ifndef WIN32
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+}
+
+std::shared_ptr<const FlatFileMapping> MapFlatFile(const fs::path &path,
+                                                   size_t size) {
+#ifdef WIN32
+    return nullptr;
+#else
+    if (size == 0) {
+        return nullptr;
+    }
+    const int fd = open(fs::PathToString(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    // Mapping beyond the end of the file would fault on access
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || uint64_t(file_stat.st_size) < size) {
+        close(fd);
+        return nullptr;
+    }
+    void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        LogPrintf("Unable to map %s: %s\n", fs::PathToString(path),
+                  std::strerror(errno));
+        return nullptr;
+    }
+    return std::make_shared<const FlatFileMapping>(
+        static_cast<const uint8_t *>(data), size);
+#endif
+}
+
+void FlatFileMappingCache::SetMaxMappings(size_t max_mappings) {
+    LOCK(m_mutex);
+    m_max_mappings = max_mappings;
+    m_mappings.clear();
+}
+
+std::shared_ptr<const FlatFileMapping>
+FlatFileMappingCache::Get(const fs::path &path, size_t min_size,
+                          size_t final_size) {
+#ifdef WIN32
+    return nullptr;
+#else
+    if (min_size > final_size || final_size == 0) {
+        return nullptr;
+    }
+    LOCK(m_mutex);
+    if (m_max_mappings == 0) {
+        return nullptr;
+    }
+    auto it = m_mappings.find(path);
+    if (it != m_mappings.end() && it->second.mapping->size() >= min_size) {
+        it->second.last_used = ++m_use_count;
+        return it->second.mapping;
+    }
+
+    std::shared_ptr<const FlatFileMapping> mapping =
+        MapFlatFile(path, final_size);
+    if (!mapping) {
+        return nullptr;
+    }
+
+    if (it == m_mappings.end()) {
+        if (m_mappings.size() >= m_max_mappings) {
+            // Readers still holding the evicted mapping keep it alive
+            m_mappings.erase(std::min_element(
+                m_mappings.begin(), m_mappings.end(),
+                [](const auto &a, const auto &b) {
+                    return a.second.last_used < b.second.last_used;
+                }));
+        }
+        it = m_mappings.emplace(path, CachedMapping()).first;
+    }
+    it->second = {mapping, ++m_use_count};
+    return mapping;
+#endif
+}
+
+void FlatFileMappingCache::Erase(const fs::path &path) {
+    LOCK(m_mutex);
+    m_mappings.erase(path);
+}
@@ -8,8 +8,14 @@
 
 #include <fs.h>
 #include <serialize.h>
+#include <span.h>
+#include <sync.h>
 
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 struct FlatFilePos {
     int nFile;
@@ -94,4 +100,107 @@ public:
     bool Flush(const FlatFilePos &pos, bool finalize = false);
 };
 
+/**
+ * Read-only memory mapping of the beginning of a flat file. The mapped bytes
+ * must never be modified or truncated while the mapping exists.
+ */
+class FlatFileMapping {
+private:
+    const uint8_t *const m_data;
+    const size_t m_size;
+
+public:
+    FlatFileMapping(const uint8_t *data, size_t size)
+        : m_data(data), m_size(size) {}
+    ~FlatFileMapping();
+
+    FlatFileMapping(const FlatFileMapping &) = delete;
+    FlatFileMapping &operator=(const FlatFileMapping &) = delete;
+
+    Span<const uint8_t> data() const { return {m_data, m_size}; }
+    size_t size() const { return m_size; }
+};
+
+/**
+ * Map the first size bytes of a file, e.g. to read it in one go.
+ *
+ * @return nullptr if mapping is not supported on this platform, or if the file
+ * is shorter than size bytes or can't be mapped.
+ */
+std::shared_ptr<const FlatFileMapping> MapFlatFile(const fs::path &path,
+                                                   size_t size);
+
+/**
+ * Bytes read from a flat file. They either point into a memory mapping of the
+ * file, which is kept alive as long as this object, or into a copy owned by
+ * this object.
+ */
+class FlatFileData {
+private:
+    std::shared_ptr<const FlatFileMapping> m_mapping;
+    std::vector<uint8_t> m_copy;
+    Span<const uint8_t> m_bytes;
+
+public:
+    FlatFileData() {}
+    FlatFileData(std::shared_ptr<const FlatFileMapping> mapping,
+                 Span<const uint8_t> bytes)
+        : m_mapping(std::move(mapping)), m_bytes(bytes) {}
+    explicit FlatFileData(std::vector<uint8_t> copy)
+        : m_copy(std::move(copy)), m_bytes(m_copy) {}
+
+    // Moving the vector keeps its buffer, copying it wouldn't.
+    FlatFileData(FlatFileData &&) = default;
+    FlatFileData &operator=(FlatFileData &&) = default;
+    FlatFileData(const FlatFileData &) = delete;
+    FlatFileData &operator=(const FlatFileData &) = delete;
+
+    Span<const uint8_t> bytes() const { return m_bytes; }
+    bool IsMapped() const { return m_mapping != nullptr; }
+    /** Only keep the first size bytes */
+    void Truncate(size_t size) { m_bytes = m_bytes.first(size); }
+};
+
+/**
+ * Keeps the most recently used memory mappings of flat files, so reads from
+ * files which are no longer written to don't have to go through a FILE* and
+ * can be served without copying.
+ */
+class FlatFileMappingCache {
+private:
+    struct CachedMapping {
+        std::shared_ptr<const FlatFileMapping> mapping;
+        uint64_t last_used;
+    };
+
+    Mutex m_mutex;
+    size_t m_max_mappings GUARDED_BY(m_mutex);
+    std::map<fs::path, CachedMapping> m_mappings GUARDED_BY(m_mutex);
+    uint64_t m_use_count GUARDED_BY(m_mutex){0};
+
+public:
+    explicit FlatFileMappingCache(size_t max_mappings = 0)
+        : m_max_mappings(max_mappings) {}
+
+    /** Set the number of mappings kept, 0 disables mapping altogether. */
+    void SetMaxMappings(size_t max_mappings);
+
+    /**
+     * Get a mapping covering at least the first min_size bytes of a file.
+     *
+     * @param[in] path File to be mapped.
+     * @param[in] min_size Number of bytes the caller wants to read.
+     * @param[in] final_size Number of bytes at the beginning of the file which
+     * will never be modified or truncated. If the file has to be (re)mapped,
+     * that many bytes are mapped.
+     * @return nullptr if mapping is disabled or not supported on this
+     * platform, or if the file can't be mapped.
+     */
+    std::shared_ptr<const FlatFileMapping>
+    Get(const fs::path &path, size_t min_size, size_t final_size);
+
+    /** Drop the mapping of a file, e.g. because it is deleted. */
+    void Erase(const fs::path &path);
+};
+
 #endif // BITCOIN_FLATFILE_H
@@ -71,12 +71,18 @@ uint32_t MurmurHash3(uint32_t nHashSeed, Span<const uint8_t> vDataToHash) {
 
 void BIP32Hash(const ChainCode &chainCode, uint32_t nChild, uint8_t header,
                const uint8_t data[32], uint8_t output[64]) {
+    BIP32Hash(CHMAC_SHA512(chainCode.begin(), chainCode.size()), nChild,
+              header, data, output);
+}
+
+void BIP32Hash(const CHMAC_SHA512 &keyed, uint32_t nChild, uint8_t header,
+               const uint8_t data[32], uint8_t output[64]) {
     uint8_t num[4];
     num[0] = (nChild >> 24) & 0xFF;
     num[1] = (nChild >> 16) & 0xFF;
     num[2] = (nChild >> 8) & 0xFF;
     num[3] = (nChild >> 0) & 0xFF;
-    CHMAC_SHA512(chainCode.begin(), chainCode.size())
+    CHMAC_SHA512(keyed)
         .Write(&header, 1)
         .Write(data, 32)
         .Write(num, 4)
@@ -18,6 +18,8 @@
 #include <string>
 #include <vector>
 
+class CHMAC_SHA512;
+
 typedef uint256 ChainCode;
 
 /** A hasher class for Bitcoin's 256-bit hash (double SHA-256). */
@@ -203,6 +205,12 @@ uint32_t MurmurHash3(uint32_t nHashSeed, Span<const uint8_t> vDataToHash);
 
 void BIP32Hash(const ChainCode &chainCode, uint32_t nChild, uint8_t header,
                const uint8_t data[32], uint8_t output[64]);
+/**
+ * Same as above, from an HMAC already keyed with the chain code. Deriving many
+ * children of the same parent can then share the key setup.
+ */
+void BIP32Hash(const CHMAC_SHA512 &keyed, uint32_t nChild, uint8_t header,
+               const uint8_t data[32], uint8_t output[64]);
 
 /** Return a CHashWriter primed for tagged hashes (as specified in BIP 340).
  *
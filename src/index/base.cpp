@@ -5,10 +5,12 @@
 #include <blockdb.h>
 #include <chain.h>
 #include <chainparams.h>
+#include <clientversion.h>
 #include <config.h>
 #include <index/base.h>
 #include <node/ui_interface.h>
 #include <shutdown.h>
+#include <streams.h>
 #include <tinyformat.h>
 #include <util/system.h>
 #include <util/translation.h>
@@ -136,12 +138,22 @@ void BaseIndex::ThreadSync() {
                 Commit();
             }
 
+            // Decode the block straight from the block file mapping, if any
             CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+            FlatFileData raw_block;
+            if (!ReadRawBlockFromDisk(raw_block, pindex, consensus_params)) {
                 FatalError("%s: Failed to read block %s from disk", __func__,
                            pindex->GetBlockHash().ToString());
                 return;
             }
+            try {
+                VectorReader(SER_DISK, CLIENT_VERSION, raw_block.bytes(), 0,
+                             block);
+            } catch (const std::exception &e) {
+                FatalError("%s: Failed to decode block %s: %s", __func__,
+                           pindex->GetBlockHash().ToString(), e.what());
+                return;
+            }
             if (!WriteBlock(block, pindex)) {
                 FatalError("%s: Failed to write block %s to index database",
                            __func__, pindex->GetBlockHash().ToString());
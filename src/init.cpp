@@ -24,6 +24,7 @@
 #include <compat/sanity.h>
 #include <config.h>
 #include <consensus/validation.h>
+#include <crypto/sha3.h>
 #include <currencyunit.h>
 #include <flatfile.h>
 #include <fs.h>
@@ -47,6 +48,7 @@
 #include <policy/mempool.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
+#include <pow/noncescanner.h>
 #include <rpc/blockchain.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
@@ -64,6 +66,7 @@
 #include <util/asmap.h>
 #include <util/check.h>
 #include <util/moneystr.h>
+#include <util/parallel.h>
 #include <util/string.h>
 #include <util/threadnames.h>
 #include <util/translation.h>
@@ -81,6 +84,10 @@
 #include <zmq/zmqrpc.h>
 #endif
 
+#if ENABLE_NNG
+#include <nng_interface/nngrpc.h>
+#endif
+
 #ifndef WIN32
 #include <attributes.h>
 #include <cerrno>
@@ -257,6 +264,7 @@ void Shutdown(NodeContext &node) {
     }
     threadGroup.interrupt_all();
     threadGroup.join_all();
+    StopParallelWorkers();
 
     // After the threads that potentially access these pointers have been
     // stopped, destruct and reset all to nullptr.
@@ -467,6 +475,19 @@ void SetupServerArgs(NodeContext &node) {
                              "block reconstructions (default: %u)",
                              DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN),
                    ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockfilemappings=<n>",
+                   strprintf("Number of finalized block and undo files to keep "
+                             "memory mapped, so raw block reads are served "
+                             "without copying (0 to disable, default: %d)",
+                             DEFAULT_BLOCK_FILE_MAPPINGS),
+                   ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockindexsnapshot",
+                   strprintf("Keep a snapshot of the block index next to its "
+                             "database, written on shutdown and periodic "
+                             "flushes, to load it faster at startup "
+                             "(default: %u)",
+                             DEFAULT_BLOCK_INDEX_SNAPSHOT),
+                   ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg(
         "-blocksonly",
         strprintf("Whether to reject transactions from network peers.  "
@@ -476,6 +497,19 @@ void SetupServerArgs(NodeContext &node) {
                   " not affected. (default: %u)",
                   DEFAULT_BLOCKSONLY),
         ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg(
+        "-coinsprefetchthreads=<n>",
+        strprintf("Number of threads looking up the coins spent by a block "
+                  "before connecting it (0 to disable, max: %d, default: %d)",
+                  MAX_COINS_PREFETCH_THREADS, DEFAULT_COINS_PREFETCH_THREADS),
+        ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg(
+        "-connectblockthreads=<n>",
+        strprintf("Number of threads checking the transactions of a block "
+                  "against the UTXO set ahead of spending their inputs (0 to "
+                  "check them one by one, max: %d, default: %d)",
+                  MAX_CONNECT_BLOCK_THREADS, DEFAULT_CONNECT_BLOCK_THREADS),
+        ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg(
         "-conf=<file>",
         strprintf("Specify path to read-only configuration file. Relative "
@@ -1059,6 +1093,12 @@ void SetupServerArgs(NodeContext &node) {
                   DEFAULT_MAX_SCRIPT_CACHE_SIZE),
         ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
         OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-maxtaprootcachesize=<n>",
+                   strprintf("Limit size of the cache of verified Taproot "
+                             "script path commitments to <n> MiB (default: %u)",
+                             DEFAULT_MAX_TAPROOT_CACHE_SIZE),
+                   ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
+                   OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-maxtipage=<n>",
                    strprintf("Maximum tip age in seconds to consider node in "
                              "initial block download (default: %u)",
@@ -1182,6 +1222,18 @@ void SetupServerArgs(NodeContext &node) {
                   ticker, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE_PER_KB)),
         ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
 
+    argsman.AddArg("-generatethreads=<n>",
+                   strprintf("Number of threads used to search for a valid "
+                             "nonce by the generate RPCs (0 = one per core, "
+                             "default: %d)",
+                             DEFAULT_GENERATE_THREADS),
+                   ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
+    argsman.AddArg("-generatenoncechunk=<n>",
+                   strprintf("Number of consecutive nonces handed to a "
+                             "generate thread at once (default: %u)",
+                             DEFAULT_GENERATE_NONCE_CHUNK),
+                   ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
+                   OptionsCategory::BLOCK_CREATION);
     argsman.AddArg("-blockversion=<n>",
                    "Override block version to test forking scenarios (must be "
                    "a positive integer lower than 255)",
@@ -1285,6 +1337,12 @@ void SetupServerArgs(NodeContext &node) {
                    "has to be prefixed by tcp:// or ipc://, which also "
                    "determines the transport that will be used",
                    false, OptionsCategory::NNG_INTERFACE);
+    argsman.AddArg(
+        "-nngrpcworkers=<n>",
+        strprintf("Number of NNG RPC requests served concurrently (default: "
+                  "%d)",
+                  DEFAULT_NNG_RPC_WORKERS),
+        ArgsManager::ALLOW_ANY, OptionsCategory::NNG_INTERFACE);
     argsman.AddArg(
         "-nngpub=<url>",
         "Bind to given url to listen for NNG PubSub connections. URL "
@@ -1298,6 +1356,20 @@ void SetupServerArgs(NodeContext &node) {
                   "multiple message types. Available message types are: %s",
                   Join(AVAILABLE_PUB_MESSAGES, ", ")),
         ArgsManager::ALLOW_ANY, OptionsCategory::NNG_INTERFACE);
+    argsman.AddArg(
+        "-nngpubqueuesize=<n>",
+        strprintf("Maximum number of NNG PubSub messages waiting to be "
+                  "encoded and sent by the publisher thread (default: %u)",
+                  DEFAULT_NNG_PUB_QUEUE_SIZE),
+        ArgsManager::ALLOW_ANY, OptionsCategory::NNG_INTERFACE);
+    argsman.AddArg(
+        "-nngpubpolicy=<policy>",
+        strprintf("What to do when the NNG PubSub queue is full: '%s' makes "
+                  "validation notifications wait for the publisher, '%s' "
+                  "discards the new message (default: %s)",
+                  NNG_PUB_POLICY_BLOCK, NNG_PUB_POLICY_DROP,
+                  DEFAULT_NNG_PUB_POLICY),
+        ArgsManager::ALLOW_ANY, OptionsCategory::NNG_INTERFACE);
 #endif
 
 #if HAVE_DECL_DAEMON
@@ -1853,6 +1925,32 @@ bool AppInitParameterInteraction(Config &config, const ArgsManager &args) {
                       args.GetArg("-blocksdir", "")));
     }
 
+    const int64_t block_file_mappings =
+        args.GetArg("-blockfilemappings", DEFAULT_BLOCK_FILE_MAPPINGS);
+    if (block_file_mappings < 0) {
+        return InitError(_("-blockfilemappings must not be negative."));
+    }
+    g_block_file_mappings.SetMaxMappings(block_file_mappings);
+
+    g_block_index_snapshot =
+        args.GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCK_INDEX_SNAPSHOT);
+
+    const int64_t coins_prefetch_threads =
+        args.GetArg("-coinsprefetchthreads", DEFAULT_COINS_PREFETCH_THREADS);
+    if (coins_prefetch_threads < 0) {
+        return InitError(_("-coinsprefetchthreads must not be negative."));
+    }
+    g_coins_prefetch_threads =
+        std::min<int64_t>(coins_prefetch_threads, MAX_COINS_PREFETCH_THREADS);
+
+    const int64_t connect_block_threads =
+        args.GetArg("-connectblockthreads", DEFAULT_CONNECT_BLOCK_THREADS);
+    if (connect_block_threads < 0) {
+        return InitError(_("-connectblockthreads must not be negative."));
+    }
+    g_connect_block_threads =
+        std::min<int64_t>(connect_block_threads, MAX_CONNECT_BLOCK_THREADS);
+
     // parse and validate enabled filter types
     std::string blockfilterindex_value =
         args.GetArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
@@ -2190,6 +2288,8 @@ bool AppInitSanityChecks() {
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string sha3_algo = SHA3AutoDetect();
+    LogPrintf("Using the '%s' SHA3 implementation\n", sha3_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -2305,6 +2405,7 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitTaprootCommitmentCache();
 
     int script_threads = args.GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (script_threads <= 0) {
@@ -2328,6 +2429,17 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         }
     }
 
+    // The calling thread takes part in the parallel loops too.
+    const int parallel_workers =
+        std::max({GetNumCores(), g_connect_block_threads,
+                  g_coins_prefetch_threads,
+                  int(args.GetArg("-generatethreads",
+                                  DEFAULT_GENERATE_THREADS))}) -
+        1;
+    LogPrintf("Parallel loops use up to %d additional threads\n",
+              parallel_workers);
+    StartParallelWorkers(parallel_workers);
+
     assert(!node.scheduler);
     node.scheduler = std::make_unique<CScheduler>();
 
@@ -2359,6 +2471,9 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
 #if ENABLE_ZMQ
     RegisterZMQRPCCommands(tableRPC);
 #endif
+#if ENABLE_NNG
+    RegisterNNGRPCCommands(tableRPC);
+#endif
 
     /**
      * Start the RPC server.  It will be started in "warmup" mode and not
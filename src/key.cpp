@@ -352,15 +352,23 @@ bool CKey::Load(const CPrivKey &privkey, const CPubKey &vchPubKey,
 bool CKey::Derive(CKey &keyChild, ChainCode &ccChild, unsigned int nChild,
                   const ChainCode &cc) const {
     assert(IsValid());
+    return Derive(keyChild, ccChild, nChild,
+                  CHMAC_SHA512(cc.begin(), cc.size()),
+                  (nChild >> 31) == 0 ? GetPubKey() : CPubKey());
+}
+
+bool CKey::Derive(CKey &keyChild, ChainCode &ccChild, unsigned int nChild,
+                  const CHMAC_SHA512 &keyed, const CPubKey &pubkey) const {
+    assert(IsValid());
     assert(IsCompressed());
     std::vector<uint8_t, secure_allocator<uint8_t>> vout(64);
     if ((nChild >> 31) == 0) {
-        CPubKey pubkey = GetPubKey();
         assert(pubkey.size() == CPubKey::COMPRESSED_SIZE);
-        BIP32Hash(cc, nChild, *pubkey.begin(), pubkey.begin() + 1, vout.data());
+        BIP32Hash(keyed, nChild, *pubkey.begin(), pubkey.begin() + 1,
+                  vout.data());
     } else {
         assert(size() == 32);
-        BIP32Hash(cc, nChild, 0, begin(), vout.data());
+        BIP32Hash(keyed, nChild, 0, begin(), vout.data());
     }
     memcpy(ccChild.begin(), vout.data() + 32, 32);
     memcpy((uint8_t *)keyChild.begin(), begin(), 32);
@@ -379,6 +387,27 @@ bool CExtKey::Derive(CExtKey &out, unsigned int _nChild) const {
     return key.Derive(out.key, out.chaincode, _nChild, chaincode);
 }
 
+bool CExtKey::DeriveRange(std::vector<CExtKey> &out, unsigned int _nChild,
+                          size_t count) const {
+    // The children can't cross the hardened boundary, nor overflow.
+    assert(count == 0 ||
+           (uint64_t(_nChild) + count - 1) >> 31 == _nChild >> 31);
+    out.resize(count);
+    const CPubKey pubkey = key.GetPubKey();
+    const CKeyID id = pubkey.GetID();
+    const CHMAC_SHA512 keyed(chaincode.begin(), chaincode.size());
+    bool ret = true;
+    for (size_t i = 0; i < count; ++i) {
+        CExtKey &child = out[i];
+        child.nDepth = nDepth + 1;
+        memcpy(&child.vchFingerprint[0], &id, 4);
+        child.nChild = _nChild + i;
+        ret &= key.Derive(child.key, child.chaincode, child.nChild, keyed,
+                          pubkey);
+    }
+    return ret;
+}
+
 void CExtKey::SetSeed(const uint8_t *seed, unsigned int nSeedLen) {
     static const uint8_t hashkey[] = {'B', 'i', 't', 'c', 'o', 'i',
                                       'n', ' ', 's', 'e', 'e', 'd'};
@@ -148,6 +148,12 @@ public:
     //! Derive BIP32 child key.
     bool Derive(CKey &keyChild, ChainCode &ccChild, unsigned int nChild,
                 const ChainCode &cc) const;
+    /**
+     * Derive BIP32 child key, from an HMAC keyed with the chain code and, for
+     * non-hardened children, this key's public key.
+     */
+    bool Derive(CKey &keyChild, ChainCode &ccChild, unsigned int nChild,
+                const CHMAC_SHA512 &keyed, const CPubKey &pubkey) const;
 
     /**
      * Verify thoroughly whether a private key and a public key match.
@@ -179,6 +185,14 @@ struct CExtKey {
     void Encode(uint8_t code[BIP32_EXTKEY_SIZE]) const;
     void Decode(const uint8_t code[BIP32_EXTKEY_SIZE]);
     bool Derive(CExtKey &out, unsigned int nChild) const;
+    /**
+     * Derive the count consecutive children starting at nChild, which must all
+     * be hardened or all non-hardened. The parent public key and the HMAC key
+     * setup are computed once for all of them.
+     * Returns false if any child is invalid.
+     */
+    bool DeriveRange(std::vector<CExtKey> &out, unsigned int nChild,
+                     size_t count) const;
     CExtPubKey Neuter() const;
     void SetSeed(const uint8_t *seed, unsigned int nSeedLen);
 
@@ -7,6 +7,7 @@
 
 #include <indirectmap.h>
 #include <prevector.h>
+#include <support/allocators/pool.h>
 
 #include <cassert>
 #include <cstdlib>
@@ -179,6 +180,21 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z> &m) {
                m.size() +
            MallocUsage(sizeof(void *) * m.bucket_count());
 }
+
+template <typename X, typename Y, typename Z, typename P, size_t MAX_BLOCK,
+          size_t ALIGN>
+static inline size_t DynamicUsage(
+    const std::unordered_map<
+        X, Y, Z, P, PoolAllocator<std::pair<const X, Y>, MAX_BLOCK, ALIGN>>
+        &m) {
+    // The nodes live in the pool's chunks, which are tracked in a std::list
+    // (2 pointers of links and the chunk pointer per list node).
+    const auto *resource = m.get_allocator().resource();
+    return (MallocUsage(sizeof(void *) * 3) +
+            MallocUsage(resource->ChunkSizeBytes())) *
+               resource->NumAllocatedChunks() +
+           MallocUsage(sizeof(void *) * m.bucket_count());
+}
 } // namespace memusage
 
 #endif // BITCOIN_MEMUSAGE_H
@@ -2764,6 +2764,9 @@ void PeerManagerImpl::ProcessHeadersMessage(
         return;
     }
 
+    // Hash the whole batch up front, outside of cs_main.
+    const std::vector<BlockHash> hashes = GetBlockHeaderHashes(headers);
+
     bool received_new_header = false;
     const CBlockIndex *pindexLast = nullptr;
     {
@@ -2790,13 +2793,13 @@ void PeerManagerImpl::ProcessHeadersMessage(
                 BCLog::NET,
                 "received header %s: missing prev block %s, sending getheaders "
                 "(%d) to end (peer=%d, nUnconnectingHeaders=%d)\n",
-                headers[0].GetHash().ToString(),
-                headers[0].hashPrevBlock.ToString(), pindexBestHeader->nHeight,
-                pfrom.GetId(), nodestate->nUnconnectingHeaders);
+                hashes[0].ToString(), headers[0].hashPrevBlock.ToString(),
+                pindexBestHeader->nHeight, pfrom.GetId(),
+                nodestate->nUnconnectingHeaders);
             // Set hashLastUnknownBlock for this peer, so that if we eventually
             // get the headers - even from a different peer - we can use this
             // peer to download.
-            UpdateBlockAvailability(pfrom.GetId(), headers.back().GetHash());
+            UpdateBlockAvailability(pfrom.GetId(), hashes.back());
 
             if (nodestate->nUnconnectingHeaders % MAX_UNCONNECTING_HEADERS ==
                 0) {
@@ -2808,15 +2811,13 @@ void PeerManagerImpl::ProcessHeadersMessage(
             return;
         }
 
-        BlockHash hashLastBlock;
-        for (const CBlockHeader &header : headers) {
-            if (!hashLastBlock.IsNull() &&
-                header.hashPrevBlock != hashLastBlock) {
+        for (size_t i = 1; i < headers.size(); ++i) {
+            if (headers[i].hashPrevBlock != hashes[i - 1]) {
                 Misbehaving(pfrom, 20, "non-continuous headers sequence");
                 return;
             }
-            hashLastBlock = header.GetHash();
         }
+        const BlockHash &hashLastBlock = hashes.back();
 
         // If we don't have the last header, then they'll have given us
         // something new (if these headers are valid).
@@ -2826,7 +2827,7 @@ void PeerManagerImpl::ProcessHeadersMessage(
     }
 
     BlockValidationState state;
-    if (!m_chainman.ProcessNewBlockHeaders(config, headers, state,
+    if (!m_chainman.ProcessNewBlockHeaders(config, headers, hashes, state,
                                            &pindexLast)) {
         if (state.IsInvalid()) {
             MaybePunishNodeForBlock(pfrom.GetId(), state, via_compact_block,
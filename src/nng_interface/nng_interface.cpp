@@ -2,22 +2,45 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <optional>
+#include <thread>
+#include <tuple>
 
 #include <blockdb.h>
 #include <chainparams.h>
+#include <config.h>
 #include <consensus/validation.h>
+#include <crypto/common.h>
 #include <logging.h>
 #include <node/coin.h>
 #include <node/context.h>
 #include <node/ui_interface.h>
+#include <script/script.h>
+#include <span.h>
 #include <timedata.h>
 #include <undo.h>
+#include <util/system.h>
+#include <util/time.h>
 #include <util/translation.h>
 #include <validation.h>
 #include <validationinterface.h>
 
+#if HAVE_PREADV
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
 #include <nng/nng.h>
 #include <nng/protocol/pubsub0/pub.h>
 #include <nng/protocol/reqrep0/rep.h>
@@ -61,6 +84,7 @@ enum class NngRpcErrorCode {
     BLOCK_NOT_FOUND,
     BLOCK_DATA_CORRUPTED,
     INVALID_BLOCK_SLICE,
+    SLICES_TOO_LARGE,
 };
 
 struct RpcResult {
@@ -85,11 +109,279 @@ std::string ErrorMsg(NngRpcErrorCode code) {
             return "Block data corrupted";
         case NngRpcErrorCode::INVALID_BLOCK_SLICE:
             return "Invalid block slice";
+        case NngRpcErrorCode::SLICES_TOO_LARGE:
+            return "Slices exceed 32 MiB";
         default:
             return "Unknown error";
     }
 }
 
+/** Default limit of the block and undo data sent by GetRawBlockRange */
+static const uint64_t DEFAULT_RAW_BLOCK_RANGE_MAX_BYTES = 32 << 20;
+
+/** Space taken by a RawBlock in a response, besides its block and undo data */
+static const size_t RAW_BLOCK_OVERHEAD = 128;
+
+/** Space taken by a response and its RpcResult, besides its blocks */
+static const size_t RAW_BLOCK_RANGE_OVERHEAD = 256;
+
+/**
+ * GetMempool looks up the coins spent by this many inputs at a time, or by a
+ * single tx spending more.
+ */
+static const size_t MEMPOOL_COINS_CHUNK_SIZE = 1000;
+
+/** Initial size of the NNG messages responses are built in */
+static const size_t INITIAL_RESPONSE_SIZE = 1024;
+
+/** Maximum total size of the slices requested by a single request */
+static const uint64_t MAX_SLICES_BYTES = 32 << 20;
+
+/**
+ * Slices of the same file which are at most this far apart are read with one
+ * vectored read, the bytes in between are discarded.
+ */
+static const uint64_t MAX_SLICE_GAP = 4096;
+
+/** Number of block and undo files kept open for slice reads */
+static const size_t MAX_OPEN_SLICE_FILES = 64;
+
+/** Maximum number of buffers passed to a single vectored read */
+static const size_t MAX_SLICE_IOVECS = 1024;
+
+/**
+ * Reads byte ranges of the block and undo files. Where preadv is available,
+ * the files are kept open in a small table shared by all RPC workers; pread
+ * doesn't move a file offset, so concurrent reads of the same file are fine.
+ */
+class SliceReader {
+#if HAVE_PREADV
+    /** Read only file descriptor, closed once its last reader is done */
+    class OpenFile {
+        const int m_fd;
+
+    public:
+        explicit OpenFile(int fd) : m_fd(fd) {}
+        ~OpenFile() { close(m_fd); }
+        int fd() const { return m_fd; }
+    };
+
+    struct CachedFile {
+        std::shared_ptr<OpenFile> file;
+        uint64_t last_used;
+    };
+
+    Mutex m_mutex;
+    std::map<std::pair<NngInterface::SliceFile, uint32_t>, CachedFile>
+        m_files GUARDED_BY(m_mutex);
+    uint64_t m_use_count GUARDED_BY(m_mutex){0};
+
+    std::shared_ptr<OpenFile> GetFile(NngInterface::SliceFile file_type,
+                                      uint32_t file_num) {
+        LOCK(m_mutex);
+        const auto key = std::make_pair(file_type, file_num);
+        auto it = m_files.find(key);
+        if (it != m_files.end()) {
+            it->second.last_used = ++m_use_count;
+            return it->second.file;
+        }
+        const FlatFileSeq seq = file_type == NngInterface::SliceFile_Undo
+                                    ? UndoFileSeq()
+                                    : BlockFileSeq();
+        const fs::path path = seq.FileName(FlatFilePos(file_num, 0));
+        // Block file numbers are never reused, so a cached descriptor can't
+        // point to the wrong file, even after pruning.
+        const int fd =
+            open(fs::PathToString(path).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+        if (m_files.size() >= MAX_OPEN_SLICE_FILES) {
+            // Evict the least recently used file; readers still holding it
+            // keep it open until they are done.
+            m_files.erase(std::min_element(m_files.begin(), m_files.end(),
+                                           [](const auto &a, const auto &b) {
+                                               return a.second.last_used <
+                                                      b.second.last_used;
+                                           }));
+        }
+        CachedFile &cached = m_files[key];
+        cached.file = std::make_shared<OpenFile>(fd);
+        cached.last_used = ++m_use_count;
+        return cached.file;
+    }
+#endif
+
+public:
+    /**
+     * Fills bufs with consecutive bytes of the given file, starting at pos.
+     * Returns false if the file type is unknown, or the file doesn't exist or
+     * is too short.
+     */
+    bool Read(NngInterface::SliceFile file_type, uint32_t file_num,
+              uint64_t pos, const std::vector<Span<uint8_t>> &bufs) {
+        switch (file_type) {
+            case NngInterface::SliceFile_Block:
+            case NngInterface::SliceFile_Undo:
+                break;
+            default:
+                // Unknown file type, possibly from a newer client
+                return false;
+        }
+        uint64_t total_len = 0;
+        for (const Span<uint8_t> &buf : bufs) {
+            total_len += buf.size();
+        }
+        // Finalized files may be memory mapped, copy straight out of those
+        std::shared_ptr<const FlatFileMapping> mapping = MapFinalizedBlockFile(
+            file_num, file_type == NngInterface::SliceFile_Undo,
+            pos + total_len);
+        if (mapping) {
+            const uint8_t *src = mapping->data().data() + pos;
+            for (const Span<uint8_t> &buf : bufs) {
+                std::copy(src, src + buf.size(), buf.data());
+                src += buf.size();
+            }
+            return true;
+        }
+#if HAVE_PREADV
+        std::shared_ptr<OpenFile> file = GetFile(file_type, file_num);
+        if (!file) {
+            return false;
+        }
+        std::vector<iovec> iovecs;
+        iovecs.reserve(bufs.size());
+        for (const Span<uint8_t> &buf : bufs) {
+            if (!buf.empty()) {
+                iovecs.push_back({buf.data(), buf.size()});
+            }
+        }
+        size_t iov_idx = 0;
+        while (iov_idx < iovecs.size()) {
+            const size_t iov_count =
+                std::min(iovecs.size() - iov_idx, MAX_SLICE_IOVECS);
+            const ssize_t num_read =
+                preadv(file->fd(), &iovecs[iov_idx], iov_count, pos);
+            if (num_read < 0 && errno == EINTR) {
+                continue;
+            }
+            if (num_read <= 0) {
+                return false;
+            }
+            pos += num_read;
+            // Skip the filled buffers and shrink a partially filled one
+            size_t remaining = num_read;
+            while (remaining > 0 && remaining >= iovecs[iov_idx].iov_len) {
+                remaining -= iovecs[iov_idx].iov_len;
+                ++iov_idx;
+            }
+            if (remaining > 0) {
+                iovecs[iov_idx].iov_base =
+                    (uint8_t *)iovecs[iov_idx].iov_base + remaining;
+                iovecs[iov_idx].iov_len -= remaining;
+            }
+        }
+        return true;
+#else
+        const FlatFilePos file_pos(file_num, pos);
+        CAutoFile file(file_type == NngInterface::SliceFile_Undo
+                           ? OpenUndoFile(file_pos, true)
+                           : OpenBlockFile(file_pos, true),
+                       SER_DISK, CLIENT_VERSION);
+        try {
+            for (const Span<uint8_t> &buf : bufs) {
+                file.read((char *)buf.data(), buf.size());
+            }
+        } catch (const std::exception &e) {
+            return false;
+        }
+        return true;
+#endif
+    }
+};
+
+/** Latency and response size metrics of one NNG RPC method */
+struct NngRpcMethodMetrics {
+    std::atomic<uint64_t> num_calls{0};
+    std::atomic<uint64_t> num_errors{0};
+    std::atomic<uint64_t> total_micros{0};
+    std::atomic<uint64_t> total_bytes{0};
+    std::array<std::atomic<uint64_t>, NNG_RPC_HISTOGRAM_BUCKETS>
+        latency_micros{};
+    std::array<std::atomic<uint64_t>, NNG_RPC_HISTOGRAM_BUCKETS>
+        response_bytes{};
+
+    static size_t GetBucket(uint64_t value) {
+        return std::min<uint64_t>(CountBits(value),
+                                  NNG_RPC_HISTOGRAM_BUCKETS - 1);
+    }
+
+    void Record(int64_t micros, size_t num_bytes, bool is_error) {
+        const uint64_t elapsed = std::max<int64_t>(micros, 0);
+        num_calls.fetch_add(1, std::memory_order_relaxed);
+        if (is_error) {
+            num_errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        total_micros.fetch_add(elapsed, std::memory_order_relaxed);
+        total_bytes.fetch_add(num_bytes, std::memory_order_relaxed);
+        latency_micros[GetBucket(elapsed)].fetch_add(1,
+                                                     std::memory_order_relaxed);
+        response_bytes[GetBucket(num_bytes)].fetch_add(
+            1, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * Allocates the buffers of a FlatBufferBuilder as NNG messages, so a finished
+ * response is sent without being copied.
+ */
+class NngMsgAllocator : public flatbuffers::Allocator {
+    /** Message holding the current buffer of the builder */
+    nng_msg *m_msg = nullptr;
+    /** Message holding the old buffer while the builder grows */
+    nng_msg *m_old_msg = nullptr;
+
+public:
+    ~NngMsgAllocator() override {
+        for (nng_msg *msg : {m_msg, m_old_msg}) {
+            if (msg) {
+                nng_msg_free(msg);
+            }
+        }
+    }
+
+    uint8_t *allocate(size_t size) override {
+        m_old_msg = m_msg;
+        m_msg = nullptr;
+        if (nng_msg_alloc(&m_msg, size) != 0) {
+            throw std::bad_alloc();
+        }
+        return (uint8_t *)nng_msg_body(m_msg);
+    }
+
+    void deallocate(uint8_t *p, size_t size) override {
+        for (nng_msg **msg : {&m_msg, &m_old_msg}) {
+            if (*msg && nng_msg_body(*msg) == p) {
+                nng_msg_free(*msg);
+                *msg = nullptr;
+            }
+        }
+    }
+
+    /**
+     * Take the message holding the finished buffer of fbb, which must be
+     * released right after.
+     */
+    nng_msg *TakeMsg(const flatbuffers::FlatBufferBuilder &fbb) {
+        nng_msg *msg = m_msg;
+        m_msg = nullptr;
+        // Builders fill their buffer from the back
+        nng_msg_trim(msg,
+                     fbb.GetBufferPointer() - (uint8_t *)nng_msg_body(msg));
+        return msg;
+    }
+};
+
 class NngRpcServer;
 
 class NngRpcWorker {
@@ -97,6 +389,12 @@ class NngRpcWorker {
     nng_aio *m_aio;
     nng_ctx m_ctx;
     NngRpcServer *m_server;
+    NngMsgAllocator m_allocator;
+    /**
+     * Reused for every request handled by this worker. The response and its
+     * RpcResult are built in the same buffer, which is then sent as is.
+     */
+    flatbuffers::FlatBufferBuilder m_fbb{INITIAL_RESPONSE_SIZE, &m_allocator};
 
     void HandleCallback();
 
@@ -109,12 +407,15 @@ public:
 };
 
 class NngRpcServer {
-    static const size_t NUM_WORKERS = 64;
-
+    const size_t m_num_workers;
     nng_socket m_sock;
     std::vector<NngRpcWorker> m_workers;
     const Consensus::Params &m_consensus;
     const NodeContext &m_node;
+    SliceReader m_slice_reader;
+    /** Indexed by NngInterface::RpcRequest, NONE counts invalid requests */
+    std::array<NngRpcMethodMetrics, NngInterface::RpcRequest_MAX + 1>
+        m_metrics;
 
     NngRpcErrorCode GetBlock(flatbuffers::FlatBufferBuilder &builder,
                              const NngInterface::GetBlockRequest *request);
@@ -134,12 +435,24 @@ class NngRpcServer {
     NngRpcErrorCode GetMempool(flatbuffers::FlatBufferBuilder &builder,
                                const NngInterface::GetMempoolRequest *request);
 
+    NngRpcErrorCode
+    GetRawBlockRange(flatbuffers::FlatBufferBuilder &builder,
+                     const NngInterface::GetRawBlockRangeRequest *request);
+
+    NngRpcErrorCode GetSlices(flatbuffers::FlatBufferBuilder &builder,
+                              const NngInterface::GetSlicesRequest *request);
+
 public:
-    NngRpcServer(const Consensus::Params &consensus, const NodeContext &node)
-        : m_consensus(consensus), m_node(node) {}
+    NngRpcServer(const Consensus::Params &consensus, const NodeContext &node,
+                 size_t num_workers)
+        : m_num_workers(num_workers), m_consensus(consensus), m_node(node) {}
 
     NngRpcErrorCode HandleMsg(flatbuffers::FlatBufferBuilder &builder,
-                              nng_msg *incoming_msg);
+                              nng_msg *incoming_msg,
+                              NngInterface::RpcRequest &rpc_type);
+    void RecordMetrics(NngInterface::RpcRequest rpc_type, int64_t micros,
+                       size_t num_bytes, bool is_error);
+    NngRpcStats GetStats() const;
     bool Listen(const std::string &rpc_url);
     void Shutdown() {
         for (NngRpcWorker &worker : m_workers) {
@@ -155,14 +468,54 @@ bool NngRpcServer::Listen(const std::string &rpc_url) {
         strprintf("Failed listening on -nngrpc=%s: %%s", rpc_url);
     NNG_TRY_ERROR(nng_listen(m_sock, rpc_url.c_str(), NULL, 0),
                   listen_failure_msg.c_str());
-    m_workers.resize(NUM_WORKERS);
+    m_workers.resize(m_num_workers);
     for (NngRpcWorker &worker : m_workers) {
         worker.Init(m_sock, this);
     }
-    LogPrintf("NNG interface: RPC server listening at %s\n", rpc_url);
+    LogPrintf("NNG interface: RPC server listening at %s with %d workers\n",
+              rpc_url, m_num_workers);
     return true;
 }
 
+void NngRpcServer::RecordMetrics(NngInterface::RpcRequest rpc_type,
+                                 int64_t micros, size_t num_bytes,
+                                 bool is_error) {
+    m_metrics[rpc_type].Record(micros, num_bytes, is_error);
+}
+
+NngRpcStats NngRpcServer::GetStats() const {
+    NngRpcStats stats;
+    stats.num_workers = m_num_workers;
+    for (size_t idx = 0; idx < m_metrics.size(); ++idx) {
+        const NngRpcMethodMetrics &metrics = m_metrics[idx];
+        NngRpcMethodStats method_stats;
+        if (idx == NngInterface::RpcRequest_NONE) {
+            method_stats.method = "Invalid";
+        } else {
+            // GetBlockRequest -> GetBlock
+            method_stats.method = NngInterface::EnumNameRpcRequest(
+                NngInterface::RpcRequest(idx));
+            const std::string suffix = "Request";
+            if (method_stats.method.size() > suffix.size()) {
+                method_stats.method.resize(method_stats.method.size() -
+                                           suffix.size());
+            }
+        }
+        method_stats.num_calls = metrics.num_calls;
+        method_stats.num_errors = metrics.num_errors;
+        method_stats.total_micros = metrics.total_micros;
+        method_stats.total_bytes = metrics.total_bytes;
+        for (size_t bucket = 0; bucket < NNG_RPC_HISTOGRAM_BUCKETS; ++bucket) {
+            method_stats.latency_micros[bucket] =
+                metrics.latency_micros[bucket];
+            method_stats.response_bytes[bucket] =
+                metrics.response_bytes[bucket];
+        }
+        stats.methods.push_back(std::move(method_stats));
+    }
+    return stats;
+}
+
 NngRpcWorker::NngRpcWorker() {
     m_state = NngRpcWorkerState::UNINIT;
 }
@@ -193,24 +546,36 @@ void NngRpcWorker::HandleCallback() {
             break;
         case NngRpcWorkerState::RECV: {
             NNG_TRY_LOG(nng_aio_result(m_aio));
+            const int64_t start_time = GetTimeMicros();
             nng_msg *incoming_msg = nng_aio_get_msg(m_aio);
-            flatbuffers::FlatBufferBuilder fbb;
-            NngRpcErrorCode error_code = m_server->HandleMsg(fbb, incoming_msg);
-            flatbuffers::FlatBufferBuilder result_fbb(fbb.GetSize() + 256);
+            NngInterface::RpcRequest rpc_type = NngInterface::RpcRequest_NONE;
+            NngRpcErrorCode error_code =
+                m_server->HandleMsg(m_fbb, incoming_msg, rpc_type);
             if (error_code == NngRpcErrorCode::NO_RPC_ERROR) {
-                result_fbb.Finish(NngInterface::CreateRpcResult(
-                    result_fbb, true, 0, result_fbb.CreateString(""),
-                    result_fbb.CreateVector(fbb.GetBufferPointer(),
-                                            fbb.GetSize())));
+                // The finished response becomes the data of the RpcResult
+                // once prefixed with its size. Finished buffers are aligned
+                // to their root offset, so no padding goes in between.
+                const size_t data_size = m_fbb.GetSize();
+                m_fbb.StartVector(0, sizeof(uint8_t));
+                const flatbuffers::Offset<flatbuffers::Vector<uint8_t>> data =
+                    m_fbb.EndVector(data_size);
+                const auto error_msg = m_fbb.CreateString("");
+                m_fbb.Finish(NngInterface::CreateRpcResult(m_fbb, true, 0,
+                                                           error_msg, data));
             } else {
-                result_fbb.Finish(NngInterface::CreateRpcResult(
-                    result_fbb, false, int32_t(error_code),
-                    result_fbb.CreateString(ErrorMsg(error_code))));
+                m_fbb.Clear();
+                m_fbb.Finish(NngInterface::CreateRpcResult(
+                    m_fbb, false, int32_t(error_code),
+                    m_fbb.CreateString(ErrorMsg(error_code))));
             }
-            nng_msg *outgoing_msg;
-            NNG_TRY_LOG(nng_msg_alloc(&outgoing_msg, result_fbb.GetSize()));
-            memcpy(nng_msg_body(outgoing_msg),
-                   (void *)result_fbb.GetBufferPointer(), result_fbb.GetSize());
+            const size_t result_size = m_fbb.GetSize();
+            nng_msg *outgoing_msg = m_allocator.TakeMsg(m_fbb);
+            // The next request gets a new message
+            m_fbb.Release();
+            m_server->RecordMetrics(rpc_type, GetTimeMicros() - start_time,
+                                    result_size,
+                                    error_code !=
+                                        NngRpcErrorCode::NO_RPC_ERROR);
             nng_aio_set_msg(m_aio, outgoing_msg);
             m_state = NngRpcWorkerState::SEND;
             nng_ctx_send(m_ctx, m_aio);
@@ -229,7 +594,8 @@ void NngRpcWorker::HandleCallback() {
 }
 
 NngRpcErrorCode NngRpcServer::HandleMsg(flatbuffers::FlatBufferBuilder &fbb,
-                                        nng_msg *incoming_msg) {
+                                        nng_msg *incoming_msg,
+                                        NngInterface::RpcRequest &rpc_type) {
     flatbuffers::Verifier verifier((uint8_t *)nng_msg_body(incoming_msg),
                                    nng_msg_len(incoming_msg));
     if (!verifier.VerifyBuffer<NngInterface::RpcCall>()) {
@@ -237,7 +603,11 @@ NngRpcErrorCode NngRpcServer::HandleMsg(flatbuffers::FlatBufferBuilder &fbb,
     }
     const NngInterface::RpcCall *rpc =
         flatbuffers::GetRoot<NngInterface::RpcCall>(nng_msg_body(incoming_msg));
-    switch (rpc->rpc_type()) {
+    if (rpc->rpc_type() > NngInterface::RpcRequest_MAX) {
+        return NngRpcErrorCode::UNKNOWN_RPC_METHOD;
+    }
+    rpc_type = rpc->rpc_type();
+    switch (rpc_type) {
         case NngInterface::RpcRequest_GetBlockRequest: {
             return GetBlock(fbb, rpc->rpc_as_GetBlockRequest());
         }
@@ -253,6 +623,12 @@ NngRpcErrorCode NngRpcServer::HandleMsg(flatbuffers::FlatBufferBuilder &fbb,
         case NngInterface::RpcRequest_GetMempoolRequest: {
             return GetMempool(fbb, rpc->rpc_as_GetMempoolRequest());
         }
+        case NngInterface::RpcRequest_GetRawBlockRangeRequest: {
+            return GetRawBlockRange(fbb, rpc->rpc_as_GetRawBlockRangeRequest());
+        }
+        case NngInterface::RpcRequest_GetSlicesRequest: {
+            return GetSlices(fbb, rpc->rpc_as_GetSlicesRequest());
+        }
         default:
             return NngRpcErrorCode::UNKNOWN_RPC_METHOD;
     }
@@ -392,33 +768,47 @@ CreateFbsBlockMetadata(flatbuffers::FlatBufferBuilder &fbb,
                          metadata_field.vData.size()));
 }
 
-size_t GetFirstBlockTxOffset(const CBlock &block, const CBlockIndex *pindex) {
-    return pindex->nDataPos + ::GetSerializeSize(CBlockHeader()) +
+/**
+ * File positions and undo data of a block, copied from its CBlockIndex and
+ * the undo file so the block can be encoded later on.
+ */
+struct BlockFileData {
+    int file;
+    unsigned int data_pos;
+    unsigned int undo_pos;
+    //! Genesis block doesn't have undo data
+    bool has_undo;
+    CBlockUndo block_undo;
+};
+
+bool ReadBlockFileData(BlockFileData &data, const CBlockIndex *pindex) {
+    data.file = pindex->nFile;
+    data.data_pos = pindex->nDataPos;
+    data.undo_pos = pindex->nUndoPos;
+    data.has_undo = pindex->nHeight != 0;
+    return !data.has_undo || UndoReadFromDisk(data.block_undo, pindex);
+}
+
+size_t GetFirstBlockTxOffset(const CBlock &block, const BlockFileData &data) {
+    return data.data_pos + ::GetSerializeSize(CBlockHeader()) +
            ::GetSerializeSize(block.vMetadata, CLIENT_VERSION) +
            GetSizeOfCompactSize(block.vtx.size());
 }
 
-size_t GetFirstUndoOffset(const CBlock &block, const CBlockIndex *pindex) {
-    return pindex->nUndoPos + GetSizeOfCompactSize(block.vtx.size() - 1);
+size_t GetFirstUndoOffset(const CBlock &block, const BlockFileData &data) {
+    return data.undo_pos + GetSizeOfCompactSize(block.vtx.size() - 1);
 }
 
 flatbuffers::Offset<NngInterface::Block>
 CreateFbsBlock(flatbuffers::FlatBufferBuilder &fbb, const CBlock &block,
-               const CBlockIndex *pindex) {
-    size_t nDataPos = GetFirstBlockTxOffset(block, pindex);
-    size_t nUndoPos = 0;
-    CBlockUndo block_undo;
-    if (pindex->nHeight) { // Genesis block doesn't have undo data
-        nUndoPos = GetFirstUndoOffset(block, pindex);
-        if (!UndoReadFromDisk(block_undo, pindex)) {
-            return 0;
-        }
-    }
+               const BlockFileData &data) {
+    size_t nDataPos = GetFirstBlockTxOffset(block, data);
+    size_t nUndoPos = data.has_undo ? GetFirstUndoOffset(block, data) : 0;
     std::vector<flatbuffers::Offset<NngInterface::BlockTx>> txs_fbs;
     for (size_t tx_idx = 0; tx_idx < block.vtx.size(); ++tx_idx) {
-        std::optional<std::vector<Coin> *> spent_coins =
+        std::optional<const std::vector<Coin> *> spent_coins =
             tx_idx != 0
-                ? std::optional(&block_undo.vtxundo[tx_idx - 1].vprevout)
+                ? std::optional(&data.block_undo.vtxundo[tx_idx - 1].vprevout)
                 : std::nullopt;
         txs_fbs.push_back(CreateFbsBlockTx(fbb, block.vtx[tx_idx], spent_coins,
                                            nDataPos, nUndoPos));
@@ -429,8 +819,19 @@ CreateFbsBlock(flatbuffers::FlatBufferBuilder &fbb, const CBlock &block,
     }
     return NngInterface::CreateBlock(
         fbb, CreateFbsBlockHeader(fbb, block.GetBlockHeader()),
-        fbb.CreateVector(metadata), fbb.CreateVector(txs_fbs), pindex->nFile,
-        pindex->nDataPos, pindex->nUndoPos);
+        fbb.CreateVector(metadata), fbb.CreateVector(txs_fbs), data.file,
+        data.data_pos, data.undo_pos);
+}
+
+/** Returns a null offset if the undo data of the block can't be read */
+flatbuffers::Offset<NngInterface::Block>
+CreateFbsBlock(flatbuffers::FlatBufferBuilder &fbb, const CBlock &block,
+               const CBlockIndex *pindex) {
+    BlockFileData data;
+    if (!ReadBlockFileData(data, pindex)) {
+        return 0;
+    }
+    return CreateFbsBlock(fbb, block, data);
 }
 
 NngRpcErrorCode
@@ -447,8 +848,12 @@ NngRpcServer::GetBlock(flatbuffers::FlatBufferBuilder &fbb,
     if (!ReadBlockFromDisk(block, pindex, m_consensus)) {
         return NngRpcErrorCode::BLOCK_DATA_CORRUPTED;
     }
-    fbb.Finish(NngInterface::CreateGetBlockResponse(
-        fbb, CreateFbsBlock(fbb, block, pindex)));
+    const flatbuffers::Offset<NngInterface::Block> block_fbs =
+        CreateFbsBlock(fbb, block, pindex);
+    if (block_fbs.IsNull()) {
+        return NngRpcErrorCode::BLOCK_DATA_CORRUPTED;
+    }
+    fbb.Finish(NngInterface::CreateGetBlockResponse(fbb, block_fbs));
     return NngRpcErrorCode::NO_RPC_ERROR;
 }
 
@@ -480,6 +885,9 @@ NngRpcServer::GetBlockRange(flatbuffers::FlatBufferBuilder &fbb,
             return NngRpcErrorCode::BLOCK_DATA_CORRUPTED;
         }
         *block_fbs = CreateFbsBlock(fbb, block, pindex);
+        if (block_fbs->IsNull()) {
+            return NngRpcErrorCode::BLOCK_DATA_CORRUPTED;
+        }
         pindex = pindex->pprev;
     }
     fbb.Finish(NngInterface::CreateGetBlockRangeResponse(
@@ -487,67 +895,341 @@ NngRpcServer::GetBlockRange(flatbuffers::FlatBufferBuilder &fbb,
     return NngRpcErrorCode::NO_RPC_ERROR;
 }
 
+/**
+ * Upper bound of the undo data of a block of max_block_size bytes. Every input
+ * takes at least 41 bytes of the block (outpoint, empty script and sequence)
+ * and restores a coin whose script, being spendable, takes at most
+ * MAX_SCRIPT_SIZE bytes, next to its height, amount and script size.
+ */
+uint64_t GetMaxBlockUndoSize(uint64_t max_block_size) {
+    return max_block_size / 41 * (MAX_SCRIPT_SIZE + 32);
+}
+
+/**
+ * Read the size prefixing the record at pos of a block or undo file, which is
+ * stored right before pos. Fails if it exceeds max_size.
+ */
+bool ReadRawRecordSize(SliceReader &reader, NngInterface::SliceFile file_type,
+                       const FlatFilePos &pos, uint64_t max_size,
+                       uint32_t &size) {
+    uint8_t size_bytes[4];
+    if (pos.nPos < sizeof(size_bytes) ||
+        !reader.Read(file_type, pos.nFile, pos.nPos - sizeof(size_bytes),
+                     {Span<uint8_t>(size_bytes, sizeof(size_bytes))})) {
+        return false;
+    }
+    size = ReadLE32(size_bytes);
+    return size <= max_size;
+}
+
+/**
+ * Read the record of the given size at pos of a block or undo file straight
+ * into a new vector of fbb.
+ */
+bool CreateFbsRawRecord(
+    flatbuffers::FlatBufferBuilder &fbb, SliceReader &reader,
+    NngInterface::SliceFile file_type, const FlatFilePos &pos, uint32_t size,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> &raw) {
+    uint8_t *data;
+    raw = fbb.CreateUninitializedVector(size, &data);
+    return reader.Read(file_type, pos.nFile, pos.nPos,
+                       {Span<uint8_t>(data, size)});
+}
+
+NngRpcErrorCode NngRpcServer::GetRawBlockRange(
+    flatbuffers::FlatBufferBuilder &fbb,
+    const NngInterface::GetRawBlockRangeRequest *request) {
+    struct RawBlockPos {
+        BlockHash block_hash;
+        int32_t height;
+        FlatFilePos data_pos;
+        FlatFilePos undo_pos;
+        uint32_t size;
+        uint32_t undo_size;
+    };
+
+    // Only look up where the blocks are while holding cs_main, the files are
+    // read without it.
+    std::vector<RawBlockPos> positions;
+    const int32_t start_height = request->start_height();
+    {
+        LOCK(cs_main);
+        const int32_t chain_height = ::ChainActive().Height();
+        if (start_height >= 0 && start_height <= chain_height &&
+            request->num_blocks() > 0) {
+            const int32_t end_height = int32_t(std::min<int64_t>(
+                int64_t(start_height) + request->num_blocks() - 1,
+                chain_height));
+            positions.resize(end_height - start_height + 1);
+            const CBlockIndex *pindex =
+                ::ChainActive().Tip()->GetAncestor(end_height);
+            for (auto pos = positions.rbegin(); pos != positions.rend();
+                 ++pos) {
+                if (!pindex->nStatus.hasData()) {
+                    return NngRpcErrorCode::BLOCK_DATA_CORRUPTED;
+                }
+                pos->block_hash = pindex->GetBlockHash();
+                pos->height = pindex->nHeight;
+                pos->data_pos = pindex->GetBlockPos();
+                pos->undo_pos = pindex->GetUndoPos();
+                pindex = pindex->pprev;
+            }
+        }
+    }
+
+    // Read the record sizes first, so the response is allocated once and the
+    // records are read straight into the message sent back.
+    const uint64_t max_block_size = GetConfig().GetMaxBlockSize();
+    const uint64_t max_undo_size = GetMaxBlockUndoSize(max_block_size);
+    const uint64_t max_bytes = request->max_bytes()
+                                   ? request->max_bytes()
+                                   : DEFAULT_RAW_BLOCK_RANGE_MAX_BYTES;
+    uint64_t total_bytes = 0;
+    uint64_t response_size = RAW_BLOCK_RANGE_OVERHEAD;
+    size_t num_blocks = 0;
+    for (RawBlockPos &pos : positions) {
+        if (num_blocks > 0 && total_bytes >= max_bytes) {
+            break;
+        }
+        if (!ReadRawRecordSize(m_slice_reader, NngInterface::SliceFile_Block,
+                               pos.data_pos, max_block_size, pos.size)) {
+            return NngRpcErrorCode::BLOCK_DATA_CORRUPTED;
+        }
+        pos.undo_size = 0;
+        // Genesis block doesn't have undo data
+        if (!pos.undo_pos.IsNull() &&
+            !ReadRawRecordSize(m_slice_reader, NngInterface::SliceFile_Undo,
+                               pos.undo_pos, max_undo_size, pos.undo_size)) {
+            return NngRpcErrorCode::BLOCK_DATA_CORRUPTED;
+        }
+        const uint64_t block_bytes = uint64_t(pos.size) + pos.undo_size;
+        if (response_size + block_bytes + RAW_BLOCK_OVERHEAD >=
+            FLATBUFFERS_MAX_BUFFER_SIZE) {
+            if (num_blocks == 0) {
+                return NngRpcErrorCode::BLOCK_DATA_CORRUPTED;
+            }
+            break;
+        }
+        total_bytes += block_bytes;
+        response_size += block_bytes + RAW_BLOCK_OVERHEAD;
+        ++num_blocks;
+    }
+    positions.resize(num_blocks);
+
+    // Reserve the whole response, the builder then never moves the records
+    // read so far to a bigger buffer.
+    uint8_t *reserved;
+    fbb.CreateUninitializedVector(response_size, sizeof(uint8_t), &reserved);
+    fbb.Clear();
+
+    std::vector<flatbuffers::Offset<NngInterface::RawBlock>> blocks_fbs;
+    for (const RawBlockPos &pos : positions) {
+        flatbuffers::Offset<flatbuffers::Vector<uint8_t>> raw, raw_undo;
+        if (!CreateFbsRawRecord(fbb, m_slice_reader,
+                                NngInterface::SliceFile_Block, pos.data_pos,
+                                pos.size, raw)) {
+            return NngRpcErrorCode::BLOCK_DATA_CORRUPTED;
+        }
+        if (!pos.undo_pos.IsNull() &&
+            !CreateFbsRawRecord(fbb, m_slice_reader,
+                                NngInterface::SliceFile_Undo, pos.undo_pos,
+                                pos.undo_size, raw_undo)) {
+            return NngRpcErrorCode::BLOCK_DATA_CORRUPTED;
+        }
+        blocks_fbs.push_back(NngInterface::CreateRawBlock(
+            fbb, CreateFbsBlockHash(fbb, pos.block_hash), pos.height,
+            pos.data_pos.nFile, pos.data_pos.nPos,
+            pos.undo_pos.IsNull() ? 0 : pos.undo_pos.nPos, raw, raw_undo));
+    }
+    fbb.Finish(NngInterface::CreateGetRawBlockRangeResponse(
+        fbb, fbb.CreateVector(blocks_fbs),
+        start_height + int32_t(blocks_fbs.size())));
+    return NngRpcErrorCode::NO_RPC_ERROR;
+}
+
 NngRpcErrorCode
 NngRpcServer::GetBlockSlice(flatbuffers::FlatBufferBuilder &fbb,
                             const NngInterface::GetBlockSliceRequest *request) {
-    const FlatFilePos filePos(request->file_num(), request->data_pos());
-    CAutoFile file(OpenBlockFile(filePos, true), SER_DISK, CLIENT_VERSION);
-    std::vector<uint8_t> data(request->num_bytes());
-    try {
-        file.read((char *)data.data(), request->num_bytes());
-    } catch (const std::exception &e) {
+    if (request->num_bytes() > MAX_SLICES_BYTES) {
+        return NngRpcErrorCode::SLICES_TOO_LARGE;
+    }
+    uint8_t *data;
+    auto data_fbs = fbb.CreateUninitializedVector(request->num_bytes(), &data);
+    if (!m_slice_reader.Read(NngInterface::SliceFile_Block,
+                             request->file_num(), request->data_pos(),
+                             {{data, request->num_bytes()}})) {
         return NngRpcErrorCode::INVALID_BLOCK_SLICE;
     }
-    fbb.Finish(
-        NngInterface::CreateGetBlockSliceResponse(fbb, fbb.CreateVector(data)));
+    fbb.Finish(NngInterface::CreateGetBlockSliceResponse(fbb, data_fbs));
     return NngRpcErrorCode::NO_RPC_ERROR;
 }
 
 NngRpcErrorCode
 NngRpcServer::GetUndoSlice(flatbuffers::FlatBufferBuilder &fbb,
                            const NngInterface::GetUndoSliceRequest *request) {
-    const FlatFilePos filePos(request->file_num(), request->undo_pos());
-    CAutoFile file(OpenUndoFile(filePos, true), SER_DISK, CLIENT_VERSION);
-    std::vector<uint8_t> data(request->num_bytes());
-    try {
-        file.read((char *)data.data(), request->num_bytes());
-    } catch (const std::exception &e) {
+    if (request->num_bytes() > MAX_SLICES_BYTES) {
+        return NngRpcErrorCode::SLICES_TOO_LARGE;
+    }
+    uint8_t *data;
+    auto data_fbs = fbb.CreateUninitializedVector(request->num_bytes(), &data);
+    if (!m_slice_reader.Read(NngInterface::SliceFile_Undo, request->file_num(),
+                             request->undo_pos(),
+                             {{data, request->num_bytes()}})) {
         return NngRpcErrorCode::INVALID_BLOCK_SLICE;
     }
-    fbb.Finish(
-        NngInterface::CreateGetUndoSliceResponse(fbb, fbb.CreateVector(data)));
+    fbb.Finish(NngInterface::CreateGetUndoSliceResponse(fbb, data_fbs));
+    return NngRpcErrorCode::NO_RPC_ERROR;
+}
+
+NngRpcErrorCode
+NngRpcServer::GetSlices(flatbuffers::FlatBufferBuilder &fbb,
+                        const NngInterface::GetSlicesRequest *request) {
+    struct SliceRead {
+        const NngInterface::Slice *slice;
+        uint64_t offset;
+    };
+
+    std::vector<SliceRead> reads;
+    uint64_t total_bytes = 0;
+    if (request->slices()) {
+        reads.reserve(request->slices()->size());
+        for (const NngInterface::Slice *slice : *request->slices()) {
+            reads.push_back({slice, total_bytes});
+            total_bytes += slice->num_bytes();
+            if (total_bytes > MAX_SLICES_BYTES) {
+                return NngRpcErrorCode::SLICES_TOO_LARGE;
+            }
+        }
+    }
+    // The slices are read straight into the response
+    uint8_t *data;
+    auto data_fbs = fbb.CreateUninitializedVector(total_bytes, &data);
+
+    std::sort(reads.begin(), reads.end(),
+              [](const SliceRead &a, const SliceRead &b) {
+                  return std::make_tuple(a.slice->file(), a.slice->file_num(),
+                                         a.slice->pos()) <
+                         std::make_tuple(b.slice->file(), b.slice->file_num(),
+                                         b.slice->pos());
+              });
+    std::vector<uint8_t> gap;
+    std::vector<Span<uint8_t>> bufs;
+    size_t idx = 0;
+    while (idx < reads.size()) {
+        // Merge the following slices of the same file into a single read, as
+        // long as they don't overlap and the gaps between them are small.
+        const NngInterface::Slice *first = reads[idx].slice;
+        uint64_t end_pos = uint64_t(first->pos()) + first->num_bytes();
+        bufs.assign({{data + reads[idx].offset, first->num_bytes()}});
+        for (++idx; idx < reads.size(); ++idx) {
+            const NngInterface::Slice *slice = reads[idx].slice;
+            if (slice->file() != first->file() ||
+                slice->file_num() != first->file_num() ||
+                slice->pos() < end_pos ||
+                slice->pos() - end_pos > MAX_SLICE_GAP) {
+                break;
+            }
+            if (slice->pos() > end_pos) {
+                gap.resize(MAX_SLICE_GAP);
+                bufs.push_back({gap.data(), size_t(slice->pos() - end_pos)});
+            }
+            bufs.push_back({data + reads[idx].offset, slice->num_bytes()});
+            end_pos = uint64_t(slice->pos()) + slice->num_bytes();
+        }
+        if (!m_slice_reader.Read(first->file(), first->file_num(), first->pos(),
+                                 bufs)) {
+            return NngRpcErrorCode::INVALID_BLOCK_SLICE;
+        }
+    }
+    fbb.Finish(NngInterface::CreateGetSlicesResponse(fbb, data_fbs));
     return NngRpcErrorCode::NO_RPC_ERROR;
 }
 
 NngRpcErrorCode
 NngRpcServer::GetMempool(flatbuffers::FlatBufferBuilder &fbb,
                          const NngInterface::GetMempoolRequest *request) {
-    LOCK(m_node.mempool->cs);
-    std::vector<flatbuffers::Offset<NngInterface::MempoolTx>> txs_fbs;
-    for (const CTxMemPoolEntry &entry : m_node.mempool->mapTx) {
-        std::map<COutPoint, Coin> spent_coins_map;
-        for (const CTxIn &input : entry.GetSharedTx()->vin) {
-            spent_coins_map[input.prevout] = Coin();
+    struct MempoolSnapshotEntry {
+        uint64_t entry_sequence;
+        CTransactionRef tx;
+        int64_t time;
+    };
+
+    // Only copy the entries of interest while holding the mempool lock;
+    // ordering, coin lookup and encoding are done without it.
+    std::vector<MempoolSnapshotEntry> snapshot;
+    {
+        LOCK(m_node.mempool->cs);
+        snapshot.reserve(m_node.mempool->mapTx.size());
+        for (const CTxMemPoolEntry &entry : m_node.mempool->mapTx) {
+            if (entry.m_entry_sequence >= request->start_entry_sequence()) {
+                snapshot.push_back({entry.m_entry_sequence,
+                                    entry.GetSharedTx(),
+                                    entry.GetTime().count()});
+            }
         }
+    }
+    std::sort(snapshot.begin(), snapshot.end(),
+              [](const MempoolSnapshotEntry &a, const MempoolSnapshotEntry &b) {
+                  return a.entry_sequence < b.entry_sequence;
+              });
+    if (request->max_txs() != 0 && snapshot.size() > request->max_txs()) {
+        snapshot.resize(request->max_txs());
+    }
+
+    // Look up the spent coins a chunk of txs at a time, releasing cs_main and
+    // the mempool lock in between. Txs which left the mempool since the
+    // snapshot may spend coins which can't be found anymore, those are
+    // skipped.
+    std::vector<flatbuffers::Offset<NngInterface::MempoolTx>> txs_fbs;
+    txs_fbs.reserve(snapshot.size());
+    std::map<COutPoint, Coin> spent_coins_map;
+    std::vector<Coin> spent_coins;
+    size_t chunk_end = 0;
+    while (chunk_end < snapshot.size()) {
+        const size_t chunk_begin = chunk_end;
+        spent_coins_map.clear();
+        do {
+            for (const CTxIn &input : snapshot[chunk_end].tx->vin) {
+                spent_coins_map.emplace(input.prevout, Coin());
+            }
+            ++chunk_end;
+        } while (chunk_end < snapshot.size() &&
+                 spent_coins_map.size() + snapshot[chunk_end].tx->vin.size() <=
+                     MEMPOOL_COINS_CHUNK_SIZE);
         FindCoins(m_node, spent_coins_map);
-        std::vector<Coin> spent_coin;
-        spent_coin.reserve(spent_coins_map.size());
-        for (const CTxIn &input : entry.GetSharedTx()->vin) {
-            spent_coin.push_back(spent_coins_map[input.prevout]);
+
+        for (size_t idx = chunk_begin; idx < chunk_end; ++idx) {
+            const MempoolSnapshotEntry &entry = snapshot[idx];
+            spent_coins.clear();
+            for (const CTxIn &input : entry.tx->vin) {
+                const Coin &coin = spent_coins_map.at(input.prevout);
+                if (coin.IsSpent()) {
+                    break;
+                }
+                spent_coins.push_back(coin);
+            }
+            if (spent_coins.size() < entry.tx->vin.size()) {
+                continue;
+            }
+            txs_fbs.push_back(NngInterface::CreateMempoolTx(
+                fbb, CreateFbsTxMempool(fbb, entry.tx, spent_coins),
+                entry.time, entry.entry_sequence));
         }
-        txs_fbs.push_back(NngInterface::CreateMempoolTx(
-            fbb, CreateFbsTxMempool(fbb, entry.GetSharedTx(), spent_coin),
-            entry.GetTime().count()));
     }
-    fbb.Finish(
-        NngInterface::CreateGetMempoolResponse(fbb, fbb.CreateVector(txs_fbs)));
+    const uint64_t next_entry_sequence =
+        snapshot.empty() ? request->start_entry_sequence()
+                         : snapshot.back().entry_sequence + 1;
+    fbb.Finish(NngInterface::CreateGetMempoolResponse(
+        fbb, fbb.CreateVector(txs_fbs), next_entry_sequence));
     return NngRpcErrorCode::NO_RPC_ERROR;
 }
 
 class NngPubServer final : public CValidationInterface {
 public:
-    NngPubServer(std::set<std::string> enabled_messages)
-        : m_enabled_messages(enabled_messages) {}
+    NngPubServer(std::set<std::string> enabled_messages, size_t max_queue_size,
+                 bool drop_when_full)
+        : m_enabled_messages(enabled_messages),
+          m_max_queue_size(max_queue_size), m_drop_when_full(drop_when_full) {}
 
     bool Listen(const std::string &pub_url) {
         NNG_TRY_ERROR(nng_pub0_open(&m_sock),
@@ -557,15 +1239,131 @@ public:
         NNG_TRY_ERROR(nng_listen(m_sock, pub_url.c_str(), NULL, 0),
                       listen_failure_msg.c_str());
         LogPrintf("NNG interface: pubsub server listening at %s\n", pub_url);
+        m_thread_publish = std::thread(&TraceThread<std::function<void()>>,
+                                       "nngpub",
+                                       std::bind(&NngPubServer::Publish, this));
         RegisterValidationInterface(this);
         return true;
     }
 
-    void Shutdown() { nng_close(m_sock); }
+    void Shutdown() {
+        UnregisterValidationInterface(this);
+        {
+            LOCK(m_queue_mutex);
+            m_stop = true;
+        }
+        m_queue_cond.notify_all();
+        if (m_thread_publish.joinable()) {
+            m_thread_publish.join();
+        }
+        nng_close(m_sock);
+    }
+
+    NngPubStats GetStats() {
+        LOCK(m_queue_mutex);
+        return {m_queue.size(), m_max_queue_depth, m_num_published,
+                m_num_dropped};
+    }
 
 private:
+    /**
+     * A message waiting to be published. The encoder only captures the data
+     * the notification was called with, and the undo data of blocks, building
+     * the flatbuffer is left to the publisher thread.
+     */
+    struct PubMessage {
+        const std::string *msg_type;
+        std::function<void(flatbuffers::FlatBufferBuilder &)> encode;
+    };
+
     nng_socket m_sock;
     std::set<std::string> m_enabled_messages;
+    const size_t m_max_queue_size;
+    const bool m_drop_when_full;
+
+    std::thread m_thread_publish;
+    Mutex m_queue_mutex;
+    std::condition_variable m_queue_cond;
+    std::deque<PubMessage> m_queue GUARDED_BY(m_queue_mutex);
+    bool m_stop GUARDED_BY(m_queue_mutex){false};
+    size_t m_max_queue_depth GUARDED_BY(m_queue_mutex){0};
+    uint64_t m_num_published GUARDED_BY(m_queue_mutex){0};
+    uint64_t m_num_dropped GUARDED_BY(m_queue_mutex){0};
+
+    /**
+     * Called from the validation interface thread. Waits for room in the
+     * queue, or drops the message if -nngpubpolicy=drop.
+     */
+    void EnqueueMessage(
+        const std::string &msg_type,
+        std::function<void(flatbuffers::FlatBufferBuilder &)> encode) {
+        {
+            WAIT_LOCK(m_queue_mutex, lock);
+            if (m_queue.size() >= m_max_queue_size) {
+                if (m_drop_when_full) {
+                    if (m_num_dropped++ % 1000 == 0) {
+                        LogPrintf("NNG interface: publisher queue full, "
+                                  "dropped %d messages so far\n",
+                                  m_num_dropped);
+                    }
+                    return;
+                }
+                while (!m_stop && m_queue.size() >= m_max_queue_size) {
+                    m_queue_cond.wait(lock);
+                }
+                if (m_stop) {
+                    return;
+                }
+            }
+            m_queue.push_back({&msg_type, std::move(encode)});
+            m_max_queue_depth = std::max(m_max_queue_depth, m_queue.size());
+        }
+        m_queue_cond.notify_all();
+    }
+
+    /** Publisher thread, encodes and sends the queued messages in order */
+    void Publish() {
+        while (true) {
+            PubMessage msg;
+            {
+                WAIT_LOCK(m_queue_mutex, lock);
+                while (!m_stop && m_queue.empty()) {
+                    m_queue_cond.wait(lock);
+                }
+                if (m_queue.empty()) {
+                    return;
+                }
+                msg = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            // Wake up the validation interface thread if it waits for room
+            m_queue_cond.notify_all();
+            flatbuffers::FlatBufferBuilder fbb;
+            msg.encode(fbb);
+            BroadcastMessage(*msg.msg_type, fbb);
+            LOCK(m_queue_mutex);
+            ++m_num_published;
+        }
+    }
+
+    /**
+     * Read the positions and undo data a block message is encoded from, so
+     * the message doesn't depend on the block index or the undo file, which
+     * may be pruned by the time it is published.
+     */
+    std::shared_ptr<const BlockFileData>
+    ReadQueuedBlockFileData(const std::string &msg_type,
+                            const CBlockIndex *pindex) {
+        auto data = std::make_shared<BlockFileData>();
+        LOCK(cs_main);
+        if (!ReadBlockFileData(*data, pindex)) {
+            LogPrintf("NNG interface: failed reading the undo data of block "
+                      "%s, not publishing %s\n",
+                      pindex->GetBlockHash().ToString(), msg_type);
+            return nullptr;
+        }
+        return data;
+    }
 
     void BroadcastMessage(const std::string msg_type,
                           const flatbuffers::FlatBufferBuilder &fbb) {
@@ -582,10 +1380,12 @@ private:
         if (!IsMessageEnabled(MSG_UPDATEBLKTIP)) {
             return;
         }
-        flatbuffers::FlatBufferBuilder fbb;
-        fbb.Finish(NngInterface::CreateUpdatedBlockTip(
-            fbb, CreateFbsBlockHash(fbb, pindexNew->GetBlockHash())));
-        BroadcastMessage(MSG_UPDATEBLKTIP, fbb);
+        const BlockHash block_hash = pindexNew->GetBlockHash();
+        EnqueueMessage(MSG_UPDATEBLKTIP,
+                       [block_hash](flatbuffers::FlatBufferBuilder &fbb) {
+                           fbb.Finish(NngInterface::CreateUpdatedBlockTip(
+                               fbb, CreateFbsBlockHash(fbb, block_hash)));
+                       });
     }
 
     void
@@ -595,12 +1395,15 @@ private:
         if (!IsMessageEnabled(MSG_MEMPOOLTXADD)) {
             return;
         }
-        flatbuffers::FlatBufferBuilder fbb;
-        fbb.Finish(NngInterface::CreateTransactionAddedToMempool(
-            fbb, NngInterface::CreateMempoolTx(
-                     fbb, CreateFbsTxMempool(fbb, ptx, spent_coins),
-                     GetAdjustedTime())));
-        BroadcastMessage(MSG_MEMPOOLTXADD, fbb);
+        const int64_t time = GetAdjustedTime();
+        EnqueueMessage(
+            MSG_MEMPOOLTXADD,
+            [ptx, spent_coins, time](flatbuffers::FlatBufferBuilder &fbb) {
+                fbb.Finish(NngInterface::CreateTransactionAddedToMempool(
+                    fbb,
+                    NngInterface::CreateMempoolTx(
+                        fbb, CreateFbsTxMempool(fbb, ptx, spent_coins), time)));
+            });
     }
 
     void TransactionRemovedFromMempool(const CTransactionRef &ptx,
@@ -609,10 +1412,12 @@ private:
         if (!IsMessageEnabled(MSG_MEMPOOLTXREM)) {
             return;
         }
-        flatbuffers::FlatBufferBuilder fbb;
-        fbb.Finish(NngInterface::CreateTransactionRemovedFromMempool(
-            fbb, CreateFbsTxId(fbb, ptx->GetId())));
-        BroadcastMessage(MSG_MEMPOOLTXREM, fbb);
+        const TxId txid = ptx->GetId();
+        EnqueueMessage(
+            MSG_MEMPOOLTXREM, [txid](flatbuffers::FlatBufferBuilder &fbb) {
+                fbb.Finish(NngInterface::CreateTransactionRemovedFromMempool(
+                    fbb, CreateFbsTxId(fbb, txid)));
+            });
     }
 
     void BlockConnected(const std::shared_ptr<const CBlock> &block,
@@ -620,10 +1425,17 @@ private:
         if (!IsMessageEnabled(MSG_BLKCONNECTED)) {
             return;
         }
-        flatbuffers::FlatBufferBuilder fbb;
-        fbb.Finish(NngInterface::CreateBlockConnected(
-            fbb, CreateFbsBlock(fbb, *block, pindex), /*txs_conflicted=*/0));
-        BroadcastMessage(MSG_BLKCONNECTED, fbb);
+        std::shared_ptr<const BlockFileData> data =
+            ReadQueuedBlockFileData(MSG_BLKCONNECTED, pindex);
+        if (!data) {
+            return;
+        }
+        EnqueueMessage(MSG_BLKCONNECTED,
+                       [block, data](flatbuffers::FlatBufferBuilder &fbb) {
+                           fbb.Finish(NngInterface::CreateBlockConnected(
+                               fbb, CreateFbsBlock(fbb, *block, *data),
+                               /*txs_conflicted=*/0));
+                       });
     }
 
     void BlockDisconnected(const std::shared_ptr<const CBlock> &block,
@@ -631,10 +1443,16 @@ private:
         if (!IsMessageEnabled(MSG_BLKDISCONCTD)) {
             return;
         }
-        flatbuffers::FlatBufferBuilder fbb;
-        fbb.Finish(NngInterface::CreateBlockDisconnected(
-            fbb, CreateFbsBlock(fbb, *block, pindex)));
-        BroadcastMessage(MSG_BLKDISCONCTD, fbb);
+        std::shared_ptr<const BlockFileData> data =
+            ReadQueuedBlockFileData(MSG_BLKDISCONCTD, pindex);
+        if (!data) {
+            return;
+        }
+        EnqueueMessage(MSG_BLKDISCONCTD,
+                       [block, data](flatbuffers::FlatBufferBuilder &fbb) {
+                           fbb.Finish(NngInterface::CreateBlockDisconnected(
+                               fbb, CreateFbsBlock(fbb, *block, *data)));
+                       });
     }
 
     void ChainStateFlushed(const CBlockLocator &locator) override {
@@ -644,10 +1462,12 @@ private:
         if (locator.vHave.size() == 0) {
             return;
         }
-        flatbuffers::FlatBufferBuilder fbb;
-        fbb.Finish(NngInterface::CreateChainStateFlushed(
-            fbb, CreateFbsBlockHash(fbb, locator.vHave[0])));
-        BroadcastMessage(MSG_CHAINSTFLUSH, fbb);
+        const BlockHash block_hash = locator.vHave[0];
+        EnqueueMessage(MSG_CHAINSTFLUSH,
+                       [block_hash](flatbuffers::FlatBufferBuilder &fbb) {
+                           fbb.Finish(NngInterface::CreateChainStateFlushed(
+                               fbb, CreateFbsBlockHash(fbb, block_hash)));
+                       });
     }
 
     bool IsMessageEnabled(const std::string &msg) {
@@ -661,7 +1481,15 @@ std::unique_ptr<NngPubServer> g_pub_server;
 bool RunRpcServer(const NodeContext &node, const Consensus::Params &consensus) {
     if (gArgs.IsArgSet("-nngrpc")) {
         std::string rpc_url = gArgs.GetArg("-nngrpc", "");
-        g_rpc_server = std::make_unique<NngRpcServer>(consensus, node);
+        const int64_t num_workers =
+            gArgs.GetArg("-nngrpcworkers", DEFAULT_NNG_RPC_WORKERS);
+        if (num_workers <= 0) {
+            return InitError(
+                strprintf(_("Invalid -nngrpcworkers=%d, must be positive."),
+                          num_workers));
+        }
+        g_rpc_server =
+            std::make_unique<NngRpcServer>(consensus, node, num_workers);
         if (!g_rpc_server->Listen(rpc_url)) {
             return false;
         }
@@ -690,7 +1518,22 @@ bool RunPubServer() {
             LogPrintf("Warning: Specified -nngpub, but no -nngpubmsg "
                       "enabled.\n");
         }
-        g_pub_server = std::make_unique<NngPubServer>(enabled_messages);
+        const int64_t max_queue_size =
+            gArgs.GetArg("-nngpubqueuesize", DEFAULT_NNG_PUB_QUEUE_SIZE);
+        if (max_queue_size <= 0) {
+            return InitError(
+                strprintf(_("Invalid -nngpubqueuesize=%d, must be positive."),
+                          max_queue_size));
+        }
+        const std::string policy =
+            gArgs.GetArg("-nngpubpolicy", DEFAULT_NNG_PUB_POLICY);
+        if (policy != NNG_PUB_POLICY_BLOCK && policy != NNG_PUB_POLICY_DROP) {
+            return InitError(strprintf(
+                _("Invalid -nngpubpolicy '%s', must be '%s' or '%s'."), policy,
+                NNG_PUB_POLICY_BLOCK, NNG_PUB_POLICY_DROP));
+        }
+        g_pub_server = std::make_unique<NngPubServer>(
+            enabled_messages, max_queue_size, policy == NNG_PUB_POLICY_DROP);
         if (!g_pub_server->Listen(pub_url)) {
             return false;
         }
@@ -719,3 +1562,19 @@ void StopNngInterface() {
         g_pub_server->Shutdown();
     }
 }
+
+bool GetNngRpcStats(NngRpcStats &stats) {
+    if (!g_rpc_server) {
+        return false;
+    }
+    stats = g_rpc_server->GetStats();
+    return true;
+}
+
+bool GetNngPubStats(NngPubStats &stats) {
+    if (!g_pub_server) {
+        return false;
+    }
+    stats = g_pub_server->GetStats();
+    return true;
+}
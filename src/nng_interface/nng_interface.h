@@ -2,6 +2,14 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#ifndef BITCOIN_NNG_INTERFACE_NNG_INTERFACE_H
+#define BITCOIN_NNG_INTERFACE_NNG_INTERFACE_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 struct NodeContext;
 namespace Consensus {
 struct Params;
@@ -19,6 +27,53 @@ const std::vector<std::string> AVAILABLE_PUB_MESSAGES = {
     MSG_BLKCONNECTED, MSG_BLKDISCONCTD, MSG_CHAINSTFLUSH,
 };
 
+/** Default number of concurrent NNG RPC requests */
+static const int DEFAULT_NNG_RPC_WORKERS = 64;
+
+/** Default number of messages the PubSub publisher thread may fall behind */
+static const size_t DEFAULT_NNG_PUB_QUEUE_SIZE = 1000;
+
+const std::string NNG_PUB_POLICY_BLOCK = "block";
+const std::string NNG_PUB_POLICY_DROP = "drop";
+const std::string DEFAULT_NNG_PUB_POLICY = NNG_PUB_POLICY_BLOCK;
+
+/** Counters of the PubSub publisher queue */
+struct NngPubStats {
+    size_t queue_depth;
+    size_t max_queue_depth;
+    uint64_t num_published;
+    uint64_t num_dropped;
+};
+
+/**
+ * Number of buckets of the NNG RPC histograms. Bucket 0 counts values of 0,
+ * bucket i counts values in [2^(i-1), 2^i), the last one everything above.
+ */
+static const size_t NNG_RPC_HISTOGRAM_BUCKETS = 32;
+
+/** Metrics of one NNG RPC method */
+struct NngRpcMethodStats {
+    std::string method;
+    uint64_t num_calls;
+    uint64_t num_errors;
+    uint64_t total_micros;
+    uint64_t total_bytes;
+    std::array<uint64_t, NNG_RPC_HISTOGRAM_BUCKETS> latency_micros;
+    std::array<uint64_t, NNG_RPC_HISTOGRAM_BUCKETS> response_bytes;
+};
+
+struct NngRpcStats {
+    size_t num_workers;
+    std::vector<NngRpcMethodStats> methods;
+};
+
 bool StartNngInterface(const NodeContext &node,
                        const Consensus::Params &consensus);
 void StopNngInterface();
+
+/** Returns false if the RPC server isn't running */
+bool GetNngRpcStats(NngRpcStats &stats);
+/** Returns false if the PubSub server isn't running */
+bool GetNngPubStats(NngPubStats &stats);
+
+#endif // BITCOIN_NNG_INTERFACE_NNG_INTERFACE_H
@@ -0,0 +1,152 @@
+// Copyright (c) 2021 The Logos Foundation
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <nng_interface/nngrpc.h>
+
+#include <nng_interface/nng_interface.h>
+#include <rpc/server.h>
+#include <rpc/util.h>
+
+#include <univalue.h>
+
+namespace {
+
+static UniValue HistogramToJSON(
+    const std::array<uint64_t, NNG_RPC_HISTOGRAM_BUCKETS> &buckets) {
+    UniValue histogram(UniValue::VOBJ);
+    for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+        if (buckets[bucket] == 0) {
+            continue;
+        }
+        const std::string upper_bound =
+            bucket + 1 == buckets.size()
+                ? "inf"
+                : std::to_string(uint64_t(1) << bucket);
+        histogram.pushKV(upper_bound, buckets[bucket]);
+    }
+    return histogram;
+}
+
+static RPCHelpMan getnnginfo() {
+    return RPCHelpMan{
+        "getnnginfo",
+        "Returns metrics of the NNG RPC and PubSub interfaces.\n",
+        {},
+        RPCResult{
+            RPCResult::Type::OBJ,
+            "",
+            "",
+            {
+                {RPCResult::Type::OBJ,
+                 "rpc",
+                 /* optional */ true,
+                 "Only present if -nngrpc is set",
+                 {
+                     {RPCResult::Type::NUM, "workers",
+                      "Number of concurrent requests served"},
+                     {RPCResult::Type::OBJ_DYN,
+                      "methods",
+                      "Metrics per method, invalid requests are counted "
+                      "under \"Invalid\"",
+                      {
+                          {RPCResult::Type::OBJ,
+                           "method",
+                           "",
+                           {
+                               {RPCResult::Type::NUM, "calls",
+                                "Number of requests"},
+                               {RPCResult::Type::NUM, "errors",
+                                "Number of requests answered with an error"},
+                               {RPCResult::Type::NUM, "time_us",
+                                "Total time spent serving the requests, in "
+                                "microseconds"},
+                               {RPCResult::Type::NUM, "bytes",
+                                "Total size of the responses"},
+                               {RPCResult::Type::OBJ_DYN,
+                                "latency_us",
+                                "Histogram of the request latency. Keys are "
+                                "the exclusive upper bound of each bucket, "
+                                "which starts at half of it",
+                                {{RPCResult::Type::NUM, "bound",
+                                  "Number of requests in the bucket"}}},
+                               {RPCResult::Type::OBJ_DYN,
+                                "response_bytes",
+                                "Histogram of the response size, in the same "
+                                "format",
+                                {{RPCResult::Type::NUM, "bound",
+                                  "Number of requests in the bucket"}}},
+                           }},
+                      }},
+                 }},
+                {RPCResult::Type::OBJ,
+                 "pub",
+                 /* optional */ true,
+                 "Only present if -nngpub is set",
+                 {
+                     {RPCResult::Type::NUM, "queuedepth",
+                      "Number of messages waiting to be published"},
+                     {RPCResult::Type::NUM, "maxqueuedepth",
+                      "Highest number of messages that waited at once"},
+                     {RPCResult::Type::NUM, "published",
+                      "Number of messages published"},
+                     {RPCResult::Type::NUM, "dropped",
+                      "Number of messages dropped because the queue was "
+                      "full"},
+                 }},
+            }},
+        RPCExamples{HelpExampleCli("getnnginfo", "") +
+                    HelpExampleRpc("getnnginfo", "")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            UniValue result(UniValue::VOBJ);
+            NngRpcStats rpc_stats;
+            if (GetNngRpcStats(rpc_stats)) {
+                UniValue methods(UniValue::VOBJ);
+                for (const NngRpcMethodStats &method : rpc_stats.methods) {
+                    UniValue obj(UniValue::VOBJ);
+                    obj.pushKV("calls", method.num_calls);
+                    obj.pushKV("errors", method.num_errors);
+                    obj.pushKV("time_us", method.total_micros);
+                    obj.pushKV("bytes", method.total_bytes);
+                    obj.pushKV("latency_us",
+                               HistogramToJSON(method.latency_micros));
+                    obj.pushKV("response_bytes",
+                               HistogramToJSON(method.response_bytes));
+                    methods.pushKV(method.method, obj);
+                }
+                UniValue rpc(UniValue::VOBJ);
+                rpc.pushKV("workers", uint64_t(rpc_stats.num_workers));
+                rpc.pushKV("methods", methods);
+                result.pushKV("rpc", rpc);
+            }
+            NngPubStats pub_stats;
+            if (GetNngPubStats(pub_stats)) {
+                UniValue pub(UniValue::VOBJ);
+                pub.pushKV("queuedepth", uint64_t(pub_stats.queue_depth));
+                pub.pushKV("maxqueuedepth",
+                           uint64_t(pub_stats.max_queue_depth));
+                pub.pushKV("published", pub_stats.num_published);
+                pub.pushKV("dropped", pub_stats.num_dropped);
+                result.pushKV("pub", pub);
+            }
+            return result;
+        },
+    };
+}
+
+// clang-format off
+static const CRPCCommand commands[] = {
+    //  category           actor (function)
+    //  -----------------  -----------------------
+    { "nng",               getnnginfo,              },
+};
+// clang-format on
+
+} // anonymous namespace
+
+void RegisterNNGRPCCommands(CRPCTable &t) {
+    for (const auto &c : commands) {
+        t.appendCommand(c.name, &c);
+    }
+}
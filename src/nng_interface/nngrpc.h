@@ -0,0 +1,12 @@
+// Copyright (c) 2021 The Logos Foundation
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NNG_INTERFACE_NNGRPC_H
+#define BITCOIN_NNG_INTERFACE_NNGRPC_H
+
+class CRPCTable;
+
+void RegisterNNGRPCCommands(CRPCTable &t);
+
+#endif // BITCOIN_NNG_INTERFACE_NNGRPC_H
@@ -0,0 +1,198 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pow/noncescanner.h>
+
+#include <arith_uint256.h>
+#include <consensus/params.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <hash.h>
+#include <primitives/block.h>
+#include <uint256.h>
+#include <util/parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+namespace {
+/** Number of nonces hashed together, matching the widest SHA256 transform. */
+constexpr size_t NONCE_BATCH_SIZE = 8;
+constexpr size_t LAYER2_SIZE = 52;
+constexpr size_t LAYER1_SIZE = 64;
+/** Offset of nNonce in the layer2 preimage. */
+constexpr size_t NONCE_OFFSET = 12;
+
+std::atomic<uint64_t> g_scanned_hashes{0};
+std::atomic<uint64_t> g_scan_nanos{0};
+
+/** State shared by the threads scanning the same header. */
+struct ScanJob {
+    uint8_t layer2[LAYER2_SIZE];
+    uint8_t layer1[LAYER1_SIZE];
+    uint64_t first_nonce;
+    uint64_t count;
+    uint64_t chunk_size;
+    arith_uint256 target;
+    const std::function<bool()> *interrupt;
+
+    /** Lowest valid offset found so far, count if none. */
+    std::atomic<uint64_t> best;
+    std::atomic<bool> aborted{false};
+    std::atomic<uint64_t> hashes{0};
+};
+
+/**
+ * Scan [begin, end) in offsets relative to job.first_nonce and return the
+ * offset of the first valid nonce, or end if there is none.
+ */
+uint64_t ScanRange(ScanJob &job, uint64_t begin, uint64_t end) {
+    uint8_t layer2[NONCE_BATCH_SIZE * LAYER2_SIZE];
+    uint8_t layer1[NONCE_BATCH_SIZE * LAYER1_SIZE];
+    uint8_t digests[NONCE_BATCH_SIZE * CSHA256::OUTPUT_SIZE];
+    for (size_t i = 0; i < NONCE_BATCH_SIZE; ++i) {
+        memcpy(layer2 + i * LAYER2_SIZE, job.layer2, LAYER2_SIZE);
+        memcpy(layer1 + i * LAYER1_SIZE, job.layer1, LAYER1_SIZE);
+    }
+
+    uint64_t hashed = 0;
+    uint64_t found = end;
+    for (uint64_t offset = begin; offset < end && found == end;
+         offset += NONCE_BATCH_SIZE) {
+        const size_t lanes =
+            std::min<uint64_t>(NONCE_BATCH_SIZE, end - offset);
+        for (size_t i = 0; i < lanes; ++i) {
+            WriteLE64(layer2 + i * LAYER2_SIZE + NONCE_OFFSET,
+                      job.first_nonce + offset + i);
+        }
+        SHA256Multi(digests, layer2, LAYER2_SIZE, lanes);
+        for (size_t i = 0; i < lanes; ++i) {
+            memcpy(layer1 + i * LAYER1_SIZE + 32,
+                   digests + i * CSHA256::OUTPUT_SIZE, CSHA256::OUTPUT_SIZE);
+        }
+        SHA256Multi(digests, layer1, LAYER1_SIZE, lanes);
+        hashed += lanes;
+
+        for (size_t i = 0; i < lanes; ++i) {
+            uint256 hash;
+            memcpy(hash.begin(), digests + i * CSHA256::OUTPUT_SIZE,
+                   CSHA256::OUTPUT_SIZE);
+            if (UintToArith256(hash) <= job.target) {
+                found = offset + i;
+                break;
+            }
+        }
+    }
+
+    job.hashes += hashed;
+    return found;
+}
+
+/**
+ * Scan the given chunk unless a lower valid nonce is already known, and return
+ * whether the chunks after it still need to be scanned.
+ */
+bool ScanChunk(ScanJob &job, uint64_t chunk) {
+    const uint64_t begin = chunk * job.chunk_size;
+    if (begin >= job.best || job.aborted) {
+        return false;
+    }
+    if ((*job.interrupt)()) {
+        job.aborted = true;
+        return false;
+    }
+
+    const uint64_t end = begin + std::min(job.count - begin, job.chunk_size);
+    const uint64_t found = ScanRange(job, begin, end);
+    if (found < end) {
+        uint64_t best = job.best;
+        while (found < best && !job.best.compare_exchange_weak(best, found)) {
+        }
+        // The chunks after this one only hold higher nonces.
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+NonceScanner::NonceScanner(int num_threads, uint64_t chunk_size)
+    : m_num_threads(std::max(num_threads, 1)),
+      m_chunk_size(std::max<uint64_t>(chunk_size, 1)) {}
+
+bool NonceScanner::Scan(CBlockHeader &header, const Consensus::Params &params,
+                        uint64_t &max_tries,
+                        const std::function<bool()> &interrupt) const {
+    const uint64_t count = std::min(
+        max_tries, std::numeric_limits<uint64_t>::max() - header.nNonce);
+
+    bool fNegative;
+    bool fOverflow;
+    arith_uint256 target;
+    target.SetCompact(header.nBits, &fNegative, &fOverflow);
+    if (fNegative || target == 0 || fOverflow ||
+        target > UintToArith256(params.powLimit)) {
+        // No nonce can satisfy CheckProofOfWork.
+        header.nNonce += count;
+        max_tries -= count;
+        return false;
+    }
+
+    ScanJob job;
+    job.first_nonce = header.nNonce;
+    job.count = count;
+    job.chunk_size = m_chunk_size;
+    job.target = target;
+    job.interrupt = &interrupt;
+    job.best = count;
+
+    // The layer3 hash and everything but the nonce stay fixed for the whole
+    // scan; these templates match the serialization done in GetHash().
+    CHashWriter layer3_writer(SER_GETHASH, 0);
+    layer3_writer << header.nHeaderVersion;
+    layer3_writer << header.vSize;
+    layer3_writer << header.nHeight;
+    layer3_writer << header.hashEpochBlock;
+    layer3_writer << header.hashMerkleRoot;
+    layer3_writer << header.hashExtendedMetadata;
+    const uint256 layer3 = layer3_writer.GetSHA256();
+    WriteLE32(job.layer2, header.nBits);
+    memcpy(job.layer2 + 4, header.vTime.data(), header.vTime.size());
+    WriteLE16(job.layer2 + 10, header.nReserved);
+    memcpy(job.layer2 + 20, layer3.begin(), 32);
+    memcpy(job.layer1, header.hashPrevBlock.begin(), 32);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Chunks are handed out in increasing order, so that a scan can stop as
+    // soon as a valid nonce is found.
+    const uint64_t num_chunks = (count + m_chunk_size - 1) / m_chunk_size;
+    ParallelForWhile(num_chunks, m_num_threads, 1, [&](size_t chunk) {
+        return ScanChunk(job, chunk);
+    });
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    g_scanned_hashes += job.hashes;
+    g_scan_nanos += elapsed.count();
+
+    if (job.aborted) {
+        return false;
+    }
+
+    const uint64_t best = job.best;
+    header.nNonce += best;
+    max_tries -= best;
+    return best < count;
+}
+
+double GetNonceScannerHashRate() {
+    const uint64_t nanos = g_scan_nanos;
+    if (nanos == 0) {
+        return 0;
+    }
+    return g_scanned_hashes * 1e9 / nanos;
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POW_NONCESCANNER_H
+#define BITCOIN_POW_NONCESCANNER_H
+
+#include <cstdint>
+#include <functional>
+
+class CBlockHeader;
+
+namespace Consensus {
+struct Params;
+}
+
+/** Default for -generatethreads, 0 meaning one thread per core */
+static constexpr int DEFAULT_GENERATE_THREADS = 1;
+/** Default for -generatenoncechunk */
+static constexpr uint64_t DEFAULT_GENERATE_NONCE_CHUNK = 4096;
+
+/**
+ * CPU nonce grinder used by the generate RPCs.
+ *
+ * Only the layer2 and layer1 hashes of a Lotus header depend on nNonce, so the
+ * layer3 hash and the serialized fixed fields are computed once per header.
+ * Candidate nonces are then hashed several at a time with the multi-lane
+ * SHA256 transforms. The nonce range is cut into chunks which are handed out
+ * in increasing order to the scanning threads, see ParallelForWhile.
+ */
+class NonceScanner {
+private:
+    int m_num_threads;
+    uint64_t m_chunk_size;
+
+public:
+    NonceScanner(int num_threads, uint64_t chunk_size);
+
+    /**
+     * Look for the lowest nonce in [header.nNonce, header.nNonce + max_tries)
+     * satisfying the proof-of-work requirement of the header. Nonce
+     * 0xffffffffffffffff is never tried.
+     *
+     * On success header.nNonce is set to the nonce found and true is
+     * returned. Otherwise header.nNonce is left past the scanned range.
+     * In both cases max_tries is decreased by the number of nonces rejected.
+     * The scan is abandoned when interrupt() returns true.
+     */
+    bool Scan(CBlockHeader &header, const Consensus::Params &params,
+              uint64_t &max_tries,
+              const std::function<bool()> &interrupt) const;
+
+    int GetNumThreads() const { return m_num_threads; }
+};
+
+/**
+ * Average hashes per second achieved by all the nonce scans run by this
+ * process, or 0 if none ran yet.
+ */
+double GetNonceScannerHashRate();
+
+#endif // BITCOIN_POW_NONCESCANNER_H
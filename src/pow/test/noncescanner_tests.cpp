@@ -0,0 +1,104 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pow/noncescanner.h>
+
+#include <chainparams.h>
+#include <pow/pow.h>
+#include <primitives/block.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <functional>
+#include <limits>
+
+BOOST_FIXTURE_TEST_SUITE(noncescanner_tests, RegTestingSetup)
+
+static CBlockHeader RandomHeader() {
+    CBlockHeader header;
+    header.hashPrevBlock = BlockHash(InsecureRand256());
+    header.nBits = 0x207fffff;
+    header.SetBlockTime(InsecureRandBits(32));
+    header.nReserved = InsecureRandBits(16);
+    header.nNonce = InsecureRandBits(32);
+    header.nHeaderVersion = 1;
+    header.SetSize(InsecureRandBits(20));
+    header.nHeight = InsecureRandBits(20);
+    header.hashEpochBlock = BlockHash(InsecureRand256());
+    header.hashMerkleRoot = InsecureRand256();
+    header.hashExtendedMetadata = InsecureRand256();
+    return header;
+}
+
+static const std::function<bool()> never_interrupt = [] { return false; };
+
+BOOST_AUTO_TEST_CASE(matches_sequential_scan) {
+    const Consensus::Params &params = Params().GetConsensus();
+    for (int threads : {1, 3}) {
+        for (uint64_t chunk : {1, 5, 64}) {
+            for (int i = 0; i < 8; ++i) {
+                CBlockHeader header = RandomHeader();
+                // A target allowing roughly one header in 64.
+                header.nBits = 0x2003ffff;
+
+                CBlockHeader expected = header;
+                uint64_t expected_tries = 1000;
+                while (expected_tries > 0 &&
+                       !CheckProofOfWork(expected.GetHash(), expected.nBits,
+                                         params)) {
+                    ++expected.nNonce;
+                    --expected_tries;
+                }
+
+                uint64_t tries = 1000;
+                const bool found = NonceScanner(threads, chunk).Scan(
+                    header, params, tries, never_interrupt);
+                BOOST_CHECK_EQUAL(found, expected_tries > 0);
+                BOOST_CHECK_EQUAL(header.nNonce, expected.nNonce);
+                BOOST_CHECK_EQUAL(tries, expected_tries);
+                BOOST_CHECK_EQUAL(header.GetHash(), expected.GetHash());
+            }
+        }
+    }
+    BOOST_CHECK_GT(GetNonceScannerHashRate(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(exhausted_range) {
+    const Consensus::Params &params = Params().GetConsensus();
+    CBlockHeader header = RandomHeader();
+    // The lowest target allowed by regtest, which no header reaches.
+    header.nBits = 0x03000001;
+    const uint64_t start = header.nNonce;
+
+    uint64_t tries = 100;
+    BOOST_CHECK(!NonceScanner(2, 16).Scan(header, params, tries,
+                                           never_interrupt));
+    BOOST_CHECK_EQUAL(tries, 0U);
+    BOOST_CHECK_EQUAL(header.nNonce, start + 100);
+
+    // The scan stops short of the last nonce.
+    header.nNonce = std::numeric_limits<uint64_t>::max() - 10;
+    tries = 100;
+    BOOST_CHECK(!NonceScanner(1, 4).Scan(header, params, tries,
+                                          never_interrupt));
+    BOOST_CHECK_EQUAL(tries, 90U);
+    BOOST_CHECK_EQUAL(header.nNonce, std::numeric_limits<uint64_t>::max());
+}
+
+BOOST_AUTO_TEST_CASE(interrupted_scan) {
+    const Consensus::Params &params = Params().GetConsensus();
+    CBlockHeader header = RandomHeader();
+    header.nBits = 0x03000001;
+    const uint64_t start = header.nNonce;
+
+    uint64_t tries = 1000000;
+    BOOST_CHECK(!NonceScanner(2, 8).Scan(header, params, tries,
+                                          [] { return true; }));
+    BOOST_CHECK_EQUAL(tries, 1000000U);
+    BOOST_CHECK_EQUAL(header.nNonce, start);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,9 +5,23 @@
 
 #include <primitives/block.h>
 
+#include <crypto/common.h>
+#include <crypto/sha256.h>
 #include <hash.h>
 #include <tinyformat.h>
 
+#include <algorithm>
+#include <cstring>
+
+namespace {
+/** Serialized size of the preimage of each hash layer. */
+constexpr size_t LAYER3_SIZE = 108;
+constexpr size_t LAYER2_SIZE = 52;
+constexpr size_t LAYER1_SIZE = 64;
+/** Number of headers hashed together by GetBlockHeaderHashes. */
+constexpr size_t HEADER_BATCH_SIZE = 8;
+} // namespace
+
 BlockHash CBlockHeader::GetHash() const {
     CHashWriter layer3(SER_GETHASH, 0);
     layer3 << nHeaderVersion;
@@ -28,6 +42,58 @@ BlockHash CBlockHeader::GetHash() const {
     return BlockHash(layer1.GetSHA256());
 }
 
+std::vector<BlockHash> GetBlockHeaderHashes(Span<const CBlockHeader> headers) {
+    std::vector<BlockHash> hashes(headers.size());
+    uint8_t layer3[HEADER_BATCH_SIZE * LAYER3_SIZE];
+    uint8_t layer2[HEADER_BATCH_SIZE * LAYER2_SIZE];
+    uint8_t layer1[HEADER_BATCH_SIZE * LAYER1_SIZE];
+    uint8_t digests[HEADER_BATCH_SIZE * CSHA256::OUTPUT_SIZE];
+
+    for (size_t begin = 0; begin < headers.size();
+         begin += HEADER_BATCH_SIZE) {
+        const size_t count =
+            std::min(HEADER_BATCH_SIZE, headers.size() - begin);
+
+        // These preimages match the serialization done in GetHash().
+        for (size_t i = 0; i < count; ++i) {
+            const CBlockHeader &header = headers[begin + i];
+            uint8_t *ptr = layer3 + i * LAYER3_SIZE;
+            ptr[0] = header.nHeaderVersion;
+            memcpy(ptr + 1, header.vSize.data(), header.vSize.size());
+            WriteLE32(ptr + 8, header.nHeight);
+            memcpy(ptr + 12, header.hashEpochBlock.begin(), 32);
+            memcpy(ptr + 44, header.hashMerkleRoot.begin(), 32);
+            memcpy(ptr + 76, header.hashExtendedMetadata.begin(), 32);
+        }
+        SHA256Multi(digests, layer3, LAYER3_SIZE, count);
+
+        for (size_t i = 0; i < count; ++i) {
+            const CBlockHeader &header = headers[begin + i];
+            uint8_t *ptr = layer2 + i * LAYER2_SIZE;
+            WriteLE32(ptr, header.nBits);
+            memcpy(ptr + 4, header.vTime.data(), header.vTime.size());
+            WriteLE16(ptr + 10, header.nReserved);
+            WriteLE64(ptr + 12, header.nNonce);
+            memcpy(ptr + 20, digests + i * CSHA256::OUTPUT_SIZE, 32);
+        }
+        SHA256Multi(digests, layer2, LAYER2_SIZE, count);
+
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t *ptr = layer1 + i * LAYER1_SIZE;
+            memcpy(ptr, headers[begin + i].hashPrevBlock.begin(), 32);
+            memcpy(ptr + 32, digests + i * CSHA256::OUTPUT_SIZE, 32);
+        }
+        SHA256Multi(digests, layer1, LAYER1_SIZE, count);
+
+        for (size_t i = 0; i < count; ++i) {
+            memcpy(hashes[begin + i].begin(),
+                   digests + i * CSHA256::OUTPUT_SIZE, 32);
+        }
+    }
+
+    return hashes;
+}
+
 std::string CBlock::ToString() const {
     std::stringstream s;
     s << strprintf(
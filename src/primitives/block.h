@@ -10,8 +10,11 @@
 #include <primitives/blockhash.h>
 #include <primitives/transaction.h>
 #include <serialize.h>
+#include <span.h>
 #include <uint256.h>
 
+#include <vector>
+
 typedef std::array<uint8_t, 6> block_time_t;
 typedef std::array<uint8_t, 7> block_size_t;
 
@@ -196,6 +199,13 @@ public:
     std::string ToString() const;
 };
 
+/**
+ * Compute the hashes of a batch of block headers. The result is identical to
+ * calling GetHash() on each header, but the three hash layers are computed for
+ * several headers at once using the multi-lane SHA256 transforms.
+ */
+std::vector<BlockHash> GetBlockHeaderHashes(Span<const CBlockHeader> headers);
+
 /**
  * Describes a place in the block chain to another node such that if the other
  * node doesn't have the same branch, it can find a recent common trunk.  The
@@ -13,6 +13,10 @@
 #include <script/script.h>
 #include <serialize.h>
 
+#include <array>
+#include <memory>
+#include <mutex>
+
 static const int SERIALIZE_TRANSACTION = 0x00;
 
 /**
@@ -347,6 +351,19 @@ struct PrecomputedTransactionData {
     Amount m_amount_inputs_sum;
     /** Sum of the amounts in all the outputs */
     Amount m_amount_outputs_sum;
+    /**
+     * The trailing SIGHASH_LOTUS preimage fields which are the same for every
+     * input, for each combination of base sighash type and ANYONECANPAY. Each
+     * is serialized by the first signature hash needing it. For
+     * SIGHASH_SINGLE, the hash of the input's output goes in before the last
+     * 4 bytes (nLockTime).
+     */
+    struct LotusSighashSuffixes {
+        std::array<std::once_flag, 6> once;
+        std::array<std::vector<uint8_t>, 6> bytes;
+    };
+    /** Shared with the copies, which describe the same transaction */
+    std::shared_ptr<LotusSighashSuffixes> m_lotus_sighash_suffixes;
 
     PrecomputedTransactionData() = default;
 
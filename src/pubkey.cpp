@@ -5,13 +5,23 @@
 
 #include <pubkey.h>
 
+#include <crypto/hmac_sha512.h>
+
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
 #include <secp256k1_schnorr.h>
 
+#include <algorithm>
+
 namespace {
 /* Global secp256k1_context object used for verification. */
 secp256k1_context *secp256k1_context_verify = nullptr;
+
+/**
+ * Scratch space for the multi-scalar multiplication of batch verification,
+ * enough for the Pippenger algorithm on a few hundred signatures.
+ */
+constexpr size_t SCHNORR_BATCH_SCRATCH_SIZE = 1 << 20;
 } // namespace
 
 /**
@@ -170,8 +180,53 @@ static int ecdsa_signature_parse_der_lax(const secp256k1_context *ctx,
     return 1;
 }
 
+PreparsedPubKeys::PreparsedPubKeys(std::vector<CPubKey> keys) {
+    assert(secp256k1_context_verify &&
+           "secp256k1_context_verify must be initialized to use CPubKey.");
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    m_keys.reserve(keys.size());
+    m_parsed.reserve(keys.size());
+    for (const CPubKey &key : keys) {
+        secp256k1_pubkey pubkey;
+        if (!key.IsValid() ||
+            !secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey,
+                                       key.data(), key.size())) {
+            continue;
+        }
+        static_assert(sizeof(pubkey.data) == 64);
+        m_keys.push_back(key);
+        m_parsed.emplace_back();
+        std::copy(std::begin(pubkey.data), std::end(pubkey.data),
+                  m_parsed.back().begin());
+    }
+}
+
+const std::array<uint8_t, 64> *
+PreparsedPubKeys::Find(const CPubKey &key) const {
+    auto it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+    if (it == m_keys.end() || *it != key) {
+        return nullptr;
+    }
+    return &m_parsed[it - m_keys.begin()];
+}
+
+/** Parse key, unless it can be found in preparsed. */
+static bool ParsePubKey(secp256k1_pubkey &pubkey, const CPubKey &key,
+                        const PreparsedPubKeys *preparsed) {
+    if (preparsed) {
+        if (const std::array<uint8_t, 64> *parsed = preparsed->Find(key)) {
+            std::copy(parsed->begin(), parsed->end(), pubkey.data);
+            return true;
+        }
+    }
+    return secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey,
+                                     key.data(), key.size());
+}
+
 bool CPubKey::VerifyECDSA(const uint256 &hash,
-                          const std::vector<uint8_t> &vchSig) const {
+                          const std::vector<uint8_t> &vchSig,
+                          const PreparsedPubKeys *preparsed) const {
     if (!IsValid()) {
         return false;
     }
@@ -180,8 +235,7 @@ bool CPubKey::VerifyECDSA(const uint256 &hash,
     secp256k1_ecdsa_signature sig;
     assert(secp256k1_context_verify &&
            "secp256k1_context_verify must be initialized to use CPubKey.");
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, vch,
-                                   size())) {
+    if (!ParsePubKey(pubkey, *this, preparsed)) {
         return false;
     }
     if (!ecdsa_signature_parse_der_lax(secp256k1_context_verify, &sig,
@@ -197,15 +251,15 @@ bool CPubKey::VerifyECDSA(const uint256 &hash,
                                   &pubkey);
 }
 
-bool CPubKey::VerifySchnorr(
-    const uint256 &hash, const std::array<uint8_t, SCHNORR_SIZE> &sig) const {
+bool CPubKey::VerifySchnorr(const uint256 &hash,
+                            const std::array<uint8_t, SCHNORR_SIZE> &sig,
+                            const PreparsedPubKeys *preparsed) const {
     if (!IsValid()) {
         return false;
     }
 
     secp256k1_pubkey pubkey;
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey,
-                                   &(*this)[0], size())) {
+    if (!ParsePubKey(pubkey, *this, preparsed)) {
         return false;
     }
 
@@ -214,7 +268,8 @@ bool CPubKey::VerifySchnorr(
 }
 
 bool CPubKey::VerifySchnorr(const uint256 &hash,
-                            const std::vector<uint8_t> &vchSig) const {
+                            const std::vector<uint8_t> &vchSig,
+                            const PreparsedPubKeys *preparsed) const {
     if (vchSig.size() != SCHNORR_SIZE) {
         return false;
     }
@@ -222,7 +277,34 @@ bool CPubKey::VerifySchnorr(const uint256 &hash,
     std::array<uint8_t, SCHNORR_SIZE> sig;
     std::copy(vchSig.begin(), vchSig.end(), sig.begin());
 
-    return VerifySchnorr(hash, sig);
+    return VerifySchnorr(hash, sig, preparsed);
+}
+
+bool VerifySchnorrBatch(const std::vector<SchnorrSignatureCheck> &checks) {
+    assert(secp256k1_context_verify &&
+           "secp256k1_context_verify must be initialized to use CPubKey.");
+    std::vector<secp256k1_pubkey> pubkeys(checks.size());
+    std::vector<const secp256k1_pubkey *> pubkey_ptrs(checks.size());
+    std::vector<const uint8_t *> sig_ptrs(checks.size());
+    std::vector<const uint8_t *> hash_ptrs(checks.size());
+    for (size_t i = 0; i < checks.size(); i++) {
+        const CPubKey &pubkey = checks[i].pubkey;
+        if (!pubkey.IsValid() ||
+            !ParsePubKey(pubkeys[i], pubkey, checks[i].preparsed)) {
+            return false;
+        }
+        pubkey_ptrs[i] = &pubkeys[i];
+        sig_ptrs[i] = checks[i].sig.data();
+        hash_ptrs[i] = checks[i].hash.begin();
+    }
+
+    secp256k1_scratch_space *scratch = secp256k1_scratch_space_create(
+        secp256k1_context_verify, SCHNORR_BATCH_SCRATCH_SIZE);
+    const int ret = secp256k1_schnorr_verify_batch(
+        secp256k1_context_verify, scratch, sig_ptrs.data(), hash_ptrs.data(),
+        pubkey_ptrs.data(), checks.size());
+    secp256k1_scratch_space_destroy(secp256k1_context_verify, scratch);
+    return ret;
 }
 
 bool CPubKey::AddScalar(CPubKey &result, const uint256 &scalar) const {
@@ -362,6 +444,47 @@ bool CExtPubKey::Derive(CExtPubKey &out, unsigned int _nChild) const {
     return pubkey.Derive(out.pubkey, out.chaincode, _nChild, chaincode);
 }
 
+bool CExtPubKey::DeriveRange(std::vector<CExtPubKey> &out,
+                             unsigned int _nChild, size_t count) const {
+    assert(pubkey.IsValid());
+    assert(pubkey.size() == CPubKey::COMPRESSED_SIZE);
+    assert(count == 0 || (uint64_t(_nChild) + count - 1) >> 31 == 0);
+    out.resize(count);
+    const CKeyID id = pubkey.GetID();
+    const CHMAC_SHA512 keyed(chaincode.begin(), chaincode.size());
+    secp256k1_pubkey parent;
+    assert(secp256k1_context_verify &&
+           "secp256k1_context_verify must be initialized to use CPubKey.");
+    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &parent,
+                                   pubkey.data(), pubkey.size())) {
+        return false;
+    }
+    bool ret = true;
+    for (size_t i = 0; i < count; ++i) {
+        CExtPubKey &child = out[i];
+        child.nDepth = nDepth + 1;
+        memcpy(&child.vchFingerprint[0], &id, 4);
+        child.nChild = _nChild + i;
+        uint8_t tweak[64];
+        BIP32Hash(keyed, child.nChild, *pubkey.begin(), pubkey.begin() + 1,
+                  tweak);
+        memcpy(child.chaincode.begin(), tweak + 32, 32);
+        secp256k1_pubkey derived = parent;
+        if (!secp256k1_ec_pubkey_tweak_add(secp256k1_context_verify, &derived,
+                                           tweak)) {
+            child.pubkey = CPubKey();
+            ret = false;
+            continue;
+        }
+        uint8_t pub[CPubKey::COMPRESSED_SIZE];
+        size_t publen = CPubKey::COMPRESSED_SIZE;
+        secp256k1_ec_pubkey_serialize(secp256k1_context_verify, pub, &publen,
+                                      &derived, SECP256K1_EC_COMPRESSED);
+        child.pubkey.Set(pub, pub + publen);
+    }
+    return ret;
+}
+
 bool CPubKey::CheckLowS(
     const boost::sliced_range<const std::vector<uint8_t>> &vchSig) {
     secp256k1_ecdsa_signature sig;
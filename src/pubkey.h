@@ -28,6 +28,8 @@ public:
 using ChainCode = uint256;
 
 /** An encapsulated public key. */
+class PreparsedPubKeys;
+
 class CPubKey {
 public:
     /**
@@ -161,18 +163,21 @@ public:
     /**
      * Verify a DER-serialized ECDSA signature (~72 bytes).
      * If this public key is not fully valid, the return value will be false.
+     * If this key is in preparsed, it isn't parsed again.
      */
-    bool VerifyECDSA(const uint256 &hash,
-                     const std::vector<uint8_t> &vchSig) const;
+    bool VerifyECDSA(const uint256 &hash, const std::vector<uint8_t> &vchSig,
+                     const PreparsedPubKeys *preparsed = nullptr) const;
 
     /**
      * Verify a Schnorr signature (=64 bytes).
      * If this public key is not fully valid, the return value will be false.
+     * If this key is in preparsed, it isn't parsed again.
      */
     bool VerifySchnorr(const uint256 &hash,
-                       const std::array<uint8_t, SCHNORR_SIZE> &sig) const;
-    bool VerifySchnorr(const uint256 &hash,
-                       const std::vector<uint8_t> &vchSig) const;
+                       const std::array<uint8_t, SCHNORR_SIZE> &sig,
+                       const PreparsedPubKeys *preparsed = nullptr) const;
+    bool VerifySchnorr(const uint256 &hash, const std::vector<uint8_t> &vchSig,
+                       const PreparsedPubKeys *preparsed = nullptr) const;
 
     /**
      * Verify that this pubkey is the base point tweaked by tweak.
@@ -223,10 +228,55 @@ struct CExtPubKey {
     void Encode(uint8_t code[BIP32_EXTKEY_SIZE]) const;
     void Decode(const uint8_t code[BIP32_EXTKEY_SIZE]);
     bool Derive(CExtPubKey &out, unsigned int nChild) const;
+    /**
+     * Derive the count consecutive non-hardened children starting at nChild.
+     * The parent public key is parsed, and the HMAC keyed, once for all of
+     * them. Returns false if any child is invalid.
+     */
+    bool DeriveRange(std::vector<CExtPubKey> &out, unsigned int nChild,
+                     size_t count) const;
 
     CExtPubKey() = default;
 };
 
+/**
+ * Public keys parsed ahead of signature verification. Parsing a compressed key
+ * takes a square root, so keys used by many signatures are worth parsing only
+ * once. Immutable once built, so it can be shared between threads.
+ */
+class PreparsedPubKeys {
+private:
+    //! Sorted keys and their parsed (secp256k1_pubkey) form
+    std::vector<CPubKey> m_keys;
+    std::vector<std::array<uint8_t, 64>> m_parsed;
+
+public:
+    PreparsedPubKeys() = default;
+    /** Parse the given keys. Duplicates and invalid keys are skipped. */
+    explicit PreparsedPubKeys(std::vector<CPubKey> keys);
+
+    /** Get the parsed form of key, or nullptr if it wasn't preparsed. */
+    const std::array<uint8_t, 64> *Find(const CPubKey &key) const;
+
+    size_t size() const { return m_keys.size(); }
+};
+
+/** A Schnorr signature to verify together with others */
+struct SchnorrSignatureCheck {
+    CPubKey pubkey;
+    uint256 hash;
+    std::array<uint8_t, CPubKey::SCHNORR_SIZE> sig;
+    //! Where to look for the parsed pubkey, if anywhere
+    const PreparsedPubKeys *preparsed = nullptr;
+};
+
+/**
+ * Verify many Schnorr signatures at once, which is faster than verifying them
+ * one by one for large enough batches. Returns false if any of them is invalid,
+ * without telling which one.
+ */
+bool VerifySchnorrBatch(const std::vector<SchnorrSignatureCheck> &checks);
+
 /**
  * Users of this module must hold an ECCVerifyHandle. The constructor and
  * destructor of these are not allowed to run in parallel, though.
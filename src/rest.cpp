@@ -262,6 +262,9 @@ static bool rest_block(const Config &config, HTTPRequest *req,
     const BlockHash hash(rawHash);
 
     CBlock block;
+    // The binary and hex formats are served from the bytes stored on disk
+    FlatFileData raw_block;
+    const bool raw = rf == RetFormat::BINARY || rf == RetFormat::HEX;
     CBlockIndex *pblockindex = nullptr;
     CBlockIndex *tip = nullptr;
     {
@@ -277,28 +280,25 @@ static bool rest_block(const Config &config, HTTPRequest *req,
                            hashStr + " not available (pruned data)");
         }
 
-        if (!ReadBlockFromDisk(block, pblockindex,
-                               config.GetChainParams().GetConsensus())) {
+        const Consensus::Params &params =
+            config.GetChainParams().GetConsensus();
+        if (raw ? !ReadRawBlockFromDisk(raw_block, pblockindex, params)
+                : !ReadBlockFromDisk(block, pblockindex, params)) {
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
         }
     }
 
     switch (rf) {
         case RetFormat::BINARY: {
-            CDataStream ssBlock(SER_NETWORK,
-                                PROTOCOL_VERSION | RPCSerializationFlags());
-            ssBlock << block;
-            std::string binaryBlock = ssBlock.str();
+            const Span<const uint8_t> bytes = raw_block.bytes();
+            std::string binaryBlock(bytes.begin(), bytes.end());
             req->WriteHeader("Content-Type", "application/octet-stream");
             req->WriteReply(HTTP_OK, binaryBlock);
             return true;
         }
 
         case RetFormat::HEX: {
-            CDataStream ssBlock(SER_NETWORK,
-                                PROTOCOL_VERSION | RPCSerializationFlags());
-            ssBlock << block;
-            std::string strHex = HexStr(ssBlock) + "\n";
+            std::string strHex = HexStr(raw_block.bytes()) + "\n";
             req->WriteHeader("Content-Type", "text/plain");
             req->WriteReply(HTTP_OK, strHex);
             return true;
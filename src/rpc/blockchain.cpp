@@ -18,6 +18,7 @@
 #include <hash.h>
 #include <index/blockfilterindex.h>
 #include <network.h>
+#include <node/coin.h>
 #include <node/coinstats.h>
 #include <node/context.h>
 #include <node/utxo_snapshot.h>
@@ -26,6 +27,9 @@
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
+#include <script/interpreter.h>
+#include <script/scriptcache.h>
+#include <script/sigcache.h>
 #include <streams.h>
 #include <txdb.h>
 #include <txmempool.h>
@@ -1021,6 +1025,21 @@ static CBlock GetBlockChecked(const Config &config,
     return block;
 }
 
+static FlatFileData GetRawBlockChecked(const Config &config,
+                                       const CBlockIndex *pblockindex) {
+    FlatFileData raw_block;
+    if (IsBlockPruned(pblockindex)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+    }
+
+    if (!ReadRawBlockFromDisk(raw_block, pblockindex,
+                              config.GetChainParams().GetConsensus())) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+    }
+
+    return raw_block;
+}
+
 static CBlockUndo GetUndoChecked(const CBlockIndex *pblockindex) {
     CBlockUndo blockUndo;
     if (IsBlockPruned(pblockindex)) {
@@ -1148,17 +1167,14 @@ static RPCHelpMan getblock() {
                                        "Block not found");
                 }
 
+                if (verbosity <= 0) {
+                    // Serve the bytes stored on disk, no need to decode them
+                    return HexStr(
+                        GetRawBlockChecked(config, pblockindex).bytes());
+                }
                 block = GetBlockChecked(config, pblockindex);
             }
 
-            if (verbosity <= 0) {
-                CDataStream ssBlock(SER_NETWORK,
-                                    PROTOCOL_VERSION | RPCSerializationFlags());
-                ssBlock << block;
-                std::string strHex = HexStr(ssBlock);
-                return strHex;
-            }
-
             return blockToJSON(block, tip, pblockindex, verbosity >= 2);
         },
     };
@@ -1790,6 +1806,52 @@ static RPCHelpMan getmempoolinfo() {
     };
 }
 
+static UniValue ScriptCacheStatsToJSON(const ScriptCacheStats &stats) {
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("capacity", uint64_t(stats.capacity));
+    ret.pushKV("hits", stats.hits);
+    ret.pushKV("misses", stats.misses);
+    ret.pushKV("inserts", stats.inserts);
+    ret.pushKV("evictions", stats.evictions);
+    return ret;
+}
+
+static RPCHelpMan getscriptcacheinfo() {
+    const std::vector<RPCResult> stats_fields{
+        {RPCResult::Type::NUM, "capacity",
+         "Number of entries the cache can hold"},
+        {RPCResult::Type::NUM, "hits", "Number of lookups that found an entry"},
+        {RPCResult::Type::NUM, "misses",
+         "Number of lookups that didn't find an entry"},
+        {RPCResult::Type::NUM, "inserts", "Number of entries added"},
+        {RPCResult::Type::NUM, "evictions",
+         "Number of entries dropped to make room for new ones"},
+    };
+    std::vector<RPCResult> result_fields = stats_fields;
+    result_fields.push_back(
+        {RPCResult::Type::OBJ, "taprootcommitments",
+         "The same statistics for the cache of verified Taproot script path "
+         "commitments",
+         stats_fields});
+    return RPCHelpMan{
+        "getscriptcacheinfo",
+        "Returns usage statistics of the script execution cache, which "
+        "remembers the transactions whose scripts were already verified.\n",
+        {},
+        RPCResult{RPCResult::Type::OBJ, "", "", result_fields},
+        RPCExamples{HelpExampleCli("getscriptcacheinfo", "") +
+                    HelpExampleRpc("getscriptcacheinfo", "")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            UniValue ret = ScriptCacheStatsToJSON(GetScriptCacheStats());
+            ret.pushKV(
+                "taprootcommitments",
+                ScriptCacheStatsToJSON(GetTaprootCommitmentCacheStats()));
+            return ret;
+        },
+    };
+}
+
 static RPCHelpMan preciousblock() {
     return RPCHelpMan{
         "preciousblock",
@@ -2178,6 +2240,40 @@ static inline bool SetHasKeys(const std::set<T> &set, const Tk &key,
 static constexpr size_t PER_UTXO_OVERHEAD =
     sizeof(COutPoint) + sizeof(uint32_t) + sizeof(bool);
 
+static const CBlockIndex *ParseHashOrHeight(const UniValue &param)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    const CBlockIndex *pindex;
+    if (param.isNum()) {
+        const int height = param.get_int();
+        const int current_tip = ::ChainActive().Height();
+        if (height < 0) {
+            throw JSONRPCError(
+                RPC_INVALID_PARAMETER,
+                strprintf("Target block height %d is negative", height));
+        }
+        if (height > current_tip) {
+            throw JSONRPCError(
+                RPC_INVALID_PARAMETER,
+                strprintf("Target block height %d after current tip %d",
+                          height, current_tip));
+        }
+
+        pindex = ::ChainActive()[height];
+    } else {
+        const BlockHash hash(ParseHashV(param, "hash_or_height"));
+        pindex = LookupBlockIndex(hash);
+        if (!pindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        if (!::ChainActive().Contains(pindex)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER,
+                               strprintf("Block is not in chain %s",
+                                         Params().NetworkIDString()));
+        }
+    }
+    return pindex;
+}
+
 static RPCHelpMan getblockstats() {
     const auto &ticker = Currency::get().ticker;
     return RPCHelpMan{
@@ -2268,39 +2364,7 @@ static RPCHelpMan getblockstats() {
             const JSONRPCRequest &request) -> UniValue {
             LOCK(cs_main);
 
-            CBlockIndex *pindex;
-            if (request.params[0].isNum()) {
-                const int height = request.params[0].get_int();
-                const int current_tip = ::ChainActive().Height();
-                if (height < 0) {
-                    throw JSONRPCError(
-                        RPC_INVALID_PARAMETER,
-                        strprintf("Target block height %d is negative",
-                                  height));
-                }
-                if (height > current_tip) {
-                    throw JSONRPCError(
-                        RPC_INVALID_PARAMETER,
-                        strprintf("Target block height %d after current tip %d",
-                                  height, current_tip));
-                }
-
-                pindex = ::ChainActive()[height];
-            } else {
-                const BlockHash hash(
-                    ParseHashV(request.params[0], "hash_or_height"));
-                pindex = LookupBlockIndex(hash);
-                if (!pindex) {
-                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
-                                       "Block not found");
-                }
-                if (!::ChainActive().Contains(pindex)) {
-                    throw JSONRPCError(RPC_INVALID_PARAMETER,
-                                       strprintf("Block is not in chain %s",
-                                                 Params().NetworkIDString()));
-                }
-            }
-
+            const CBlockIndex *pindex = ParseHashOrHeight(request.params[0]);
             CHECK_NONFATAL(pindex != nullptr);
 
             std::set<std::string> stats;
@@ -2475,6 +2539,220 @@ static RPCHelpMan getblockstats() {
     };
 }
 
+namespace {
+struct InputScriptProfile {
+    TxId txid;
+    uint32_t vin;
+    bool valid;
+    ScriptError error;
+    ScriptExecutionMetrics metrics;
+};
+} // namespace
+
+/** Verify the scripts of all the inputs of tx with profiling enabled. */
+static void ProfileInputScripts(const CTransaction &tx,
+                                std::vector<CTxOut> spent_outputs,
+                                uint32_t flags,
+                                std::vector<InputScriptProfile> &profiles) {
+    const PrecomputedTransactionData txdata(tx, std::move(spent_outputs));
+    for (uint32_t i = 0; i < tx.vin.size(); i++) {
+        const CTxOut &prevout = txdata.m_spent_outputs[i];
+        InputScriptProfile profile{tx.GetId(), i, false, ScriptError::UNKNOWN,
+                                   {}};
+        profile.metrics.fProfile = true;
+        profile.valid = VerifyScript(
+            tx.vin[i].scriptSig, prevout.scriptPubKey, flags,
+            TransactionSignatureChecker(&tx, i, prevout.nValue, txdata),
+            profile.metrics, &profile.error);
+        profiles.push_back(std::move(profile));
+    }
+}
+
+static UniValue InputScriptProfilesToJSON(
+    std::vector<InputScriptProfile> &profiles, size_t count) {
+    int64_t total_time = 0;
+    for (const InputScriptProfile &profile : profiles) {
+        total_time += profile.metrics.nTimeMicros;
+    }
+    count = std::min(count, profiles.size());
+    std::partial_sort(profiles.begin(), profiles.begin() + count,
+                      profiles.end(),
+                      [](const InputScriptProfile &a,
+                         const InputScriptProfile &b) {
+                          return a.metrics.nTimeMicros > b.metrics.nTimeMicros;
+                      });
+
+    UniValue top(UniValue::VARR);
+    for (size_t i = 0; i < count; i++) {
+        const InputScriptProfile &profile = profiles[i];
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", profile.txid.GetHex());
+        entry.pushKV("vin", uint64_t(profile.vin));
+        entry.pushKV("valid", profile.valid);
+        if (!profile.valid) {
+            entry.pushKV("error", ScriptErrorString(profile.error));
+        }
+        entry.pushKV("time_us", profile.metrics.nTimeMicros);
+        entry.pushKV("opcodes", uint64_t(profile.metrics.nOpcodes));
+        entry.pushKV("hashedbytes", profile.metrics.nHashedBytes);
+        entry.pushKV("maxstacksize", uint64_t(profile.metrics.nMaxStackSize));
+        entry.pushKV("sigchecks", profile.metrics.nSigChecks);
+        top.push_back(entry);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("inputs", uint64_t(profiles.size()));
+    ret.pushKV("time_us", total_time);
+    ret.pushKV("top", top);
+    return ret;
+}
+
+static const std::vector<RPCResult> INPUT_SCRIPT_PROFILE_RESULT{
+    {RPCResult::Type::NUM, "inputs", "The number of inputs verified"},
+    {RPCResult::Type::NUM, "time_us",
+     "The total time spent verifying scripts, in microseconds"},
+    {RPCResult::Type::ARR,
+     "top",
+     "The most expensive inputs, slowest first",
+     {
+         {RPCResult::Type::OBJ,
+          "",
+          "",
+          {
+              {RPCResult::Type::STR_HEX, "txid", "The transaction id"},
+              {RPCResult::Type::NUM, "vin", "The input index"},
+              {RPCResult::Type::BOOL, "valid",
+               "Whether the input script verified"},
+              {RPCResult::Type::STR, "error",
+               "The script error, only present if the input is invalid"},
+              {RPCResult::Type::NUM, "time_us",
+               "Time spent verifying the input, in microseconds"},
+              {RPCResult::Type::NUM, "opcodes",
+               "Number of script instructions read"},
+              {RPCResult::Type::NUM, "hashedbytes",
+               "Number of bytes hashed by hashing opcodes and "
+               "OP_CHECKDATASIG"},
+              {RPCResult::Type::NUM, "maxstacksize",
+               "Largest number of elements on the stacks at once"},
+              {RPCResult::Type::NUM, "sigchecks",
+               "Number of signature checks"},
+          }},
+     }},
+};
+
+static RPCHelpMan getblockscriptprofile() {
+    return RPCHelpMan{
+        "getblockscriptprofile",
+        "Verifies the input scripts of a block again with profiling enabled "
+        "and reports the most expensive inputs.\n"
+        "It won't work for some heights with pruning.\n",
+        {
+            {"hash_or_height",
+             RPCArg::Type::NUM,
+             RPCArg::Optional::NO,
+             "The block hash or height of the target block",
+             "",
+             {"", "string or numeric"}},
+            {"count", RPCArg::Type::NUM, /* default */ "10",
+             "The number of inputs to report"},
+        },
+        RPCResult{RPCResult::Type::OBJ, "", "", INPUT_SCRIPT_PROFILE_RESULT},
+        RPCExamples{HelpExampleCli("getblockscriptprofile", "1000 5") +
+                    HelpExampleRpc("getblockscriptprofile", "1000, 5")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            const int count =
+                request.params[1].isNull() ? 10 : request.params[1].get_int();
+            if (count < 0) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+            }
+
+            const CBlockIndex *pindex;
+            uint32_t flags;
+            {
+                LOCK(cs_main);
+                pindex = ParseHashOrHeight(request.params[0]);
+                flags = GetNextBlockScriptFlags(
+                    config.GetChainParams().GetConsensus(), pindex->pprev);
+            }
+            const CBlock block = GetBlockChecked(config, pindex);
+            const CBlockUndo blockUndo = GetUndoChecked(pindex);
+
+            std::vector<InputScriptProfile> profiles;
+            for (size_t i = 1; i < block.vtx.size(); i++) {
+                std::vector<CTxOut> spent_outputs;
+                for (const Coin &coin : blockUndo.vtxundo.at(i - 1).vprevout) {
+                    spent_outputs.push_back(coin.GetTxOut());
+                }
+                ProfileInputScripts(*block.vtx[i], std::move(spent_outputs),
+                                    flags, profiles);
+            }
+            return InputScriptProfilesToJSON(profiles, count);
+        },
+    };
+}
+
+static RPCHelpMan gettxscriptprofile() {
+    return RPCHelpMan{
+        "gettxscriptprofile",
+        "Verifies the input scripts of a transaction with profiling enabled, "
+        "using the standard script flags, and reports the most expensive "
+        "inputs.\n"
+        "The spent outputs are looked up in the mempool and the UTXO set.\n",
+        {
+            {"hexstring", RPCArg::Type::STR_HEX, RPCArg::Optional::NO,
+             "The hex string of the raw transaction"},
+            {"count", RPCArg::Type::NUM, /* default */ "10",
+             "The number of inputs to report"},
+        },
+        RPCResult{RPCResult::Type::OBJ, "", "", INPUT_SCRIPT_PROFILE_RESULT},
+        RPCExamples{HelpExampleCli("gettxscriptprofile", "\"hexstring\"") +
+                    HelpExampleRpc("gettxscriptprofile", "\"hexstring\"")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            CMutableTransaction mtx;
+            if (!DecodeHexTx(mtx, request.params[0].get_str())) {
+                throw JSONRPCError(RPC_DESERIALIZATION_ERROR,
+                                   "TX decode failed");
+            }
+            const CTransaction tx(mtx);
+            if (tx.IsCoinBase()) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER,
+                                   "Coinbase transactions have no scripts to "
+                                   "verify");
+            }
+            const int count =
+                request.params[1].isNull() ? 10 : request.params[1].get_int();
+            if (count < 0) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+            }
+
+            std::map<COutPoint, Coin> coins;
+            for (const CTxIn &txin : tx.vin) {
+                coins[txin.prevout];
+            }
+            FindCoins(EnsureNodeContext(request.context), coins);
+            std::vector<CTxOut> spent_outputs;
+            for (const CTxIn &txin : tx.vin) {
+                const Coin &coin = coins.at(txin.prevout);
+                if (coin.IsSpent()) {
+                    throw JSONRPCError(
+                        RPC_INVALID_ADDRESS_OR_KEY,
+                        strprintf("Input %s:%d not found or already spent",
+                                  txin.prevout.GetTxId().GetHex(),
+                                  txin.prevout.GetN()));
+                }
+                spent_outputs.push_back(coin.GetTxOut());
+            }
+
+            std::vector<InputScriptProfile> profiles;
+            ProfileInputScripts(tx, std::move(spent_outputs),
+                                STANDARD_SCRIPT_VERIFY_FLAGS, profiles);
+            return InputScriptProfilesToJSON(profiles, count);
+        },
+    };
+}
+
 static RPCHelpMan savemempool() {
     return RPCHelpMan{
         "savemempool",
@@ -3004,6 +3282,7 @@ void RegisterBlockchainRPCCommands(CRPCTable &t) {
         { "blockchain",         getblockcount,                     },
         { "blockchain",         getblockhash,                      },
         { "blockchain",         getblockheader,                    },
+        { "blockchain",         getblockscriptprofile,             },
         { "blockchain",         getblockstats,                     },
         { "blockchain",         getchaintips,                      },
         { "blockchain",         getchaintxstats,                   },
@@ -3013,6 +3292,8 @@ void RegisterBlockchainRPCCommands(CRPCTable &t) {
         { "blockchain",         getmempoolentry,                   },
         { "blockchain",         getmempoolinfo,                    },
         { "blockchain",         getrawmempool,                     },
+        { "blockchain",         getscriptcacheinfo,                },
+        { "blockchain",         gettxscriptprofile,                },
         { "blockchain",         gettxout,                          },
         { "blockchain",         gettxoutsetinfo,                   },
         { "blockchain",         pruneblockchain,                   },
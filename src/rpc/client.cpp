@@ -126,6 +126,9 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     {"verifychain", 1, "nblocks"},
     {"getblockstats", 0, "hash_or_height"},
     {"getblockstats", 1, "stats"},
+    {"getblockscriptprofile", 0, "hash_or_height"},
+    {"getblockscriptprofile", 1, "count"},
+    {"gettxscriptprofile", 1, "count"},
     {"pruneblockchain", 0, "height"},
     {"keypoolrefill", 0, "newsize"},
     {"getrawmempool", 0, "verbose"},
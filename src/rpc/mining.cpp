@@ -21,6 +21,7 @@
 #include <net.h>
 #include <node/context.h>
 #include <policy/policy.h>
+#include <pow/noncescanner.h>
 #include <pow/pow.h>
 #include <rpc/blockchain.h>
 #include <rpc/mining.h>
@@ -135,17 +136,21 @@ static bool GenerateBlock(const Config &config, ChainstateManager &chainman,
     block.SetSize(GetSerializeSize(block));
     const Consensus::Params &params = config.GetChainParams().GetConsensus();
 
-    while (max_tries > 0 &&
-           block.nNonce < std::numeric_limits<uint64_t>::max() &&
-           !CheckProofOfWork(block.GetHash(), block.nBits, params) &&
-           !ShutdownRequested()) {
-        ++block.nNonce;
-        --max_tries;
+    int num_threads =
+        gArgs.GetArg("-generatethreads", DEFAULT_GENERATE_THREADS);
+    if (num_threads <= 0) {
+        num_threads = GetNumCores();
     }
+    const NonceScanner scanner(
+        num_threads,
+        gArgs.GetArg("-generatenoncechunk", DEFAULT_GENERATE_NONCE_CHUNK));
+    const bool found = scanner.Scan(block, params, max_tries,
+                                    [] { return ShutdownRequested(); });
     if (max_tries == 0 || ShutdownRequested()) {
         return false;
     }
-    if (block.nNonce == std::numeric_limits<uint64_t>::max()) {
+    if (!found) {
+        // Reached the last nonce.
         return true;
     }
 
@@ -514,6 +519,9 @@ static RPCHelpMan getmininginfo() {
                 {RPCResult::Type::NUM, "difficulty", "The current difficulty"},
                 {RPCResult::Type::NUM, "networkhashps",
                  "The network hashes per second"},
+                {RPCResult::Type::NUM, "localhashps",
+                 "The hashes per second achieved by the generate RPCs of this "
+                 "node, 0 if they were never used"},
                 {RPCResult::Type::NUM, "pooledtx", "The size of the mempool"},
                 {RPCResult::Type::STR, "chain",
                  "current network name (main, test, regtest)"},
@@ -541,6 +549,7 @@ static RPCHelpMan getmininginfo() {
                        double(GetDifficulty(::ChainActive().Tip())));
             obj.pushKV("networkhashps",
                        getnetworkhashps().HandleRequest(config, request));
+            obj.pushKV("localhashps", GetNonceScannerHashRate());
             obj.pushKV("pooledtx", uint64_t(mempool.size()));
             obj.pushKV("chain", config.GetChainParams().NetworkIDString());
             obj.pushKV("warnings", GetWarnings(false).original);
@@ -15,9 +15,13 @@
 #include <script/script.h>
 #include <script/sigencoding.h>
 #include <script/taproot.h>
+#include <streams.h>
 #include <uint256.h>
 #include <util/bitmanip.h>
 
+#include <chrono>
+#include <mutex>
+
 bool CastToBool(const valtype &vch) {
     for (size_t i = 0; i < vch.size(); i++) {
         if (vch[i] != 0) {
@@ -215,20 +219,81 @@ static bool EvalChecksig(const valtype &vchSig, const valtype &vchPubKey,
     return true;
 }
 
-bool EvalScript(std::vector<valtype> &stack, const CScript &script,
-                uint32_t flags, const BaseSignatureChecker &checker,
-                ScriptExecutionMetrics &metrics, ScriptExecutionData &execdata,
-                ScriptError *serror) {
+namespace {
+/**
+ * Hands out the instructions of a script decoded up front, so that the
+ * interpreter neither re-parses push headers nor copies push data through an
+ * intermediate buffer.
+ */
+class DecodedScriptReader {
+private:
+    std::vector<ScriptInstruction> m_instructions;
+    bool m_decoded;
+
+public:
+    explicit DecodedScriptReader(const CScript &script)
+        : m_decoded(DecodeScript(script, m_instructions)) {}
+
+    /**
+     * Get the instruction at position pos, the one following the instruction
+     * read last. Returns nullptr past the last well-formed instruction.
+     */
+    const ScriptInstruction *Read(uint32_t pos) const {
+        return pos < m_instructions.size() ? &m_instructions[pos] : nullptr;
+    }
+
+    //! Whether the instructions read up to now end with a malformed one
+    bool IsMalformed() const { return !m_decoded; }
+};
+
+/** Parses the instructions of a script one at a time, as they are read. */
+class IncrementalScriptReader {
+private:
+    const CScript &m_script;
+    CScript::const_iterator m_pc;
+    ScriptInstruction m_instruction;
+    std::vector<uint8_t> m_data;
+    bool m_malformed = false;
+
+public:
+    explicit IncrementalScriptReader(const CScript &script)
+        : m_script(script), m_pc(script.begin()) {}
+
+    const ScriptInstruction *Read(uint32_t pos) {
+        if (m_pc >= m_script.end()) {
+            return nullptr;
+        }
+        opcodetype opcode;
+        if (!m_script.GetOp(m_pc, opcode, m_data)) {
+            m_malformed = true;
+            return nullptr;
+        }
+        // Push data ends where the next instruction starts.
+        m_instruction.opcode = opcode;
+        m_instruction.next_offset = m_pc - m_script.begin();
+        m_instruction.data_size = m_data.size();
+        m_instruction.data_offset =
+            m_instruction.next_offset - m_instruction.data_size;
+        return &m_instruction;
+    }
+
+    bool IsMalformed() const { return m_malformed; }
+};
+} // namespace
+
+template <typename ScriptReader>
+static bool EvalScriptImpl(std::vector<valtype> &stack, const CScript &script,
+                           uint32_t flags, const BaseSignatureChecker &checker,
+                           ScriptExecutionMetrics &metrics,
+                           ScriptExecutionData &execdata, ScriptError *serror) {
     static const CScriptNum bnZero(0);
     static const CScriptNum bnOne(1);
     static const valtype vchFalse(0);
     static const valtype vchTrue(1, 1);
 
-    CScript::const_iterator pc = script.begin();
     CScript::const_iterator pend = script.end();
     CScript::const_iterator pbegincodehash = script.begin();
     opcodetype opcode;
-    valtype vchPushValue;
     ConditionStack vfExec;
     std::vector<valtype> altstack;
     set_error(serror, ScriptError::UNKNOWN);
@@ -240,17 +305,24 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
     execdata.m_codeseparator_pos = 0xffff'ffff;
     constexpr bool fRequireMinimal = true;
 
+    // The instructions before a malformed one are executed before BAD_OPCODE
+    // is reported.
+    ScriptReader reader(script);
+
     try {
-        for (; pc < pend; ++opcode_pos) {
+        for (const ScriptInstruction *pinstruction;
+             (pinstruction = reader.Read(opcode_pos)); ++opcode_pos) {
             bool fExec = vfExec.all_true();
 
             //
             // Read instruction
             //
-            if (!script.GetOp(pc, opcode, vchPushValue)) {
-                return set_error(serror, ScriptError::BAD_OPCODE);
+            const ScriptInstruction &instruction = *pinstruction;
+            opcode = instruction.opcode;
+            if (metrics.fProfile) {
+                ++metrics.nOpcodes;
             }
-            if (vchPushValue.size() > MAX_SCRIPT_ELEMENT_SIZE) {
+            if (instruction.data_size > MAX_SCRIPT_ELEMENT_SIZE) {
                 return set_error(serror, ScriptError::PUSH_SIZE);
             }
 
@@ -269,11 +341,16 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
             }
 
             if (fExec && 0 <= opcode && opcode <= OP_PUSHDATA4) {
+                const uint8_t *pushdata =
+                    script.data() + instruction.data_offset;
                 if (fRequireMinimal &&
-                    !CheckMinimalPush(vchPushValue, opcode)) {
+                    !CheckMinimalPush(
+                        Span<const uint8_t>(pushdata, instruction.data_size),
+                        opcode)) {
                     return set_error(serror, ScriptError::MINIMALDATA);
                 }
-                stack.push_back(vchPushValue);
+                stack.emplace_back(pushdata,
+                                   pushdata + instruction.data_size);
             } else if (fExec || (OP_IF <= opcode && opcode <= OP_ENDIF)) {
                 switch (opcode) {
                     //
@@ -912,6 +989,9 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                                 serror, ScriptError::INVALID_STACK_OPERATION);
                         }
                         valtype &vch = stacktop(-1);
+                        if (metrics.fProfile) {
+                            metrics.nHashedBytes += vch.size();
+                        }
                         valtype vchHash(
                             (opcode == OP_RIPEMD160 || opcode == OP_HASH160)
                                 ? 20
@@ -935,7 +1015,8 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
 
                     case OP_CODESEPARATOR: {
                         // Hash starts after the code separator
-                        pbegincodehash = pc;
+                        pbegincodehash =
+                            script.begin() + instruction.next_offset;
                         execdata.m_codeseparator_pos = opcode_pos;
                     } break;
 
@@ -990,6 +1071,9 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
 
                         bool fSuccess = false;
                         if (vchSig.size()) {
+                            if (metrics.fProfile) {
+                                metrics.nHashedBytes += vchMessage.size();
+                            }
                             valtype vchHash(32);
                             CSHA256()
                                 .Write(vchMessage.data(), vchMessage.size())
@@ -1487,6 +1571,15 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
             if (stack.size() + altstack.size() > MAX_STACK_SIZE) {
                 return set_error(serror, ScriptError::STACK_SIZE);
             }
+            if (metrics.fProfile) {
+                metrics.nMaxStackSize =
+                    std::max<uint32_t>(metrics.nMaxStackSize,
+                                       stack.size() + altstack.size());
+            }
+        }
+
+        if (reader.IsMalformed()) {
+            return set_error(serror, ScriptError::BAD_OPCODE);
         }
     } catch (...) {
         return set_error(serror, ScriptError::UNKNOWN);
@@ -1499,6 +1592,22 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
     return set_success(serror);
 }
 
+bool EvalScript(std::vector<valtype> &stack, const CScript &script,
+                uint32_t flags, const BaseSignatureChecker &checker,
+                ScriptExecutionMetrics &metrics, ScriptExecutionData &execdata,
+                ScriptError *serror) {
+    return EvalScriptImpl<DecodedScriptReader>(stack, script, flags, checker,
+                                               metrics, execdata, serror);
+}
+
+bool EvalScriptIncremental(std::vector<valtype> &stack, const CScript &script,
+                           uint32_t flags, const BaseSignatureChecker &checker,
+                           ScriptExecutionMetrics &metrics,
+                           ScriptExecutionData &execdata, ScriptError *serror) {
+    return EvalScriptImpl<IncrementalScriptReader>(
+        stack, script, flags, checker, metrics, execdata, serror);
+}
+
 namespace {
 
 /**
@@ -1643,6 +1752,11 @@ uint256 GetBIP143OutputsHash(const std::vector<CTxOut> &vout) {
 
 } // namespace
 
+static size_t LotusSighashSuffixIndex(BaseSigHashType base_type,
+                                      bool anyone_can_pay) {
+    return 2 * (size_t(base_type) - 1) + anyone_can_pay;
+}
+
 template <class T>
 PrecomputedTransactionData::PrecomputedTransactionData(
     const T &txTo, std::vector<CTxOut> &&spent_outputs) {
@@ -1663,16 +1777,14 @@ PrecomputedTransactionData::PrecomputedTransactionData(
     for (const CTxOut &output : txTo.vout) {
         m_amount_outputs_sum += output.nValue;
     }
-    std::vector<uint256> spent_outputs_hashes;
-    spent_outputs_hashes.reserve(m_spent_outputs.size());
     for (const CTxOut &spent_output : m_spent_outputs) {
-        spent_outputs_hashes.push_back(SerializeHash(spent_output));
         m_amount_inputs_sum += spent_output.nValue;
     }
     size_t spent_outputs_merkle_height;
     m_inputs_spent_outputs_merkle_root =
-        ComputeMerkleRoot(spent_outputs_hashes, spent_outputs_merkle_height);
+        TxOutputsMerkleRoot(m_spent_outputs, spent_outputs_merkle_height);
     assert(spent_outputs_merkle_height == m_inputs_merkle_height);
+    m_lotus_sighash_suffixes = std::make_shared<LotusSighashSuffixes>();
 }
 
 template <class T>
@@ -1778,6 +1890,43 @@ bool SignatureHashBIP143(uint256 &sighashOut, const CScript &scriptCode,
     return true;
 }
 
+/**
+ * Get the SIGHASH_LOTUS preimage suffix of the given type, serializing it if
+ * this is the first signature hash of the tx needing it.
+ */
+template <class T>
+static Span<const uint8_t>
+GetLotusSighashSuffix(const PrecomputedTransactionData &cache, const T &tx_to,
+                      BaseSigHashType base_type, bool anyone_can_pay) {
+    assert(cache.m_lotus_sighash_suffixes);
+    PrecomputedTransactionData::LotusSighashSuffixes &suffixes =
+        *cache.m_lotus_sighash_suffixes;
+    const size_t index = LotusSighashSuffixIndex(base_type, anyone_can_pay);
+    std::vector<uint8_t> &suffix = suffixes.bytes[index];
+    std::call_once(suffixes.once[index], [&] {
+        CVectorWriter ss(SER_GETHASH, 0, suffix, 0);
+        if (!anyone_can_pay) {
+            ss << cache.m_inputs_spent_outputs_merkle_root;
+            ss << (cache.m_amount_inputs_sum / SATOSHI);
+        }
+        if (base_type == BaseSigHashType::ALL) {
+            ss << (cache.m_amount_outputs_sum / SATOSHI);
+        }
+        ss << tx_to.nVersion;
+        if (!anyone_can_pay) {
+            ss << cache.m_inputs_merkle_root;
+            ss << uint8_t(cache.m_inputs_merkle_height);
+        }
+        // The SIGHASH_SINGLE output hash goes here.
+        if (base_type == BaseSigHashType::ALL) {
+            ss << cache.m_outputs_merkle_root;
+            ss << uint8_t(cache.m_outputs_merkle_height);
+        }
+        ss << tx_to.nLockTime;
+    });
+    return suffix;
+}
+
 template <class T>
 bool SignatureHashLotus(uint256 &hash_out,
                          const std::optional<ScriptExecutionData> &execdata,
@@ -1817,29 +1966,24 @@ bool SignatureHashLotus(uint256 &hash_out,
 
     if (!sig_hash_type.hasAnyoneCanPay()) {
         ss << in_pos;
-        ss << cache.m_inputs_spent_outputs_merkle_root;
-        ss << (cache.m_amount_inputs_sum / SATOSHI);
-    }
-    if (sig_hash_type.getBaseType() == BaseSigHashType::ALL) {
-        ss << (cache.m_amount_outputs_sum / SATOSHI);
     }
 
-    ss << tx_to.nVersion;
-    if (!sig_hash_type.hasAnyoneCanPay()) {
-        ss << cache.m_inputs_merkle_root;
-        ss << uint8_t(cache.m_inputs_merkle_height);
-    }
-    if (sig_hash_type.getBaseType() == BaseSigHashType::SINGLE) {
+    // The remaining fields are the same for every input, except for the
+    // SIGHASH_SINGLE output hash, so they are serialized once per tx.
+    const BaseSigHashType base_type = sig_hash_type.getBaseType();
+    const Span<const uint8_t> suffix = GetLotusSighashSuffix(
+        cache, tx_to, base_type, sig_hash_type.hasAnyoneCanPay());
+    if (base_type == BaseSigHashType::SINGLE) {
         if (in_pos >= tx_to.vout.size()) {
             return false;
         }
+        const size_t locktime_size = sizeof(tx_to.nLockTime);
+        ss << suffix.first(suffix.size() - locktime_size);
         ss << SerializeHash(tx_to.vout[in_pos]);
+        ss << suffix.last(locktime_size);
+    } else {
+        ss << suffix;
     }
-    if (sig_hash_type.getBaseType() == BaseSigHashType::ALL) {
-        ss << cache.m_outputs_merkle_root;
-        ss << uint8_t(cache.m_outputs_merkle_height);
-    }
-    ss << tx_to.nLockTime;
 
     hash_out = ss.GetHash();
     return true;
@@ -1907,6 +2051,13 @@ bool BaseSignatureChecker::VerifySignature(const std::vector<uint8_t> &vchSig,
     }
 }
 
+bool BaseSignatureChecker::VerifyTaprootControlBlock(
+    const uint256 &tapleaf_hash, const std::vector<uint8_t> &control_block,
+    const std::vector<uint8_t> &commitment) const {
+    return ::VerifyTaprootControlBlock(tapleaf_hash, control_block,
+                                       commitment);
+}
+
 template <class T>
 bool GenericTransactionSignatureChecker<T>::CheckSig(
     const std::vector<uint8_t> &vchSigIn, const std::vector<uint8_t> &vchPubKey,
@@ -2128,9 +2279,10 @@ static bool VerifyTaprootSpend(std::vector<valtype> stack,
         return set_error(serror,
                          ScriptError::TAPROOT_LEAF_VERSION_NOT_SUPPORTED);
     }
-    uint256 tapleaf_hash;
-    if (!VerifyTaprootCommitment(tapleaf_hash, control_block, vch_pubkey,
-                                 exec_script)) {
+    const uint256 tapleaf_hash = ComputeTapleafHash(
+        control_block[0] & TAPROOT_LEAF_MASK, exec_script);
+    if (!checker.VerifyTaprootControlBlock(tapleaf_hash, control_block,
+                                           vch_pubkey)) {
         return set_error(serror, ScriptError::TAPROOT_VERIFY_COMMITMENT_FAILED);
     }
     if (script_pubkey.size() == TAPROOT_SIZE_WITH_STATE) {
@@ -2173,17 +2325,17 @@ static bool VerifyScriptType(std::vector<valtype> stack,
     }
 }
 
-bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
-                  uint32_t flags, const BaseSignatureChecker &checker,
-                  ScriptExecutionMetrics &metricsOut, ScriptError *serror) {
+static bool VerifyScriptImpl(const CScript &scriptSig,
+                             const CScript &scriptPubKey, uint32_t flags,
+                             const BaseSignatureChecker &checker,
+                             ScriptExecutionMetrics &metrics,
+                             ScriptError *serror) {
     set_error(serror, ScriptError::UNKNOWN);
 
     if (!scriptSig.IsPushOnly()) {
         return set_error(serror, ScriptError::SIG_PUSHONLY);
     }
 
-    ScriptExecutionMetrics metrics = {};
-
     // scriptSig and scriptPubKey must be evaluated sequentially on the same
     // stack rather than being simply concatenated (see CVE-2010-5141)
     std::vector<valtype> stack, stackCopy;
@@ -2201,7 +2353,6 @@ bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
             // serror is set
             return false;
         }
-        metricsOut = metrics;
         return set_success(serror);
     }
     stackCopy = stack;
@@ -2260,6 +2411,29 @@ bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
         return false;
     }
 
-    metricsOut = metrics;
     return set_success(serror);
 }
+
+bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
+                  uint32_t flags, const BaseSignatureChecker &checker,
+                  ScriptExecutionMetrics &metricsOut, ScriptError *serror) {
+    ScriptExecutionMetrics metrics = {};
+    if (!metricsOut.fProfile) {
+        if (!VerifyScriptImpl(scriptSig, scriptPubKey, flags, checker, metrics,
+                              serror)) {
+            return false;
+        }
+        metricsOut = metrics;
+        return true;
+    }
+
+    metrics.fProfile = true;
+    const auto start = std::chrono::steady_clock::now();
+    const bool ret = VerifyScriptImpl(scriptSig, scriptPubKey, flags, checker,
+                                      metrics, serror);
+    metrics.nTimeMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+    metricsOut = metrics;
+    return ret;
+}
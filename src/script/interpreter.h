@@ -52,6 +52,15 @@ public:
         return false;
     }
 
+    /**
+     * Verifies the Taproot control block of a script path spend, see
+     * VerifyTaprootControlBlock.
+     */
+    virtual bool
+    VerifyTaprootControlBlock(const uint256 &tapleaf_hash,
+                              const std::vector<uint8_t> &control_block,
+                              const std::vector<uint8_t> &commitment) const;
+
     virtual ~BaseSignatureChecker() {}
 };
 
@@ -98,6 +107,18 @@ static inline bool EvalScript(std::vector<std::vector<uint8_t>> &stack,
                       dummyexecdata, error);
 }
 
+/**
+ * Same as EvalScript, but parsing the script one instruction at a time as it
+ * runs, rather than decoding it up front. Only meant to check EvalScript
+ * against.
+ */
+bool EvalScriptIncremental(std::vector<std::vector<uint8_t>> &stack,
+                           const CScript &script, uint32_t flags,
+                           const BaseSignatureChecker &checker,
+                           ScriptExecutionMetrics &metrics,
+                           ScriptExecutionData &execdata,
+                           ScriptError *error = nullptr);
+
 /**
  * Execute an unlocking and locking script together.
  *
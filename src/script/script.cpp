@@ -265,7 +265,7 @@ std::string GetOpName(opcodetype opcode) {
     }
 }
 
-bool CheckMinimalPush(const std::vector<uint8_t> &data, opcodetype opcode) {
+bool CheckMinimalPush(Span<const uint8_t> data, opcodetype opcode) {
     // Excludes OP_1NEGATE, OP_1-16 since they are by definition minimal
     assert(0 <= opcode && opcode <= OP_PUSHDATA4);
     if (data.size() == 0) {
@@ -498,6 +498,49 @@ bool GetScriptOp(CScriptBase::const_iterator &pc,
     return true;
 }
 
+bool DecodeScript(Span<const uint8_t> script,
+                  std::vector<ScriptInstruction> &instructions) {
+    instructions.clear();
+    const uint8_t *const begin = script.data();
+    const uint8_t *const end = begin + script.size();
+    const uint8_t *pc = begin;
+    while (pc < end) {
+        uint32_t opcode = *pc++;
+        uint32_t nSize = 0;
+        // Immediate operand
+        if (opcode <= OP_PUSHDATA4) {
+            if (opcode < OP_PUSHDATA1) {
+                nSize = opcode;
+            } else if (opcode == OP_PUSHDATA1) {
+                if (end - pc < 1) {
+                    return false;
+                }
+                nSize = *pc++;
+            } else if (opcode == OP_PUSHDATA2) {
+                if (end - pc < 2) {
+                    return false;
+                }
+                nSize = ReadLE16(pc);
+                pc += 2;
+            } else {
+                if (end - pc < 4) {
+                    return false;
+                }
+                nSize = ReadLE32(pc);
+                pc += 4;
+            }
+            if (uint32_t(end - pc) < nSize) {
+                return false;
+            }
+        }
+        const uint32_t data_offset = pc - begin;
+        pc += nSize;
+        instructions.push_back({static_cast<opcodetype>(opcode), data_offset,
+                                nSize, uint32_t(pc - begin)});
+    }
+    return true;
+}
+
 bool CScript::HasValidOps() const {
     CScript::const_iterator it = begin();
     while (it < end()) {
@@ -9,6 +9,7 @@
 #include <crypto/common.h>
 #include <prevector.h>
 #include <serialize.h>
+#include <span.h>
 
 #include <cassert>
 #include <climits>
@@ -207,7 +208,7 @@ std::string GetOpName(opcodetype opcode);
  * Check whether the given stack element data would be minimally pushed using
  * the given opcode.
  */
-bool CheckMinimalPush(const std::vector<uint8_t> &data, opcodetype opcode);
+bool CheckMinimalPush(Span<const uint8_t> data, opcodetype opcode);
 
 class scriptnum_error : public std::runtime_error {
 public:
@@ -528,6 +529,27 @@ bool GetScriptOp(CScriptBase::const_iterator &pc,
                  CScriptBase::const_iterator end, opcodetype &opcodeRet,
                  std::vector<uint8_t> *pvchRet);
 
+/**
+ * A pre-decoded script instruction. Push data is not copied; it is referenced
+ * by its offset into the script it was decoded from.
+ */
+struct ScriptInstruction {
+    opcodetype opcode;
+    //! Offset and size of the push data, if any.
+    uint32_t data_offset;
+    uint32_t data_size;
+    //! Offset of the following instruction.
+    uint32_t next_offset;
+};
+
+/**
+ * Decode a script into a flat instruction array, equivalent to repeatedly
+ * calling GetScriptOp. Decoding stops at the first malformed instruction, in
+ * which case false is returned and all instructions preceding it are kept.
+ */
+bool DecodeScript(Span<const uint8_t> script,
+                  std::vector<ScriptInstruction> &instructions);
+
 /** Serialized script, used inside transaction inputs and outputs */
 class CScript : public CScriptBase {
 protected:
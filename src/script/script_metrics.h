@@ -5,12 +5,29 @@
 #ifndef BITCOIN_SCRIPT_SCRIPT_METRICS_H
 #define BITCOIN_SCRIPT_SCRIPT_METRICS_H
 
+#include <cstdint>
+
 /**
  * Struct for holding cumulative results from executing a script or a sequence
  * of scripts.
  */
 struct ScriptExecutionMetrics {
     int nSigChecks = 0;
+
+    /**
+     * Set fProfile before calling VerifyScript to also collect the profiling
+     * fields below. They are filled in even if verification fails. This is
+     * off during validation; it is meant for diagnostics.
+     */
+    bool fProfile = false;
+    //! Number of instructions read, including pushes and skipped branches
+    uint32_t nOpcodes = 0;
+    //! Number of bytes hashed by hashing opcodes and OP_CHECKDATASIG
+    uint64_t nHashedBytes = 0;
+    //! Largest number of elements on the stack and altstack at once
+    uint32_t nMaxStackSize = 0;
+    //! Wall time spent in VerifyScript
+    int64_t nTimeMicros = 0;
 };
 
 #endif // BITCOIN_SCRIPT_SCRIPT_METRICS_H
@@ -13,6 +13,10 @@
 #include <util/system.h>
 #include <validation.h>
 
+#include <boost/thread/shared_mutex.hpp>
+
+#include <atomic>
+
 /**
  * In future if many more values are added, it should be considered to
  * expand the element size to 64 bytes (with padding the spare space as
@@ -69,9 +73,20 @@ public:
     }
 };
 
+/**
+ * Lookups only mark entries for erasure with atomic flags, so they can share
+ * the lock. Inserts must hold it exclusively.
+ */
+static boost::shared_mutex g_scriptExecutionCacheMutex;
 static CuckooCache::cache<ScriptCacheElement, ScriptCacheHasher>
     g_scriptExecutionCache;
 static CSHA256 g_scriptExecutionCacheHasher;
+static size_t g_scriptExecutionCacheCapacity{0};
+
+static std::atomic<uint64_t> g_scriptCacheHits{0};
+static std::atomic<uint64_t> g_scriptCacheMisses{0};
+static std::atomic<uint64_t> g_scriptCacheInserts{0};
+static std::atomic<uint64_t> g_scriptCacheEvictions{0};
 
 void InitScriptExecutionCache() {
     // Setup the salted hasher
@@ -89,7 +104,17 @@ void InitScriptExecutionCache() {
                                               DEFAULT_MAX_SCRIPT_CACHE_SIZE)),
             MAX_MAX_SCRIPT_CACHE_SIZE) *
         (size_t(1) << 20);
-    size_t nElems = g_scriptExecutionCache.setup_bytes(nMaxCacheSize);
+    size_t nElems;
+    {
+        boost::unique_lock<boost::shared_mutex> lock(
+            g_scriptExecutionCacheMutex);
+        nElems = g_scriptExecutionCache.setup_bytes(nMaxCacheSize);
+        g_scriptExecutionCacheCapacity = nElems;
+    }
+    g_scriptCacheHits = 0;
+    g_scriptCacheMisses = 0;
+    g_scriptCacheInserts = 0;
+    g_scriptCacheEvictions = 0;
     LogPrintf("Using %zu MiB out of %zu requested for script execution cache, "
               "able to store %zu elements\n",
               (nElems * sizeof(uint256)) >> 20, nMaxCacheSize >> 20, nElems);
@@ -107,21 +132,43 @@ ScriptCacheKey::ScriptCacheKey(const CTransaction &tx, uint32_t flags) {
 }
 
 bool IsKeyInScriptCache(ScriptCacheKey key, bool erase, int &nSigChecksOut) {
-    // TODO: Remove this requirement by making CuckooCache not require external
-    // locks
-    AssertLockHeld(cs_main);
-
     ScriptCacheElement elem(key, 0);
-    bool ret = g_scriptExecutionCache.get(elem, erase);
+    bool ret;
+    {
+        boost::shared_lock<boost::shared_mutex> lock(
+            g_scriptExecutionCacheMutex);
+        ret = g_scriptExecutionCache.get(elem, erase);
+    }
+    (ret ? g_scriptCacheHits : g_scriptCacheMisses)
+        .fetch_add(1, std::memory_order_relaxed);
     nSigChecksOut = elem.nSigChecks;
     return ret;
 }
 
 void AddKeyInScriptCache(ScriptCacheKey key, int nSigChecks) {
-    // TODO: Remove this requirement by making CuckooCache not require external
-    // locks
-    AssertLockHeld(cs_main);
-
     ScriptCacheElement elem(key, nSigChecks);
-    g_scriptExecutionCache.insert(elem);
+    bool evicted;
+    {
+        boost::unique_lock<boost::shared_mutex> lock(
+            g_scriptExecutionCacheMutex);
+        evicted = g_scriptExecutionCache.insert(elem);
+    }
+    g_scriptCacheInserts.fetch_add(1, std::memory_order_relaxed);
+    if (evicted) {
+        g_scriptCacheEvictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+ScriptCacheStats GetScriptCacheStats() {
+    ScriptCacheStats stats;
+    {
+        boost::shared_lock<boost::shared_mutex> lock(
+            g_scriptExecutionCacheMutex);
+        stats.capacity = g_scriptExecutionCacheCapacity;
+    }
+    stats.hits = g_scriptCacheHits.load(std::memory_order_relaxed);
+    stats.misses = g_scriptCacheMisses.load(std::memory_order_relaxed);
+    stats.inserts = g_scriptCacheInserts.load(std::memory_order_relaxed);
+    stats.evictions = g_scriptCacheEvictions.load(std::memory_order_relaxed);
+    return stats;
 }
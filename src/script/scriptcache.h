@@ -7,12 +7,7 @@
 
 #include <array>
 #include <cstdint>
-
-#include <sync.h>
-
-// Actually declared in validation.cpp; can't include because of circular
-// dependency.
-extern RecursiveMutex cs_main;
+#include <cstdlib>
 
 class CTransaction;
 
@@ -55,14 +50,26 @@ void InitScriptExecutionCache();
 /**
  * Check if a given key is in the cache, and if so, return its values.
  * (if not found, nSigChecks may or may not be set to an arbitrary value)
+ * Lookups from different threads run concurrently.
  */
-bool IsKeyInScriptCache(ScriptCacheKey key, bool erase, int &nSigChecksOut)
-    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+bool IsKeyInScriptCache(ScriptCacheKey key, bool erase, int &nSigChecksOut);
 
 /**
  * Add an entry in the cache.
  */
-void AddKeyInScriptCache(ScriptCacheKey key, int nSigChecks)
-    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+void AddKeyInScriptCache(ScriptCacheKey key, int nSigChecks);
+
+struct ScriptCacheStats {
+    //! Number of entries the cache can hold
+    size_t capacity;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    //! Entries dropped from the cache to make room for new ones
+    uint64_t evictions;
+};
+
+/** Get the script execution cache usage since it was initialized */
+ScriptCacheStats GetScriptCacheStats();
 
 #endif // BITCOIN_SCRIPT_SCRIPTCACHE_H
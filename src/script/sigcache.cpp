@@ -13,6 +13,8 @@
 
 #include <boost/thread/shared_mutex.hpp>
 
+#include <atomic>
+
 namespace {
 
 /**
@@ -70,6 +72,83 @@ public:
  * signatureCache could be made local to VerifySignature.
  */
 static CSignatureCache signatureCache;
+
+/**
+ * Cache of Taproot control blocks known to prove a tapleaf's inclusion in a
+ * commitment. Such a proof doesn't depend on the spending transaction, so
+ * contracts spending the same script path over and over skip the merkle walk
+ * and the EC tweak after the first spend.
+ */
+class CTaprootCommitmentCache {
+private:
+    //! Entries are SHA256(nonce || tapleaf hash || commitment || control block)
+    CSHA256 m_salted_hasher;
+    CuckooCache::cache<CuckooCache::KeyOnly<uint256>, SignatureCacheHasher>
+        setValid;
+    boost::shared_mutex cs_taprootcache;
+    size_t m_capacity{0};
+
+public:
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> inserts{0};
+    std::atomic<uint64_t> evictions{0};
+
+    CTaprootCommitmentCache() {
+        uint256 nonce = GetRandHash();
+        m_salted_hasher.Write(nonce.begin(), 32);
+        m_salted_hasher.Write(nonce.begin(), 32);
+    }
+
+    void ComputeEntry(uint256 &entry, const uint256 &tapleaf_hash,
+                      const std::vector<uint8_t> &control_block,
+                      const std::vector<uint8_t> &commitment) {
+        CSHA256 hasher = m_salted_hasher;
+        hasher.Write(tapleaf_hash.begin(), 32)
+            .Write(commitment.data(), commitment.size())
+            .Write(control_block.data(), control_block.size())
+            .Finalize(entry.begin());
+    }
+
+    bool Get(const uint256 &entry) {
+        bool found;
+        {
+            boost::shared_lock<boost::shared_mutex> lock(cs_taprootcache);
+            found = setValid.contains(entry, false);
+        }
+        (found ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+        return found;
+    }
+
+    void Set(uint256 &entry) {
+        bool evicted;
+        {
+            boost::unique_lock<boost::shared_mutex> lock(cs_taprootcache);
+            evicted = setValid.insert(entry);
+        }
+        inserts.fetch_add(1, std::memory_order_relaxed);
+        if (evicted) {
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    size_t setup_bytes(size_t n) {
+        boost::unique_lock<boost::shared_mutex> lock(cs_taprootcache);
+        m_capacity = setValid.setup_bytes(n);
+        hits = 0;
+        misses = 0;
+        inserts = 0;
+        evictions = 0;
+        return m_capacity;
+    }
+
+    size_t capacity() {
+        boost::shared_lock<boost::shared_mutex> lock(cs_taprootcache);
+        return m_capacity;
+    }
+};
+
+static CTaprootCommitmentCache taprootCommitmentCache;
 } // namespace
 
 // To be called once in AppInitMain/BasicTestingSetup to initialize the
@@ -88,6 +167,32 @@ void InitSignatureCache() {
               (nElems * sizeof(uint256)) >> 20, nMaxCacheSize >> 20, nElems);
 }
 
+void InitTaprootCommitmentCache() {
+    size_t nMaxCacheSize =
+        std::min(std::max(int64_t(0),
+                          gArgs.GetArg("-maxtaprootcachesize",
+                                       DEFAULT_MAX_TAPROOT_CACHE_SIZE)),
+                 MAX_MAX_SIG_CACHE_SIZE) *
+        (size_t(1) << 20);
+    size_t nElems = taprootCommitmentCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for Taproot commitment "
+              "cache, able to store %zu elements\n",
+              (nElems * sizeof(uint256)) >> 20, nMaxCacheSize >> 20, nElems);
+}
+
+ScriptCacheStats GetTaprootCommitmentCacheStats() {
+    ScriptCacheStats stats;
+    stats.capacity = taprootCommitmentCache.capacity();
+    stats.hits = taprootCommitmentCache.hits.load(std::memory_order_relaxed);
+    stats.misses =
+        taprootCommitmentCache.misses.load(std::memory_order_relaxed);
+    stats.inserts =
+        taprootCommitmentCache.inserts.load(std::memory_order_relaxed);
+    stats.evictions =
+        taprootCommitmentCache.evictions.load(std::memory_order_relaxed);
+    return stats;
+}
+
 template <typename F>
 bool RunMemoizedCheck(const std::vector<uint8_t> &vchSig, const CPubKey &pubkey,
                       const uint256 &sighash, bool storeOrErase, const F &fun) {
@@ -115,8 +220,69 @@ bool CachingTransactionSignatureChecker::IsCached(
 bool CachingTransactionSignatureChecker::VerifySignature(
     const std::vector<uint8_t> &vchSig, const CPubKey &pubkey,
     const uint256 &sighash) const {
+    if (m_batch && vchSig.size() == CPubKey::SCHNORR_SIZE) {
+        uint256 entry;
+        signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
+        if (signatureCache.Get(entry, !store)) {
+            return true;
+        }
+        SchnorrSignatureCheck check{pubkey, sighash, {}, m_preparsed};
+        std::copy(vchSig.begin(), vchSig.end(), check.sig.begin());
+        m_batch->Add(check, store ? &entry : nullptr);
+        return true;
+    }
     return RunMemoizedCheck(vchSig, pubkey, sighash, store, [&] {
-        return TransactionSignatureChecker::VerifySignature(vchSig, pubkey,
-                                                            sighash);
+        if (vchSig.size() == CPubKey::SCHNORR_SIZE) {
+            return pubkey.VerifySchnorr(sighash, vchSig, m_preparsed);
+        }
+        return pubkey.VerifyECDSA(sighash, vchSig, m_preparsed);
     });
 }
+
+bool CachingTransactionSignatureChecker::VerifyTaprootControlBlock(
+    const uint256 &tapleaf_hash, const std::vector<uint8_t> &control_block,
+    const std::vector<uint8_t> &commitment) const {
+    uint256 entry;
+    taprootCommitmentCache.ComputeEntry(entry, tapleaf_hash, control_block,
+                                        commitment);
+    // Unlike signatures, proofs are stored and kept regardless of `store`:
+    // the same script path is likely to be spent again in later blocks.
+    if (taprootCommitmentCache.Get(entry)) {
+        return true;
+    }
+    if (!TransactionSignatureChecker::VerifyTaprootControlBlock(
+            tapleaf_hash, control_block, commitment)) {
+        return false;
+    }
+    taprootCommitmentCache.Set(entry);
+    return true;
+}
+
+void SchnorrSignatureBatch::Add(const SchnorrSignatureCheck &check,
+                                const uint256 *cache_entry) {
+    m_checks.push_back(check);
+    if (cache_entry) {
+        m_cache_entries.push_back(*cache_entry);
+    }
+}
+
+bool SchnorrSignatureBatch::Verify() {
+    if (m_checks.size() < MIN_SCHNORR_BATCH_SIZE ||
+        !VerifySchnorrBatch(m_checks)) {
+        for (const SchnorrSignatureCheck &check : m_checks) {
+            if (!check.pubkey.VerifySchnorr(check.hash, check.sig,
+                                            check.preparsed)) {
+                return false;
+            }
+        }
+    }
+    for (uint256 &entry : m_cache_entries) {
+        signatureCache.Set(entry);
+    }
+    return true;
+}
+
+void SchnorrSignatureBatch::Clear() {
+    m_checks.clear();
+    m_cache_entries.clear();
+}
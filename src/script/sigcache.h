@@ -6,7 +6,9 @@
 #ifndef BITCOIN_SCRIPT_SIGCACHE_H
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
+#include <pubkey.h>
 #include <script/interpreter.h>
+#include <script/scriptcache.h>
 
 #include <vector>
 
@@ -16,8 +18,9 @@
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
-
-class CPubKey;
+// Each Taproot commitment cache entry is 32 bytes, so this holds 131072
+// proven script paths.
+static const unsigned int DEFAULT_MAX_TAPROOT_CACHE_SIZE = 4;
 
 /**
  * We're hashing a nonce into the entries themselves, so we don't need extra
@@ -39,28 +42,81 @@ public:
     }
 };
 
+/**
+ * Below this many signatures, batch verification isn't faster than verifying
+ * them one by one.
+ */
+static const size_t MIN_SCHNORR_BATCH_SIZE = 32;
+
+/**
+ * Schnorr signatures whose verification was deferred by
+ * CachingTransactionSignatureChecker, to be verified all at once.
+ *
+ * Deferring is sound because a failing Schnorr signature always fails the
+ * script, so the script result doesn't depend on the signature. The script is
+ * only valid if the batch verifies, though.
+ */
+class SchnorrSignatureBatch {
+private:
+    std::vector<SchnorrSignatureCheck> m_checks;
+    //! Signature cache entries to store once the signatures are verified
+    std::vector<uint256> m_cache_entries;
+
+public:
+    void Add(const SchnorrSignatureCheck &check, const uint256 *cache_entry);
+
+    /**
+     * Verify all the signatures added since the last Clear(). If the batch
+     * fails, they are verified one by one before giving up.
+     */
+    bool Verify();
+
+    void Clear();
+
+    bool empty() const { return m_checks.empty(); }
+    size_t size() const { return m_checks.size(); }
+};
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker {
 private:
     bool store;
+    SchnorrSignatureBatch *m_batch;
+    const PreparsedPubKeys *m_preparsed;
 
     bool IsCached(const std::vector<uint8_t> &vchSig, const CPubKey &vchPubKey,
                   const uint256 &sighash) const;
 
 public:
-    CachingTransactionSignatureChecker(const CTransaction *txToIn,
-                                       unsigned int nInIn,
-                                       const Amount amountIn, bool storeIn,
-                                       PrecomputedTransactionData &txdataIn)
+    /**
+     * If batchIn is set, Schnorr signatures missing from the cache are added
+     * to it and assumed valid, until the batch is verified.
+     * Public keys found in preparsedIn aren't parsed again.
+     */
+    CachingTransactionSignatureChecker(
+        const CTransaction *txToIn, unsigned int nInIn, const Amount amountIn,
+        bool storeIn, const PrecomputedTransactionData &txdataIn,
+        SchnorrSignatureBatch *batchIn = nullptr,
+        const PreparsedPubKeys *preparsedIn = nullptr)
         : TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn),
-          store(storeIn) {}
+          store(storeIn), m_batch(batchIn), m_preparsed(preparsedIn) {}
 
     bool VerifySignature(const std::vector<uint8_t> &vchSig,
                          const CPubKey &vchPubKey,
                          const uint256 &sighash) const override;
 
+    bool VerifyTaprootControlBlock(
+        const uint256 &tapleaf_hash, const std::vector<uint8_t> &control_block,
+        const std::vector<uint8_t> &commitment) const override;
+
     friend class TestCachingTransactionSignatureChecker;
 };
 
 void InitSignatureCache();
 
+/** Initializes the Taproot commitment cache */
+void InitTaprootCommitmentCache();
+
+/** Get the Taproot commitment cache usage since it was initialized */
+ScriptCacheStats GetTaprootCommitmentCacheStats();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -12,18 +12,28 @@ static const CHashWriter HASHER_TAPLEAF = TaggedHash("TapLeaf");
 static const CHashWriter HASHER_TAPBRANCH = TaggedHash("TapBranch");
 static const CHashWriter HASHER_TAPTWEAK = TaggedHash("TapTweak");
 
+uint256 ComputeTapleafHash(uint8_t leaf_version, const CScript &script) {
+    CHashWriter tapleaf_hasher = HASHER_TAPLEAF;
+    tapleaf_hasher << leaf_version << script;
+    return tapleaf_hasher.GetSHA256();
+}
+
 bool VerifyTaprootCommitment(uint256 &tapleaf_hash,
                              const valtype &control_block,
                              const valtype &commitment,
                              const CScript &exec_script) {
+    tapleaf_hash = ComputeTapleafHash(control_block[0] & TAPROOT_LEAF_MASK,
+                                      exec_script);
+    return VerifyTaprootControlBlock(tapleaf_hash, control_block, commitment);
+}
+
+bool VerifyTaprootControlBlock(const uint256 &tapleaf_hash,
+                               const valtype &control_block,
+                               const valtype &commitment) {
     const int path_len = (control_block.size() - TAPROOT_CONTROL_BASE_SIZE) /
                          TAPROOT_CONTROL_NODE_SIZE;
 
     // Calculate merkle root
-    CHashWriter tapleaf_hasher = HASHER_TAPLEAF;
-    tapleaf_hasher << uint8_t(control_block[0] & TAPROOT_LEAF_MASK)
-                   << exec_script;
-    tapleaf_hash = tapleaf_hasher.GetSHA256();
     uint256 merkle_hash = tapleaf_hash;
     const uint8_t *control_nodes =
         control_block.data() + TAPROOT_CONTROL_BASE_SIZE;
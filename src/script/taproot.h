@@ -50,6 +50,21 @@ bool VerifyTaprootCommitment(uint256 &tapleaf_hash,
                              const valtype &control_block,
                              const valtype &commitment, const CScript &script);
 
+/**
+ * Computes the tapleaf hash of script under the given leaf version.
+ */
+uint256 ComputeTapleafHash(uint8_t leaf_version, const CScript &script);
+
+/**
+ * Second half of VerifyTaprootCommitment: verifies that the merkle path in
+ * control_block leads from tapleaf_hash to a root that, tweaked into the
+ * internal pubkey, gives commitment. This doesn't depend on the spending
+ * transaction, so the result can be memoized.
+ */
+bool VerifyTaprootControlBlock(const uint256 &tapleaf_hash,
+                               const valtype &control_block,
+                               const valtype &commitment);
+
 /**
  * Returns whether the script is a valid Taproot output script.
  *
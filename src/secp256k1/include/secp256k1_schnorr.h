@@ -28,6 +28,35 @@ SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_schnorr_verify(
   const secp256k1_pubkey *pubkey
 ) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(4);
 
+/**
+ * Verify a batch of signatures created by secp256k1_schnorr_sign at once.
+ * This is faster than verifying them one by one with secp256k1_schnorr_verify,
+ * but doesn't tell which of the signatures is incorrect, if any.
+ * Returns: 1: all the signatures are correct
+ *          0: at least one of the signatures is incorrect, or the scratch
+ *             space is too small
+ * Args:    ctx:       a secp256k1 context object, initialized for verification.
+ *          scratch:   scratch space used for the multi-scalar multiplication.
+ *                     If NULL, the signatures are multiplied one by one, which
+ *                     doesn't give any speedup.
+ * In:      sig64:     array of n_sigs pointers to 64-byte signatures (can only
+ *                     be NULL if n_sigs is 0)
+ *          msghash32: array of n_sigs pointers to the 32-byte message hashes
+ *                     being verified (can only be NULL if n_sigs is 0). See
+ *                     secp256k1_schnorr_verify about how to produce them.
+ *          pubkeys:   array of n_sigs pointers to the public keys to verify
+ *                     with (can only be NULL if n_sigs is 0)
+ *          n_sigs:    number of signatures to verify
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_schnorr_verify_batch(
+  const secp256k1_context* ctx,
+  secp256k1_scratch_space *scratch,
+  const unsigned char *const *sig64,
+  const unsigned char *const *msghash32,
+  const secp256k1_pubkey *const *pubkeys,
+  size_t n_sigs
+) SECP256K1_ARG_NONNULL(1);
+
 /**
  * Create a signature using a custom EC-Schnorr-SHA256 construction. It
  * produces non-malleable 64-byte signatures which support batch validation,
@@ -30,6 +30,25 @@ int secp256k1_schnorr_verify(
     return secp256k1_schnorr_sig_verify(&ctx->ecmult_ctx, sig64, &q, msghash32);
 }
 
+int secp256k1_schnorr_verify_batch(
+    const secp256k1_context* ctx,
+    secp256k1_scratch_space *scratch,
+    const unsigned char *const *sig64,
+    const unsigned char *const *msghash32,
+    const secp256k1_pubkey *const *pubkeys,
+    size_t n_sigs
+) {
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+    ARG_CHECK(n_sigs == 0 || sig64 != NULL);
+    ARG_CHECK(n_sigs == 0 || msghash32 != NULL);
+    ARG_CHECK(n_sigs == 0 || pubkeys != NULL);
+    /* There are two points per signature */
+    ARG_CHECK(n_sigs <= SIZE_MAX / 2);
+
+    return secp256k1_schnorr_sig_verify_batch(ctx, scratch, sig64, msghash32, pubkeys, n_sigs);
+}
+
 int secp256k1_schnorr_sign(
     const secp256k1_context *ctx,
     unsigned char *sig64,
@@ -17,6 +17,26 @@ static int secp256k1_schnorr_sig_verify(
     const unsigned char *msg32
 );
 
+typedef struct {
+    const secp256k1_context *ctx;
+    const unsigned char *const *sig64;
+    const unsigned char *const *msg32;
+    const secp256k1_pubkey *const *pubkeys;
+    unsigned char seed[32];
+    /* Randomizer a_i of the signature at index a_idx */
+    secp256k1_scalar a;
+    size_t a_idx;
+} secp256k1_schnorr_batch_data;
+
+static int secp256k1_schnorr_sig_verify_batch(
+    const secp256k1_context* ctx,
+    secp256k1_scratch *scratch,
+    const unsigned char *const *sig64,
+    const unsigned char *const *msg32,
+    const secp256k1_pubkey *const *pubkeys,
+    size_t n_sigs
+);
+
 static int secp256k1_schnorr_compute_e(
     secp256k1_scalar* res,
     const unsigned char *r,
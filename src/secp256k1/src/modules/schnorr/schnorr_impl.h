@@ -98,6 +98,143 @@ static int secp256k1_schnorr_sig_verify(
     return 1;
 }
 
+/**
+ * Batch verification:
+ *   Inputs:
+ *     n messages m_i, public keys P_i and signatures (r_i, s_i)
+ *
+ *   Derive scalars a_i from a hash of all the inputs, with a_0 = 1.
+ *   Compute scalars e_i as above, and decompress each r_i into R_i, with R_i.y
+ *   a quadratic residue.
+ *   All signatures are valid if
+ *     (sum a_i * s_i) * G - sum a_i * R_i - sum (a_i * e_i) * P_i == 0.
+ *   If any of them is invalid, the random a_i make this sum non zero, except
+ *   with negligible probability.
+ */
+static void secp256k1_schnorr_batch_compute_seed(
+    unsigned char *seed32,
+    const unsigned char *const *sig64,
+    const unsigned char *const *msg32,
+    const secp256k1_pubkey *const *pubkeys,
+    size_t n_sigs
+) {
+    secp256k1_sha256 sha;
+    size_t i;
+    secp256k1_sha256_initialize(&sha);
+    for (i = 0; i < n_sigs; i++) {
+        secp256k1_sha256_write(&sha, sig64[i], 64);
+        secp256k1_sha256_write(&sha, msg32[i], 32);
+        secp256k1_sha256_write(&sha, pubkeys[i]->data, sizeof(pubkeys[i]->data));
+    }
+    secp256k1_sha256_finalize(&sha, seed32);
+}
+
+static void secp256k1_schnorr_batch_compute_a(
+    secp256k1_scalar *a,
+    const unsigned char *seed32,
+    size_t idx
+) {
+    secp256k1_sha256 sha;
+    unsigned char buf[32];
+    int i;
+
+    if (idx == 0) {
+        secp256k1_scalar_set_int(a, 1);
+        return;
+    }
+
+    for (i = 0; i < 8; i++) {
+        buf[i] = (idx >> (8 * i)) & 0xff;
+    }
+    secp256k1_sha256_initialize(&sha);
+    secp256k1_sha256_write(&sha, seed32, 32);
+    secp256k1_sha256_write(&sha, buf, 8);
+    secp256k1_sha256_finalize(&sha, buf);
+    /* Overflow is negligible and harmless, a_i only needs to be unpredictable */
+    secp256k1_scalar_set_b32(a, buf, NULL);
+}
+
+static int secp256k1_schnorr_batch_ecmult_callback(
+    secp256k1_scalar *sc,
+    secp256k1_ge *pt,
+    size_t idx,
+    void *data
+) {
+    secp256k1_schnorr_batch_data *batch = (secp256k1_schnorr_batch_data *)data;
+    /* Points are R_0, P_0, R_1, P_1, ... */
+    size_t i = idx / 2;
+
+    if (i != batch->a_idx) {
+        secp256k1_schnorr_batch_compute_a(&batch->a, batch->seed, i);
+        batch->a_idx = i;
+    }
+
+    if (idx % 2 == 0) {
+        secp256k1_fe rx;
+        if (!secp256k1_fe_set_b32(&rx, batch->sig64[i])) {
+            return 0;
+        }
+        if (!secp256k1_ge_set_xquad(pt, &rx)) {
+            return 0;
+        }
+        secp256k1_scalar_negate(sc, &batch->a);
+    } else {
+        secp256k1_scalar e;
+        if (!secp256k1_pubkey_load(batch->ctx, pt, batch->pubkeys[i])) {
+            return 0;
+        }
+        secp256k1_schnorr_compute_e(&e, batch->sig64[i], pt, batch->msg32[i]);
+        secp256k1_scalar_mul(sc, &e, &batch->a);
+        secp256k1_scalar_negate(sc, sc);
+    }
+    return 1;
+}
+
+static int secp256k1_schnorr_sig_verify_batch(
+    const secp256k1_context* ctx,
+    secp256k1_scratch *scratch,
+    const unsigned char *const *sig64,
+    const unsigned char *const *msg32,
+    const secp256k1_pubkey *const *pubkeys,
+    size_t n_sigs
+) {
+    secp256k1_schnorr_batch_data batch;
+    secp256k1_scalar s, as, sum_s;
+    secp256k1_gej rj;
+    size_t i;
+
+    if (n_sigs == 0) {
+        return 1;
+    }
+
+    secp256k1_schnorr_batch_compute_seed(batch.seed, sig64, msg32, pubkeys, n_sigs);
+
+    /* Compute sum a_i * s_i */
+    secp256k1_scalar_set_int(&sum_s, 0);
+    for (i = 0; i < n_sigs; i++) {
+        int overflow = 0;
+        secp256k1_scalar_set_b32(&s, sig64[i] + 32, &overflow);
+        if (overflow) {
+            return 0;
+        }
+        secp256k1_schnorr_batch_compute_a(&batch.a, batch.seed, i);
+        secp256k1_scalar_mul(&as, &s, &batch.a);
+        secp256k1_scalar_add(&sum_s, &sum_s, &as);
+    }
+    batch.a_idx = n_sigs - 1;
+
+    batch.ctx = ctx;
+    batch.sig64 = sig64;
+    batch.msg32 = msg32;
+    batch.pubkeys = pubkeys;
+    if (!secp256k1_ecmult_multi_var(&ctx->error_callback, &ctx->ecmult_ctx, scratch, &rj, &sum_s,
+                                    secp256k1_schnorr_batch_ecmult_callback, &batch, 2 * n_sigs)) {
+        return 0;
+    }
+
+    return secp256k1_gej_is_infinity(&rj);
+}
+
 static int secp256k1_schnorr_compute_e(
     secp256k1_scalar* e,
     const unsigned char *r,
@@ -78,6 +78,75 @@ void test_schnorr_sign_verify(void) {
 
 #undef SIG_COUNT
 
+#define BATCH_SIZE 40
+
+void test_schnorr_verify_batch(void) {
+    unsigned char privkey[BATCH_SIZE][32];
+    unsigned char msg[BATCH_SIZE][32];
+    unsigned char sig[BATCH_SIZE][64];
+    secp256k1_pubkey pubkey[BATCH_SIZE];
+    const unsigned char *sig_ptr[BATCH_SIZE];
+    const unsigned char *msg_ptr[BATCH_SIZE];
+    const secp256k1_pubkey *pubkey_ptr[BATCH_SIZE];
+    secp256k1_scratch_space *scratch;
+    size_t n, i;
+    int pos, mod;
+
+    for (i = 0; i < BATCH_SIZE; i++) {
+        secp256k1_scalar key;
+        random_scalar_order_test(&key);
+        secp256k1_scalar_get_b32(privkey[i], &key);
+        secp256k1_testrand256_test(msg[i]);
+        CHECK(secp256k1_ec_pubkey_create(ctx, &pubkey[i], privkey[i]) == 1);
+        CHECK(secp256k1_schnorr_sign(ctx, sig[i], msg[i], privkey[i], NULL, NULL) == 1);
+        sig_ptr[i] = sig[i];
+        msg_ptr[i] = msg[i];
+        pubkey_ptr[i] = &pubkey[i];
+    }
+
+    scratch = secp256k1_scratch_space_create(ctx, 1024 * 1024);
+    CHECK(scratch != NULL);
+
+    /* An empty batch is valid. */
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, NULL, NULL, NULL, 0) == 1);
+
+    /* Valid batches of any size are accepted, with or without scratch space. */
+    n = 1 + secp256k1_testrand_int(BATCH_SIZE);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, n) == 1);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, NULL, sig_ptr, msg_ptr, pubkey_ptr, n) == 1);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, BATCH_SIZE) == 1);
+
+    /* A single modified signature invalidates the batch. */
+    i = secp256k1_testrand_int(n);
+    pos = secp256k1_testrand_bits(6);
+    mod = 1 + secp256k1_testrand_int(255);
+    sig[i][pos] ^= mod;
+    CHECK(secp256k1_schnorr_verify(ctx, sig[i], msg[i], &pubkey[i]) == 0);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, n) == 0);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, NULL, sig_ptr, msg_ptr, pubkey_ptr, n) == 0);
+    sig[i][pos] ^= mod;
+
+    /* So does a signature with an overflowing s. */
+    memset(sig[i] + 32, 0xFF, 32);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, n) == 0);
+    CHECK(secp256k1_schnorr_sign(ctx, sig[i], msg[i], privkey[i], NULL, NULL) == 1);
+
+    /* Signatures must match their message and public key. */
+    if (n > 1) {
+        msg_ptr[0] = msg[1];
+        CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, n) == 0);
+        msg_ptr[0] = msg[0];
+        pubkey_ptr[0] = &pubkey[1];
+        CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, n) == 0);
+        pubkey_ptr[0] = &pubkey[0];
+    }
+
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, n) == 1);
+    secp256k1_scratch_space_destroy(ctx, scratch);
+}
+
+#undef BATCH_SIZE
+
 void run_schnorr_compact_test(void) {
     {
         /* Test vector 1 */
@@ -516,6 +585,9 @@ void run_schnorr_tests(void) {
     }
 
     test_schnorr_sign_verify();
+    for (i = 0; i < count; i++) {
+        test_schnorr_verify_batch();
+    }
     run_schnorr_compact_test();
 }
 
@@ -7,6 +7,7 @@
 #define BITCOIN_STREAMS_H
 
 #include <serialize.h>
+#include <span.h>
 #include <support/allocators/zeroafterfree.h>
 
 #include <algorithm>
@@ -124,24 +125,23 @@ private:
 };
 
 /**
- * Minimal stream for reading from an existing vector by reference
+ * Minimal stream for reading from an existing vector or span by reference
  */
 class VectorReader {
 private:
     const int m_type;
     const int m_version;
-    const std::vector<uint8_t> &m_data;
+    const Span<const uint8_t> m_data;
     size_t m_pos = 0;
 
 public:
     /**
      * @param[in]  type Serialization Type
      * @param[in]  version Serialization Version (including any flags)
-     * @param[in]  data Referenced byte vector to overwrite/append
+     * @param[in]  data Referenced bytes to read from
      * @param[in]  pos Starting position. Vector index where reads should start.
      */
-    VectorReader(int type, int version, const std::vector<uint8_t> &data,
-                 size_t pos)
+    VectorReader(int type, int version, Span<const uint8_t> data, size_t pos)
         : m_type(type), m_version(version), m_data(data), m_pos(pos) {
         if (m_pos > m_data.size()) {
             throw std::ios_base::failure(
@@ -154,13 +154,13 @@ public:
      * @param[in]  args  A list of items to deserialize starting at pos.
      */
     template <typename... Args>
-    VectorReader(int type, int version, const std::vector<uint8_t> &data,
-                 size_t pos, Args &&... args)
+    VectorReader(int type, int version, Span<const uint8_t> data, size_t pos,
+                 Args &&... args)
         : VectorReader(type, version, data, pos) {
         ::UnserializeMany(*this, std::forward<Args>(args)...);
     }
 
-    template <typename T> VectorReader &operator>>(T &obj) {
+    template <typename T> VectorReader &operator>>(T &&obj) {
         // Unserialize from this stream
         ::Unserialize(*this, obj);
         return (*this);
@@ -185,6 +185,13 @@ public:
         memcpy(dst, m_data.data() + m_pos, n);
         m_pos = pos_next;
     }
+
+    void ignore(size_t n) {
+        if (n > size()) {
+            throw std::ios_base::failure("VectorReader::ignore(): end of data");
+        }
+        m_pos += n;
+    }
 };
 
 /**
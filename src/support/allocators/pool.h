@@ -0,0 +1,191 @@
+// Copyright (c) 2021 The Logos Foundation
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <list>
+#include <new>
+#include <utility>
+
+/**
+ * A memory resource handing out small blocks carved from large chunks.
+ *
+ * Node based containers such as std::unordered_map make one allocation per
+ * element. Serving them from a few large chunks saves the malloc overhead of
+ * each node, keeps the nodes close together in memory, and makes their memory
+ * usage exactly known.
+ *
+ * Blocks of up to MAX_BLOCK_SIZE_BYTES are rounded up to a multiple of
+ * ELEM_ALIGN_BYTES. Freed blocks are kept in one free list per rounded size,
+ * and reused by the next allocation of the same size. Memory only goes back
+ * to the system when the resource is destroyed. Larger or more aligned
+ * requests fall back to operator new.
+ *
+ * Not thread safe.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource final {
+    static_assert(ALIGN_BYTES > 0 && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0,
+                  "ALIGN_BYTES must be a power of two");
+
+    /** A free block, linking to the next free block of the same size */
+    struct ListNode {
+        ListNode *m_next;
+
+        explicit ListNode(ListNode *next) : m_next(next) {}
+    };
+
+    static constexpr std::size_t ELEM_ALIGN_BYTES =
+        std::max(alignof(ListNode), ALIGN_BYTES);
+    static_assert(sizeof(ListNode) <= ELEM_ALIGN_BYTES,
+                  "A free block must be able to hold a ListNode");
+    static_assert(MAX_BLOCK_SIZE_BYTES % ELEM_ALIGN_BYTES == 0,
+                  "MAX_BLOCK_SIZE_BYTES must be a multiple of the alignment");
+
+    const std::size_t m_chunk_size_bytes;
+    std::list<std::byte *> m_allocated_chunks;
+    //! Free lists, indexed by block size in units of ELEM_ALIGN_BYTES
+    std::array<ListNode *, MAX_BLOCK_SIZE_BYTES / ELEM_ALIGN_BYTES + 1>
+        m_free_lists{};
+    //! Not yet handed out part of the last chunk
+    std::byte *m_available_memory_it = nullptr;
+    std::byte *m_available_memory_end = nullptr;
+
+    static constexpr std::size_t NumElemAlignBytes(std::size_t bytes) {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static constexpr bool IsFreeListUsable(std::size_t bytes,
+                                           std::size_t alignment) {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void AddToFreeList(void *p, ListNode *&head) {
+        head = new (p) ListNode(head);
+    }
+
+    void AllocateChunk() {
+        // Don't waste what remains of the current chunk.
+        const std::size_t remaining =
+            m_available_memory_end - m_available_memory_it;
+        if (remaining != 0) {
+            AddToFreeList(m_available_memory_it,
+                          m_free_lists[remaining / ELEM_ALIGN_BYTES]);
+        }
+        void *storage = ::operator new(m_chunk_size_bytes,
+                                       std::align_val_t{ELEM_ALIGN_BYTES});
+        m_available_memory_it = static_cast<std::byte *>(storage);
+        m_available_memory_end = m_available_memory_it + m_chunk_size_bytes;
+        m_allocated_chunks.push_back(m_available_memory_it);
+    }
+
+public:
+    /** Chunk sizes are rounded up to a multiple of the alignment. */
+    explicit PoolResource(std::size_t chunk_size_bytes)
+        : m_chunk_size_bytes(NumElemAlignBytes(chunk_size_bytes) *
+                             ELEM_ALIGN_BYTES) {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+        AllocateChunk();
+    }
+
+    PoolResource() : PoolResource(256 * 1024) {}
+
+    PoolResource(const PoolResource &) = delete;
+    PoolResource &operator=(const PoolResource &) = delete;
+
+    ~PoolResource() {
+        for (std::byte *chunk : m_allocated_chunks) {
+            ::operator delete(chunk, std::align_val_t{ELEM_ALIGN_BYTES});
+        }
+    }
+
+    void *Allocate(std::size_t bytes, std::size_t alignment) {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            return ::operator new(bytes, std::align_val_t{alignment});
+        }
+        const std::size_t num_alignments = NumElemAlignBytes(bytes);
+        ListNode *&head = m_free_lists[num_alignments];
+        if (head != nullptr) {
+            return std::exchange(head, head->m_next);
+        }
+        const std::ptrdiff_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+        if (round_bytes > m_available_memory_end - m_available_memory_it) {
+            AllocateChunk();
+        }
+        return std::exchange(m_available_memory_it,
+                             m_available_memory_it + round_bytes);
+    }
+
+    void Deallocate(void *p, std::size_t bytes,
+                    std::size_t alignment) noexcept {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            ::operator delete(p, std::align_val_t{alignment});
+            return;
+        }
+        AddToFreeList(p, m_free_lists[NumElemAlignBytes(bytes)]);
+    }
+
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+};
+
+/**
+ * Allocator serving its allocations from a PoolResource, which must outlive
+ * the allocator and all the containers using it.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES,
+          std::size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator {
+public:
+    using value_type = T;
+    using ResourceType = PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>;
+
+    template <typename U> struct rebind {
+        using other = PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>;
+    };
+
+    PoolAllocator(ResourceType *resource) noexcept : m_resource(resource) {}
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>
+                      &other) noexcept
+        : m_resource(other.resource()) {}
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(
+            m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType *resource() const noexcept { return m_resource; }
+
+private:
+    ResourceType *m_resource;
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES,
+          std::size_t ALIGN_BYTES>
+bool operator==(
+    const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &a,
+    const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &b) noexcept {
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES,
+          std::size_t ALIGN_BYTES>
+bool operator!=(
+    const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &a,
+    const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> &b) noexcept {
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
@@ -142,4 +142,36 @@ BOOST_AUTO_TEST_CASE(bip32_test3) {
     RunTest(test3);
 }
 
+BOOST_AUTO_TEST_CASE(bip32_derive_range) {
+    std::vector<uint8_t> seed = ParseHex(test1.strHexMaster);
+    CExtKey key;
+    key.SetSeed(seed.data(), seed.size());
+    const CExtPubKey pubkey = key.Neuter();
+
+    for (unsigned int first : {0U, 0x7ffffff0U, 0x80000000U, 0xfffffff0U}) {
+        const size_t count = 16;
+        std::vector<CExtKey> keys;
+        BOOST_CHECK(key.DeriveRange(keys, first, count));
+        BOOST_CHECK_EQUAL(keys.size(), count);
+        std::vector<CExtPubKey> pubkeys;
+        const bool hardened = first & 0x80000000;
+        if (!hardened) {
+            BOOST_CHECK(pubkey.DeriveRange(pubkeys, first, count));
+            BOOST_CHECK_EQUAL(pubkeys.size(), count);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            CExtKey expected;
+            BOOST_CHECK(key.Derive(expected, first + i));
+            BOOST_CHECK(keys[i] == expected);
+            if (!hardened) {
+                BOOST_CHECK(pubkeys[i] == expected.Neuter());
+            }
+        }
+    }
+
+    std::vector<CExtKey> keys(3);
+    BOOST_CHECK(key.DeriveRange(keys, 42, 0));
+    BOOST_CHECK(keys.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
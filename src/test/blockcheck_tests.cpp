@@ -131,4 +131,29 @@ BOOST_AUTO_TEST_CASE(blockfail) {
     RunCheckOnBlock(config, block, "bad-blk-size");
 }
 
+BOOST_AUTO_TEST_CASE(batched_header_hashes) {
+    std::vector<CBlockHeader> headers;
+    for (size_t count = 0; count <= 20; ++count) {
+        const std::vector<BlockHash> hashes = GetBlockHeaderHashes(headers);
+        BOOST_REQUIRE_EQUAL(hashes.size(), headers.size());
+        for (size_t i = 0; i < headers.size(); ++i) {
+            BOOST_CHECK(hashes[i] == headers[i].GetHash());
+        }
+
+        CBlockHeader header;
+        header.hashPrevBlock = BlockHash(InsecureRand256());
+        header.nBits = InsecureRand32();
+        header.SetBlockTime(InsecureRandBits(48));
+        header.nReserved = InsecureRandBits(16);
+        header.nNonce = InsecureRandBits(64);
+        header.nHeaderVersion = InsecureRandBits(8);
+        header.SetSize(InsecureRandBits(56));
+        header.nHeight = InsecureRand32();
+        header.hashEpochBlock = InsecureRand256();
+        header.hashMerkleRoot = InsecureRand256();
+        header.hashExtendedMetadata = InsecureRand256();
+        headers.push_back(header);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
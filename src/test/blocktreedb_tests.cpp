@@ -0,0 +1,100 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <test/util/logging.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(blocktreedb_tests, TestChain100Setup)
+
+/** Load the block index stored in db into blockman */
+static bool LoadBlockIndex(CBlockTreeDB &db, BlockManager &blockman)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    return db.LoadBlockIndexGuts(
+        Params().GetConsensus(),
+        [&](const BlockHash &hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+            return blockman.InsertBlockIndex(hash);
+        });
+}
+
+static void CheckSameBlockIndex(const BlockMap &expected,
+                                const BlockMap &loaded) {
+    BOOST_CHECK_EQUAL(loaded.size(), expected.size());
+    for (const auto &[hash, pindex] : expected) {
+        const auto it = loaded.find(hash);
+        BOOST_REQUIRE(it != loaded.end());
+        const CBlockIndex *loaded_index = it->second;
+        // The header hash covers the hash of the parent too.
+        BOOST_CHECK(loaded_index->GetBlockHeader().GetHash() == hash);
+        BOOST_CHECK_EQUAL(loaded_index->nHeight, pindex->nHeight);
+        BOOST_CHECK(loaded_index->nStatus == pindex->nStatus);
+        BOOST_CHECK_EQUAL(loaded_index->nTx, pindex->nTx);
+        BOOST_CHECK(loaded_index->GetBlockPos() == pindex->GetBlockPos());
+        BOOST_CHECK(loaded_index->GetUndoPos() == pindex->GetUndoPos());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_index_snapshot) {
+    LOCK(cs_main);
+    const BlockMap &block_index = m_node.chainman->BlockIndex();
+    std::vector<const CBlockIndex *> blocks;
+    for (const auto &entry : block_index) {
+        blocks.push_back(entry.second);
+    }
+
+    CBlockTreeDB db(1 << 20, /* fMemory */ false, /* fWipe */ true);
+    // Stamp the empty database with the current version.
+    BOOST_REQUIRE(db.Upgrade(Params().GetConsensus()));
+
+    uint256 snapshot_id;
+    BOOST_CHECK(db.WriteBlockIndexSnapshot(blocks, snapshot_id));
+    BOOST_CHECK(db.WriteBatchSync({}, 0, blocks, snapshot_id));
+    {
+        ASSERT_DEBUG_LOG("Loaded the block index from");
+        BlockManager blockman;
+        BOOST_CHECK(LoadBlockIndex(db, blockman));
+        CheckSameBlockIndex(block_index, blockman.m_block_index);
+    }
+
+    // A snapshot not followed by its database write is ignored.
+    uint256 unused_snapshot_id;
+    BOOST_CHECK(db.WriteBlockIndexSnapshot(blocks, unused_snapshot_id));
+    BOOST_CHECK(unused_snapshot_id != snapshot_id);
+    {
+        ASSERT_DEBUG_LOG("The snapshot is stale");
+        BlockManager blockman;
+        BOOST_CHECK(LoadBlockIndex(db, blockman));
+        CheckSameBlockIndex(block_index, blockman.m_block_index);
+    }
+
+    // So is a corrupted one.
+    BOOST_CHECK(db.WriteBlockIndexSnapshot(blocks, snapshot_id));
+    BOOST_CHECK(db.WriteBatchSync({}, 0, {}, snapshot_id));
+    FILE *file =
+        fsbridge::fopen(GetDataDir() / "blocks" / "index.snapshot", "rb+");
+    BOOST_REQUIRE(file != nullptr);
+    BOOST_REQUIRE_EQUAL(fseek(file, 100, SEEK_SET), 0);
+    const int byte = fgetc(file);
+    BOOST_REQUIRE_EQUAL(fseek(file, 100, SEEK_SET), 0);
+    fputc(byte ^ 1, file);
+    fclose(file);
+    {
+        ASSERT_DEBUG_LOG("Checksum mismatch");
+        BlockManager blockman;
+        BOOST_CHECK(LoadBlockIndex(db, blockman));
+        CheckSameBlockIndex(block_index, blockman.m_block_index);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -106,6 +106,32 @@ struct FrozenCleanupCheck {
     };
 };
 
+struct BatchedCheck {
+    //! Records the failures of the checks, which are only reported on Verify
+    struct Batch {
+        static std::atomic<size_t> n_verified;
+        bool fails{false};
+        size_t n_checks{0};
+        bool Verify() {
+            n_verified.fetch_add(n_checks, std::memory_order_relaxed);
+            return !fails;
+        }
+        void Clear() {
+            fails = false;
+            n_checks = 0;
+        }
+    };
+    bool fails{false};
+    BatchedCheck(bool fails_in) : fails(fails_in) {}
+    BatchedCheck() {}
+    bool operator()(Batch &batch) {
+        batch.fails |= fails;
+        batch.n_checks++;
+        return true;
+    }
+    void swap(BatchedCheck &x) { std::swap(fails, x.fails); };
+};
+
 // Static Allocations
 std::mutex FrozenCleanupCheck::m{};
 std::atomic<uint64_t> FrozenCleanupCheck::nFrozen{0};
@@ -114,6 +140,7 @@ Mutex UniqueCheck::m;
 std::unordered_multiset<size_t> UniqueCheck::results;
 std::atomic<size_t> FakeCheckCheckCompletion::n_calls{0};
 std::atomic<size_t> MemoryCheck::fake_allocated_memory{0};
+std::atomic<size_t> BatchedCheck::Batch::n_verified{0};
 
 // Queue Typedefs
 typedef CCheckQueue<FakeCheckCheckCompletion> Correct_Queue;
@@ -122,6 +149,7 @@ typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
+typedef CCheckQueue<BatchedCheck> Batched_Queue;
 
 /** This test case checks that the CCheckQueue works properly
  * with each specified size_t Checks pushed.
@@ -244,6 +272,37 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Recovers_From_Failure) {
     tg.join_all();
 }
 
+// Test that the work checks defer to their worker's batch is verified before
+// the result is returned, and that failures are cleared between runs.
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Batch) {
+    auto batched_queue = std::make_unique<Batched_Queue>(QUEUE_BATCH_SIZE);
+    boost::thread_group tg;
+    for (auto x = 0; x < SCRIPT_CHECK_THREADS; ++x) {
+        tg.create_thread([&] { batched_queue->Thread(); });
+    }
+
+    for (auto times = 0; times < 10; ++times) {
+        for (const bool one_fails : {true, false}) {
+            BatchedCheck::Batch::n_verified = 0;
+            CCheckQueueControl<BatchedCheck> control(batched_queue.get());
+            {
+                std::vector<BatchedCheck> vChecks;
+                vChecks.resize(1000, false);
+                vChecks[InsecureRandRange(1000)] = one_fails;
+                control.Add(vChecks);
+            }
+            bool r = control.Wait();
+            BOOST_REQUIRE(r != one_fails);
+            if (!one_fails) {
+                BOOST_REQUIRE_EQUAL(BatchedCheck::Batch::n_verified.load(),
+                                    1000U);
+            }
+        }
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
 // Test that unique checks are actually all called individually, rather than
 // just one check being called repeatedly. Test that checks are not called
 // more than once as well
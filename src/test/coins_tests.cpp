@@ -293,6 +293,108 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test) {
     SimulationTest(&db_base, true);
 }
 
+BOOST_AUTO_TEST_CASE(coins_cache_background_write) {
+    CCoinsViewDB db{"test", /*nCacheSize*/ 1 << 23, /*fMemory*/ true,
+                    /*fWipe*/ false};
+    CCoinsViewCache cache(&db);
+    cache.SetBestBlock(BlockHash(InsecureRand256()));
+
+    const COutPoint kept(TxId(InsecureRand256()), 0);
+    const COutPoint spent(TxId(InsecureRand256()), 0);
+    const COutPoint fresh(TxId(InsecureRand256()), 0);
+    const Coin coin(CTxOut(50 * COIN, CScript() << OP_TRUE), 1, false);
+    cache.AddCoin(kept, Coin(coin), false);
+    cache.AddCoin(spent, Coin(coin), false);
+    BOOST_CHECK(cache.Flush());
+
+    // Spend a coin that is on disk, and one that never made it there.
+    cache.AddCoin(fresh, Coin(coin), false);
+    BOOST_CHECK(cache.SpendCoin(spent));
+    BOOST_CHECK(cache.SpendCoin(fresh));
+    const BlockHash hashBlock(InsecureRand256());
+    cache.SetBestBlock(hashBlock);
+    BOOST_CHECK(!cache.AccessCoin(kept).IsSpent());
+
+    auto generation = std::make_unique<CCoinsMapGeneration>();
+    cache.Freeze(*generation, /*wipe*/ false);
+    BOOST_CHECK_EQUAL(generation->hashBlock, hashBlock);
+    BOOST_CHECK_EQUAL(generation->coins.size(), 1U);
+    BOOST_CHECK(generation->coins.count(spent));
+    // The unspent coin stays cached, and nothing is left to write.
+    BOOST_CHECK(cache.HaveCoinInCache(kept));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1U);
+
+    BOOST_CHECK(db.WriteInBackground(std::move(generation)));
+    BOOST_CHECK(db.IsWritingInBackground());
+    // The coins are served while they are being written.
+    BOOST_CHECK_EQUAL(db.GetBestBlock(), hashBlock);
+    BOOST_CHECK(!db.HaveCoin(spent));
+    BOOST_CHECK(!cache.HaveCoin(spent));
+    BOOST_CHECK(!cache.HaveCoin(fresh));
+    BOOST_CHECK(db.HaveCoin(kept));
+
+    BOOST_CHECK(db.FinishBackgroundWrite());
+    BOOST_CHECK(!db.IsWritingInBackground());
+    BOOST_CHECK_EQUAL(db.BackgroundWriteMemoryUsage(), 0U);
+    BOOST_CHECK_EQUAL(db.GetBestBlock(), hashBlock);
+    BOOST_CHECK(!db.HaveCoin(spent));
+    BOOST_CHECK(!db.HaveCoin(fresh));
+    BOOST_CHECK(db.HaveCoin(kept));
+
+    // Wiping leaves an empty cache.
+    cache.SpendCoin(kept);
+    generation = std::make_unique<CCoinsMapGeneration>();
+    cache.Freeze(*generation, /*wipe*/ true);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK(db.WriteInBackground(std::move(generation)));
+    BOOST_CHECK(!cache.HaveCoin(kept));
+    BOOST_CHECK(db.FinishBackgroundWrite());
+    BOOST_CHECK(!db.HaveCoin(kept));
+}
+
+BOOST_AUTO_TEST_CASE(coins_db_prefetch) {
+    CCoinsViewDB db{"test", /*nCacheSize*/ 1 << 23, /*fMemory*/ true,
+                    /*fWipe*/ false};
+    std::vector<COutPoint> outpoints;
+    {
+        CCoinsViewCache cache(&db);
+        cache.SetBestBlock(BlockHash(InsecureRand256()));
+        for (int i = 0; i < 200; ++i) {
+            outpoints.emplace_back(TxId(InsecureRand256()), i);
+            if (i % 3) {
+                cache.AddCoin(outpoints.back(),
+                              Coin(CTxOut(i * SATOSHI, CScript()), i, false),
+                              false);
+            }
+        }
+        BOOST_CHECK(cache.Flush());
+    }
+
+    std::vector<Coin> coins;
+    db.GetCoins(outpoints, coins, /*num_threads*/ 4);
+    BOOST_CHECK_EQUAL(coins.size(), outpoints.size());
+    CCoinsViewCache cache(&db);
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        BOOST_CHECK_EQUAL(coins[i].IsSpent(), i % 3 == 0);
+        if (!coins[i].IsSpent()) {
+            BOOST_CHECK_EQUAL(coins[i].GetTxOut().nValue, int(i) * SATOSHI);
+            cache.CacheCoin(outpoints[i], std::move(coins[i]));
+        }
+    }
+
+    // Prefetched coins are cached clean, and served without the database.
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 133U);
+    CCoinsViewCache child(&cache);
+    child.SetBestBlock(BlockHash(InsecureRand256()));
+    BOOST_CHECK(child.SpendCoin(outpoints[1]));
+    BOOST_CHECK(child.Flush());
+    BOOST_CHECK(!cache.HaveCoin(outpoints[1]));
+    BOOST_CHECK(db.HaveCoin(outpoints[1]));
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!db.HaveCoin(outpoints[1]));
+    BOOST_CHECK(!db.HaveCoin(outpoints[0]));
+}
+
 // Store of all necessary tx and undo data for next test
 typedef std::map<COutPoint, std::tuple<CTransaction, CTxUndo, Coin>> UtxoData;
 UtxoData utxoData;
@@ -651,7 +753,8 @@ void GetCoinMapEntry(const CCoinsMap &map, Amount &value, char &flags) {
 }
 
 void WriteCoinViewEntry(CCoinsView &view, const Amount value, char flags) {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(0, CCoinsMap::hasher(), CCoinsMap::key_equal(), &resource);
     InsertCoinMapEntry(map, value, flags);
     BOOST_CHECK(view.BatchWrite(map, BlockHash()));
 }
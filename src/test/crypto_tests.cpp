@@ -1048,6 +1048,34 @@ BOOST_AUTO_TEST_CASE(sha256d64) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(sha256multi) {
+    // Cover message lengths on both sides of the padding boundaries.
+    for (size_t len : {0, 1, 32, 52, 55, 56, 63, 64, 65, 108, 119, 120, 200}) {
+        for (size_t count = 0; count <= 19; ++count) {
+            std::vector<uint8_t> in(len * count);
+            for (uint8_t &byte : in) {
+                byte = InsecureRandBits(8);
+            }
+            std::vector<uint8_t> out1(32 * count), out2(32 * count);
+            for (size_t i = 0; i < count; ++i) {
+                CSHA256()
+                    .Write(in.data() + len * i, len)
+                    .Finalize(out1.data() + 32 * i);
+            }
+            SHA256Multi(out2.data(), in.data(), len, count);
+            BOOST_CHECK(out1 == out2);
+
+            for (size_t i = 0; i < count; ++i) {
+                CHash256()
+                    .Write(MakeSpan(in).subspan(len * i, len))
+                    .Finalize(MakeSpan(out1).subspan(32 * i, 32));
+            }
+            SHA256DMulti(out2.data(), in.data(), len, count);
+            BOOST_CHECK(out1 == out2);
+        }
+    }
+}
+
 static void TestSHA3_256(const std::string &input, const std::string &output) {
     const auto in_bytes = ParseHex(input);
     const auto out_bytes = ParseHex(output);
@@ -1091,6 +1119,51 @@ BOOST_AUTO_TEST_CASE(keccak_tests) {
         "5f4a7f2eca7d57740ef9f1a077b4fc67328092ec62620447fe27ad8ed5f7e34f");
 }
 
+BOOST_AUTO_TEST_CASE(keccak_4way) {
+    if (!KeccakF_4way) {
+        return;
+    }
+    uint64_t states[4][25];
+    uint64_t interleaved[4 * 25];
+    for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 25; ++i) {
+            states[j][i] = InsecureRandBits(64);
+            interleaved[4 * i + j] = states[j][i];
+        }
+    }
+    for (int n = 0; n < 100; ++n) {
+        for (int j = 0; j < 4; ++j) {
+            KeccakF(states[j]);
+        }
+        KeccakF_4way(interleaved);
+    }
+    for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 25; ++i) {
+            BOOST_CHECK_EQUAL(interleaved[4 * i + j], states[j][i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sha3_256multi) {
+    // Cover message lengths on both sides of the 136-byte rate.
+    for (size_t len : {0, 1, 32, 64, 135, 136, 137, 271, 272, 300}) {
+        for (size_t count = 0; count <= 9; ++count) {
+            std::vector<uint8_t> in(len * count);
+            for (uint8_t &byte : in) {
+                byte = InsecureRandBits(8);
+            }
+            std::vector<uint8_t> out1(32 * count), out2(32 * count);
+            for (size_t i = 0; i < count; ++i) {
+                SHA3_256()
+                    .Write(MakeSpan(in).subspan(len * i, len))
+                    .Finalize(MakeSpan(out1).subspan(32 * i, 32));
+            }
+            SHA3_256Multi(out2.data(), in.data(), len, count);
+            BOOST_CHECK(out1 == out2);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha3_256_tests) {
     // Test vectors from
     // https://csrc.nist.gov/CSRC/media/Projects/Cryptographic-Algorithm-Validation-Program/documents/sha3/sha-3bytetestvectors.zip
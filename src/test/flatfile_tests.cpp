@@ -131,4 +131,54 @@ BOOST_AUTO_TEST_CASE(flatfile_flush) {
     BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1U);
 }
 
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(flatfile_mapping_cache) {
+    const auto data_dir = m_args.GetDataDirPath();
+    FlatFileSeq seq(data_dir, "a", 100);
+    const fs::path path0 = seq.FileName(FlatFilePos(0, 0));
+    const fs::path path1 = seq.FileName(FlatFilePos(1, 0));
+
+    const std::vector<uint8_t> bytes{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    for (int file_num : {0, 1}) {
+        CAutoFile file(seq.Open(FlatFilePos(file_num, 0)), SER_DISK,
+                       CLIENT_VERSION);
+        file.write((const char *)bytes.data(), bytes.size());
+    }
+
+    // Mapping is disabled by default.
+    FlatFileMappingCache cache;
+    BOOST_CHECK(!cache.Get(path0, 4, bytes.size()));
+
+    cache.SetMaxMappings(1);
+    auto mapping0 = cache.Get(path0, 4, 8);
+    BOOST_REQUIRE(mapping0);
+    BOOST_CHECK_EQUAL(mapping0->size(), 8U);
+    BOOST_CHECK(std::equal(mapping0->data().begin(), mapping0->data().end(),
+                           bytes.begin()));
+    BOOST_CHECK(cache.Get(path0, 8, 8) == mapping0);
+
+    // Requests beyond the final size or the end of the file are refused.
+    BOOST_CHECK(!cache.Get(path0, 9, 8));
+    BOOST_CHECK(!cache.Get(path0, 9, bytes.size() + 1));
+    BOOST_CHECK(!cache.Get(data_dir / "missing.dat", 4, 8));
+
+    // Only one mapping is kept, the evicted one stays valid while in use.
+    auto mapping1 = cache.Get(path1, 4, bytes.size());
+    BOOST_REQUIRE(mapping1);
+    auto remapped0 = cache.Get(path0, 4, 8);
+    BOOST_REQUIRE(remapped0);
+    BOOST_CHECK(remapped0 != mapping0);
+    BOOST_CHECK_EQUAL(mapping0->data()[7], 7);
+
+    // Erased files are mapped again on the next request.
+    cache.Erase(path0);
+    BOOST_CHECK(cache.Get(path0, 4, 8) != remapped0);
+
+    // Disabling mapping drops all mappings.
+    cache.SetMaxMappings(0);
+    BOOST_CHECK(!cache.Get(path1, 4, bytes.size()));
+    BOOST_CHECK_EQUAL(mapping1->data()[9], 9);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
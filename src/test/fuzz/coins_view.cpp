@@ -133,7 +133,9 @@ void test_one_input(const std::vector<uint8_t> &buffer) {
                 break;
             }
             case 9: {
-                CCoinsMap coins_map;
+                CCoinsMapMemoryResource resource;
+                CCoinsMap coins_map(0, CCoinsMap::hasher(),
+                                    CCoinsMap::key_equal(), &resource);
                 while (fuzzed_data_provider.ConsumeBool()) {
                     CCoinsCacheEntry coins_cache_entry;
                     coins_cache_entry.flags =
@@ -0,0 +1,94 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pubkey.h>
+#include <script/interpreter.h>
+#include <script/script_error.h>
+#include <test/fuzz/FuzzedDataProvider.h>
+#include <test/fuzz/fuzz.h>
+#include <test/fuzz/util.h>
+
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace {
+/**
+ * Accepts every non-empty signature, and records the script code each one
+ * was checked against, which depends on the last OP_CODESEPARATOR.
+ */
+class RecordingSignatureChecker : public BaseSignatureChecker {
+public:
+    mutable std::vector<CScript> script_codes;
+
+    bool CheckSig(const std::vector<uint8_t> &vchSigIn,
+                  const std::vector<uint8_t> &vchPubKey,
+                  const std::optional<ScriptExecutionData> &execdata,
+                  const CScript &scriptCode, uint32_t flags) const override {
+        script_codes.push_back(scriptCode);
+        return !vchSigIn.empty();
+    }
+};
+
+struct EvalResult {
+    bool success;
+    ScriptError error;
+    std::vector<std::vector<uint8_t>> stack;
+    ScriptExecutionMetrics metrics;
+    uint32_t codeseparator_pos;
+    std::vector<CScript> script_codes;
+};
+
+template <typename Eval>
+EvalResult Run(Eval eval, const std::vector<std::vector<uint8_t>> &stack,
+               const CScript &script, uint32_t flags) {
+    EvalResult result;
+    result.stack = stack;
+    RecordingSignatureChecker checker;
+    ScriptExecutionData execdata{script};
+    result.metrics.fProfile = true;
+    result.success = eval(result.stack, script, flags, checker, result.metrics,
+                          execdata, &result.error);
+    result.codeseparator_pos = execdata.m_codeseparator_pos;
+    result.script_codes = checker.script_codes;
+    return result;
+}
+} // namespace
+
+void initialize() {
+    static const ECCVerifyHandle verify_handle;
+}
+
+// Differential check of EvalScript, which runs on a script decoded up front,
+// against the same interpreter parsing one instruction at a time.
+void test_one_input(const std::vector<uint8_t> &buffer) {
+    FuzzedDataProvider fuzzed_data_provider(buffer.data(), buffer.size());
+    const uint32_t flags = fuzzed_data_provider.ConsumeIntegral<uint32_t>();
+    std::vector<std::vector<uint8_t>> stack;
+    const size_t stack_size =
+        fuzzed_data_provider.ConsumeIntegralInRange<size_t>(0, 8);
+    for (size_t i = 0; i < stack_size; ++i) {
+        stack.push_back(ConsumeRandomLengthByteVector(fuzzed_data_provider));
+    }
+    const std::vector<uint8_t> script_bytes =
+        fuzzed_data_provider.ConsumeRemainingBytes<uint8_t>();
+    const CScript script(script_bytes.begin(), script_bytes.end());
+
+    const EvalResult decoded = Run(
+        [](auto &&...args) { return EvalScript(args...); }, stack, script,
+        flags);
+    const EvalResult incremental = Run(
+        [](auto &&...args) { return EvalScriptIncremental(args...); }, stack,
+        script, flags);
+    assert(decoded.success == incremental.success);
+    assert(decoded.error == incremental.error);
+    assert(decoded.stack == incremental.stack);
+    assert(decoded.metrics.nSigChecks == incremental.metrics.nSigChecks);
+    assert(decoded.metrics.nOpcodes == incremental.metrics.nOpcodes);
+    assert(decoded.metrics.nHashedBytes == incremental.metrics.nHashedBytes);
+    assert(decoded.metrics.nMaxStackSize == incremental.metrics.nMaxStackSize);
+    assert(decoded.codeseparator_pos == incremental.codeseparator_pos);
+    assert(decoded.script_codes == incremental.script_codes);
+}
@@ -0,0 +1,40 @@
+// Copyright (c) 2021 The Logos Foundation
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <script/script.h>
+#include <test/fuzz/fuzz.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// Differential check of DecodeScript, which the interpreter runs on, against
+// the incremental GetScriptOp parser.
+void test_one_input(const std::vector<uint8_t> &buffer) {
+    const CScript script(buffer.begin(), buffer.end());
+    std::vector<ScriptInstruction> instructions;
+    const bool decoded = DecodeScript(script, instructions);
+
+    CScript::const_iterator pc = script.begin();
+    opcodetype opcode;
+    std::vector<uint8_t> data;
+    size_t i = 0;
+    while (pc < script.end()) {
+        if (!script.GetOp(pc, opcode, data)) {
+            assert(!decoded);
+            assert(i == instructions.size());
+            return;
+        }
+        assert(i < instructions.size());
+        const ScriptInstruction &instruction = instructions[i++];
+        assert(instruction.opcode == opcode);
+        assert(instruction.data_size == data.size());
+        assert(std::equal(data.begin(), data.end(),
+                          script.begin() + instruction.data_offset));
+        assert(script.begin() + instruction.next_offset == pc);
+    }
+    assert(decoded);
+    assert(i == instructions.size());
+}
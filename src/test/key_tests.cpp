@@ -446,4 +446,43 @@ BOOST_AUTO_TEST_CASE(pubkey_unserialize) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(preparsed_pubkeys) {
+    CKey key1 = DecodeSecret(strSecret1);
+    CKey key1C = DecodeSecret(strSecret1C);
+    CKey key2C = DecodeSecret(strSecret2C);
+    CPubKey pubkey1 = key1.GetPubKey();
+    CPubKey pubkey1C = key1C.GetPubKey();
+    CPubKey pubkey2C = key2C.GetPubKey();
+    // Not on the curve: x = 0x0303...03 has no matching y.
+    std::vector<uint8_t> bad_bytes(CPubKey::COMPRESSED_SIZE, 0x03);
+    bad_bytes[0] = 0x02;
+    CPubKey bad(bad_bytes);
+    BOOST_CHECK(bad.IsValid());
+
+    const PreparsedPubKeys preparsed({pubkey1C, pubkey1, bad, pubkey1C});
+    BOOST_CHECK_EQUAL(preparsed.size(), 2U);
+    BOOST_CHECK(preparsed.Find(pubkey1) != nullptr);
+    BOOST_CHECK(preparsed.Find(pubkey1C) != nullptr);
+    BOOST_CHECK(preparsed.Find(pubkey2C) == nullptr);
+    BOOST_CHECK(preparsed.Find(bad) == nullptr);
+    // Both encodings of a key parse to the same point.
+    BOOST_CHECK(*preparsed.Find(pubkey1) == *preparsed.Find(pubkey1C));
+
+    const uint256 hash = InsecureRand256();
+    std::vector<uint8_t> sig1C, sig2C, schnorr1, schnorr2C;
+    BOOST_CHECK(key1C.SignECDSA(hash, sig1C));
+    BOOST_CHECK(key2C.SignECDSA(hash, sig2C));
+    BOOST_CHECK(key1.SignSchnorr(hash, schnorr1));
+    BOOST_CHECK(key2C.SignSchnorr(hash, schnorr2C));
+
+    // Keys missing from preparsed are still parsed.
+    BOOST_CHECK(pubkey1C.VerifyECDSA(hash, sig1C, &preparsed));
+    BOOST_CHECK(pubkey2C.VerifyECDSA(hash, sig2C, &preparsed));
+    BOOST_CHECK(!pubkey2C.VerifyECDSA(hash, sig1C, &preparsed));
+    BOOST_CHECK(pubkey1.VerifySchnorr(hash, schnorr1, &preparsed));
+    BOOST_CHECK(pubkey2C.VerifySchnorr(hash, schnorr2C, &preparsed));
+    BOOST_CHECK(!pubkey1C.VerifySchnorr(hash, schnorr2C, &preparsed));
+    BOOST_CHECK(!bad.VerifySchnorr(hash, schnorr1, &preparsed));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -303,6 +303,20 @@ BOOST_AUTO_TEST_CASE(MempoolClearTest) {
     BOOST_CHECK_EQUAL(testPool.mapTx.size(), 0UL);
     BOOST_CHECK_EQUAL(testPool.mapNextTx.size(), 0UL);
     BOOST_CHECK_EQUAL(testPool.vTxHashes.size(), 0UL);
+
+    // Entry sequences keep increasing across clears
+    testPool.addUnchecked(entry.FromTx(txParent));
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].prevout = COutPoint(txParent.GetId(), 0);
+    txChild.vout.resize(1);
+    testPool.addUnchecked(entry.FromTx(txChild));
+    const uint64_t parent_sequence =
+        testPool.mapTx.find(txParent.GetId())->m_entry_sequence;
+    const uint64_t child_sequence =
+        testPool.mapTx.find(txChild.GetId())->m_entry_sequence;
+    BOOST_CHECK_EQUAL(parent_sequence, 2U);
+    BOOST_CHECK_EQUAL(child_sequence, 3U);
 }
 
 template <typename name>
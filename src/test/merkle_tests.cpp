@@ -364,4 +364,35 @@ BOOST_AUTO_TEST_CASE(merkle_test_LeftSubtreeRightSubtree) {
     BOOST_CHECK_EQUAL(root, rootOfLR);
     BOOST_CHECK_EQUAL(num_layers, 2);
 }
+
+BOOST_AUTO_TEST_CASE(merkle_test_tx_leaves) {
+    for (size_t count = 0; count <= 20; count++) {
+        CMutableTransaction mtx;
+        std::vector<uint256> input_leaves, output_leaves;
+        for (size_t i = 0; i < count; i++) {
+            mtx.vin.emplace_back(
+                COutPoint(TxId(InsecureRand256()), InsecureRand32()),
+                CScript(), InsecureRand32());
+            CHashWriter leaf_hash(SER_GETHASH, 0);
+            leaf_hash << mtx.vin.back().prevout;
+            leaf_hash << mtx.vin.back().nSequence;
+            input_leaves.push_back(leaf_hash.GetHash());
+
+            // Mix runs of equal and different script lengths.
+            CScript script;
+            script << std::vector<uint8_t>(InsecureRandRange(3) * 20, 0x51);
+            mtx.vout.emplace_back(int64_t(InsecureRandBits(40)) * SATOSHI,
+                                  script);
+            output_leaves.push_back(SerializeHash(mtx.vout.back()));
+        }
+
+        size_t num_layers, expected_layers;
+        BOOST_CHECK_EQUAL(TxInputsMerkleRoot(mtx.vin, num_layers),
+                          ComputeMerkleRoot(input_leaves, expected_layers));
+        BOOST_CHECK_EQUAL(num_layers, expected_layers);
+        BOOST_CHECK_EQUAL(TxOutputsMerkleRoot(mtx.vout, num_layers),
+                          ComputeMerkleRoot(output_leaves, expected_layers));
+        BOOST_CHECK_EQUAL(num_layers, expected_layers);
+    }
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,117 @@
+// Copyright (c) 2021 The Logos Foundation
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <support/allocators/pool.h>
+
+#include <memusage.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(basic_allocating) {
+    PoolResource<8, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 1024U);
+
+    // Blocks are handed out back to back from the chunk.
+    void *block = resource.Allocate(8, 8);
+    void *next = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(static_cast<std::byte *>(next) -
+                          static_cast<std::byte *>(block),
+                      8);
+
+    // A freed block is reused by the next allocation of the same size.
+    resource.Deallocate(block, 8, 8);
+    BOOST_CHECK_EQUAL(resource.Allocate(8, 8), block);
+    resource.Deallocate(block, 8, 8);
+    resource.Deallocate(next, 8, 8);
+
+    // Fill the chunk, the next allocation needs a new one.
+    for (size_t i = 0; i < 1024 / 8; ++i) {
+        resource.Allocate(8, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(smaller_blocks_are_rounded_up) {
+    PoolResource<16, 8> resource(1024);
+
+    void *block = resource.Allocate(1, 1);
+    void *next = resource.Allocate(7, 4);
+    BOOST_CHECK_EQUAL(static_cast<std::byte *>(next) -
+                          static_cast<std::byte *>(block),
+                      8);
+
+    // Blocks of the same rounded size share a free list, other sizes don't.
+    resource.Deallocate(block, 1, 1);
+    BOOST_CHECK(resource.Allocate(16, 8) != block);
+    BOOST_CHECK_EQUAL(resource.Allocate(5, 2), block);
+    resource.Deallocate(next, 7, 4);
+}
+
+BOOST_AUTO_TEST_CASE(large_blocks_bypass_the_pool) {
+    PoolResource<8, 8> resource(1024);
+    void *first = resource.Allocate(8, 8);
+
+    // Too large or too aligned blocks come from operator new instead.
+    void *large = resource.Allocate(16, 8);
+    void *aligned = resource.Allocate(8, 16);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(aligned) % 16, 0U);
+    resource.Deallocate(large, 16, 8);
+    resource.Deallocate(aligned, 8, 16);
+
+    // They don't touch the pool's chunk.
+    void *second = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(static_cast<std::byte *>(second) -
+                          static_cast<std::byte *>(first),
+                      8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(unordered_map_with_pool) {
+    using Map = std::unordered_map<
+        uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+        PoolAllocator<std::pair<const uint64_t, uint64_t>,
+                      sizeof(std::pair<const uint64_t, uint64_t>) +
+                          sizeof(void *) * 4>>;
+    Map::allocator_type::ResourceType resource(4096);
+
+    {
+        Map map(0, std::hash<uint64_t>(), std::equal_to<uint64_t>(),
+                &resource);
+        for (uint64_t i = 0; i < 10000; ++i) {
+            map[i] = i * 3;
+        }
+        for (uint64_t i = 0; i < 10000; i += 2) {
+            map.erase(i);
+        }
+        BOOST_CHECK_EQUAL(map.size(), 5000U);
+        for (uint64_t i = 1; i < 10000; i += 2) {
+            BOOST_CHECK_EQUAL(map.at(i), i * 3);
+        }
+
+        // The pool's chunks are all accounted for.
+        BOOST_CHECK(resource.NumAllocatedChunks() > 1);
+        BOOST_CHECK(memusage::DynamicUsage(map) >=
+                    resource.NumAllocatedChunks() * resource.ChunkSizeBytes());
+
+        // Erased nodes are reused rather than growing the pool.
+        const size_t chunks = resource.NumAllocatedChunks();
+        for (uint64_t i = 0; i < 10000; i += 2) {
+            map[i] = i;
+        }
+        BOOST_CHECK_EQUAL(map.size(), 10000U);
+        BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), chunks);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
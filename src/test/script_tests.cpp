@@ -3012,6 +3012,54 @@ BOOST_AUTO_TEST_CASE(script_HasValidOps) {
     BOOST_CHECK(!script.HasValidOps());
 }
 
+BOOST_AUTO_TEST_CASE(script_DecodeScript) {
+    std::vector<ScriptInstruction> instructions;
+    CScript script =
+        ScriptFromHex("76a9141234567890abcdefa1a2a3a4a5a6a7a8a9a0aaab88ac");
+    BOOST_CHECK(DecodeScript(script, instructions));
+    BOOST_REQUIRE_EQUAL(instructions.size(), 5U);
+    BOOST_CHECK_EQUAL(instructions[0].opcode, OP_DUP);
+    BOOST_CHECK_EQUAL(instructions[1].opcode, OP_HASH160);
+    BOOST_CHECK_EQUAL(instructions[2].opcode, 20);
+    BOOST_CHECK_EQUAL(instructions[2].data_offset, 3U);
+    BOOST_CHECK_EQUAL(instructions[2].data_size, 20U);
+    BOOST_CHECK_EQUAL(instructions[2].next_offset, 23U);
+    BOOST_CHECK_EQUAL(instructions[3].opcode, OP_EQUALVERIFY);
+    BOOST_CHECK_EQUAL(instructions[4].opcode, OP_CHECKSIG);
+    BOOST_CHECK_EQUAL(instructions[4].next_offset, script.size());
+
+    // PUSHDATA encodings.
+    script = ScriptFromHex("4c01aa4d0100bb4e01000000cc");
+    BOOST_CHECK(DecodeScript(script, instructions));
+    BOOST_REQUIRE_EQUAL(instructions.size(), 3U);
+    BOOST_CHECK_EQUAL(instructions[0].data_offset, 2U);
+    BOOST_CHECK_EQUAL(instructions[1].data_offset, 6U);
+    BOOST_CHECK_EQUAL(instructions[2].data_offset, 12U);
+    for (const ScriptInstruction &instruction : instructions) {
+        BOOST_CHECK_EQUAL(instruction.data_size, 1U);
+    }
+
+    // Truncated pushes keep the instructions decoded before them.
+    BOOST_CHECK(!DecodeScript(ScriptFromHex("514c"), instructions));
+    BOOST_CHECK_EQUAL(instructions.size(), 1U);
+    BOOST_CHECK(!DecodeScript(ScriptFromHex("4d0100"), instructions));
+    BOOST_CHECK(instructions.empty());
+    BOOST_CHECK(!DecodeScript(ScriptFromHex("0501020304"), instructions));
+    BOOST_CHECK(instructions.empty());
+
+    // Instructions before a malformed one are executed first.
+    std::vector<std::vector<uint8_t>> stack;
+    ScriptError err;
+    BOOST_CHECK(!EvalScript(stack, ScriptFromHex("6a4c"), SCRIPT_VERIFY_NONE,
+                            BaseSignatureChecker(), &err));
+    BOOST_CHECK_EQUAL(err, ScriptError::OP_RETURN);
+    stack.clear();
+    BOOST_CHECK(!EvalScript(stack, ScriptFromHex("514c"), SCRIPT_VERIFY_NONE,
+                            BaseSignatureChecker(), &err));
+    BOOST_CHECK_EQUAL(err, ScriptError::BAD_OPCODE);
+    BOOST_REQUIRE_EQUAL(stack.size(), 1U);
+}
+
 #if defined(HAVE_CONSENSUS_LIB)
 
 /* Test simple (successful) usage of bitcoinconsensus_verify_script */
@@ -8,6 +8,7 @@
 
 #include <key.h>
 #include <key_io.h>
+#include <script/taproot.h>
 #include <streams.h>
 #include <tinyformat.h>
 #include <util/strencodings.h>
@@ -116,4 +117,107 @@ BOOST_AUTO_TEST_CASE(sig_pubkey_hash_variations) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(schnorr_batch) {
+    CDataStream stream(
+        ParseHex(
+            "010000000122739e70fbee987a8be1788395a2f2e6ad18ccb7ff611cd798071539"
+            "dde3c38e000000000151ffffffff010000000000000000016a00000000"),
+        SER_NETWORK, PROTOCOL_VERSION);
+    CTransaction dummyTx(deserialize, stream);
+    PrecomputedTransactionData txdata(dummyTx, {});
+    SchnorrSignatureBatch batch;
+    CachingTransactionSignatureChecker checker(&dummyTx, 0, 0 * SATOSHI, true,
+                                               txdata, &batch);
+    TestCachingTransactionSignatureChecker testChecker(checker);
+
+    CKey key = DecodeSecret(strSecret1C);
+    CPubKey pubkey = key.GetPubKey();
+
+    std::vector<std::vector<uint8_t>> sigs;
+    std::vector<uint256> hashes;
+    // Enough signatures to use batch verification, and one more to fail it.
+    for (size_t n = 0; n <= MIN_SCHNORR_BATCH_SIZE; n++) {
+        hashes.push_back(Hash(strprintf("Sigcache schnorr batch %i", n)));
+        sigs.emplace_back();
+        BOOST_CHECK(key.SignSchnorr(hashes.back(), sigs.back()));
+    }
+
+    for (bool one_fails : {true, false}) {
+        for (size_t n = 0; n < MIN_SCHNORR_BATCH_SIZE; n++) {
+            // Signatures are deferred, and only cached once verified
+            BOOST_CHECK(testChecker.VerifyAndStore(sigs[n], pubkey, hashes[n]));
+            BOOST_CHECK(!testChecker.IsCached(sigs[n], pubkey, hashes[n]));
+        }
+        if (one_fails) {
+            // Deferred even if invalid
+            BOOST_CHECK(testChecker.VerifyAndStore(
+                sigs[MIN_SCHNORR_BATCH_SIZE], pubkey, hashes[0]));
+        }
+        BOOST_CHECK_EQUAL(batch.size(),
+                          MIN_SCHNORR_BATCH_SIZE + size_t(one_fails));
+        BOOST_CHECK(batch.Verify() != one_fails);
+        batch.Clear();
+        BOOST_CHECK(batch.empty());
+    }
+
+    // Verified signatures were cached, so they are no longer deferred.
+    for (size_t n = 0; n < MIN_SCHNORR_BATCH_SIZE; n++) {
+        BOOST_CHECK(testChecker.IsCached(sigs[n], pubkey, hashes[n]));
+        BOOST_CHECK(testChecker.VerifyAndStore(sigs[n], pubkey, hashes[n]));
+    }
+    BOOST_CHECK(batch.empty());
+
+    // A small batch is verified one signature at a time.
+    BOOST_CHECK(testChecker.VerifyAndStore(sigs[MIN_SCHNORR_BATCH_SIZE], pubkey,
+                                           hashes[MIN_SCHNORR_BATCH_SIZE]));
+    BOOST_CHECK(batch.Verify());
+    batch.Clear();
+    BOOST_CHECK(testChecker.VerifyAndStore(sigs[MIN_SCHNORR_BATCH_SIZE], pubkey,
+                                           hashes[0]));
+    BOOST_CHECK(!batch.Verify());
+}
+
+BOOST_AUTO_TEST_CASE(taproot_commitment_cache) {
+    CDataStream stream(
+        ParseHex(
+            "010000000122739e70fbee987a8be1788395a2f2e6ad18ccb7ff611cd798071539"
+            "dde3c38e000000000151ffffffff010000000000000000016a00000000"),
+        SER_NETWORK, PROTOCOL_VERSION);
+    CTransaction dummyTx(deserialize, stream);
+    PrecomputedTransactionData txdata(dummyTx, {});
+    // Block validation doesn't store signatures, but still shares proofs.
+    CachingTransactionSignatureChecker checker(&dummyTx, 0, 0 * SATOSHI,
+                                               false, txdata);
+
+    // Tree of two scripts, see taproot_tests/verify_taproot_commitment_2
+    const CScript script = CScript() << 2 << 3 << OP_ADD << 5 << OP_EQUAL;
+    const std::vector<uint8_t> commitment = ParseHex(
+        "02b908223769e60046dee140a788fa96977012033adcfa8e328fa8c98fa3a3feba");
+    const std::vector<uint8_t> control_block = ParseHex(
+        "fef9308a019258c31049344f85f89d5229b531c845836f99b08601f113bce036f9e82b"
+        "65cb9d7df2c20ffc76492b0c1f11bfeafc4df63344446d3b07d3327ffce9");
+    const uint256 tapleaf_hash =
+        ComputeTapleafHash(control_block[0] & TAPROOT_LEAF_MASK, script);
+    std::vector<uint8_t> bad_control_block = control_block;
+    bad_control_block.back() ^= 1;
+
+    InitTaprootCommitmentCache();
+    BOOST_CHECK(checker.VerifyTaprootControlBlock(tapleaf_hash, control_block,
+                                                  commitment));
+    BOOST_CHECK(checker.VerifyTaprootControlBlock(tapleaf_hash, control_block,
+                                                  commitment));
+    // Failed proofs are never cached.
+    for (int i = 0; i < 2; i++) {
+        BOOST_CHECK(!checker.VerifyTaprootControlBlock(
+            tapleaf_hash, bad_control_block, commitment));
+    }
+
+    const ScriptCacheStats stats = GetTaprootCommitmentCacheStats();
+    BOOST_CHECK_GT(stats.capacity, 0U);
+    BOOST_CHECK_EQUAL(stats.hits, 1U);
+    BOOST_CHECK_EQUAL(stats.misses, 3U);
+    BOOST_CHECK_EQUAL(stats.inserts, 1U);
+    BOOST_CHECK_EQUAL(stats.evictions, 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -315,4 +315,42 @@ BOOST_AUTO_TEST_CASE(test_verifyscript) {
                        SCRIPT_ENABLE_SIGHASH_FORKID, 1);
 }
 
+BOOST_AUTO_TEST_CASE(test_verifyscript_profile) {
+    const CScript scriptSig = CScript() << msg << OP_1 << OP_1;
+    const CScript scriptPubKey = CScript() << OP_DROP << OP_TOALTSTACK
+                                           << OP_SHA256 << OP_DROP
+                                           << OP_FROMALTSTACK;
+    ScriptError err;
+
+    // Profiling is off by default.
+    ScriptExecutionMetrics metrics;
+    BOOST_CHECK(VerifyScript(scriptSig, scriptPubKey, SCRIPT_VERIFY_NONE,
+                             dummysigchecker, metrics, &err));
+    BOOST_CHECK_EQUAL(metrics.nOpcodes, 0U);
+    BOOST_CHECK_EQUAL(metrics.nHashedBytes, 0U);
+    BOOST_CHECK_EQUAL(metrics.nMaxStackSize, 0U);
+
+    metrics = {};
+    metrics.fProfile = true;
+    BOOST_CHECK(VerifyScript(scriptSig, scriptPubKey, SCRIPT_VERIFY_NONE,
+                             dummysigchecker, metrics, &err));
+    BOOST_CHECK(metrics.fProfile);
+    BOOST_CHECK_EQUAL(metrics.nOpcodes, 8U);
+    BOOST_CHECK_EQUAL(metrics.nHashedBytes, msg.size());
+    BOOST_CHECK_EQUAL(metrics.nMaxStackSize, 3U);
+    BOOST_CHECK_GE(metrics.nTimeMicros, 0);
+
+    // The profile is also reported for failing scripts.
+    metrics = {};
+    metrics.fProfile = true;
+    BOOST_CHECK(!VerifyScript(CScript() << msg,
+                              CScript() << OP_SHA256 << OP_0 << OP_EQUALVERIFY,
+                              SCRIPT_VERIFY_NONE, dummysigchecker, metrics,
+                              &err));
+    BOOST_CHECK_EQUAL(err, ScriptError::EQUALVERIFY);
+    BOOST_CHECK_EQUAL(metrics.nOpcodes, 4U);
+    BOOST_CHECK_EQUAL(metrics.nHashedBytes, msg.size());
+    BOOST_CHECK_EQUAL(metrics.nMaxStackSize, 2U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -16,6 +16,7 @@
 #include <policy/settings.h>
 #include <script/script.h>
 #include <script/script_error.h>
+#include <script/sigcache.h>
 #include <script/sign.h>
 #include <script/signingprovider.h>
 #include <script/standard.h>
@@ -476,6 +477,22 @@ BOOST_AUTO_TEST_CASE(test_big_transaction) {
     bool controlCheck = control.Wait();
     BOOST_CHECK(controlCheck);
 
+    // Same again, letting the script check threads build the txdata.
+    DeferredTxData deferred_txdata;
+    deferred_txdata.Init(tx, std::vector<CTxOut>(txdata.m_spent_outputs));
+    for (size_t i = 0; i < mtx.vin.size(); i++) {
+        std::vector<CScriptCheck> vChecks;
+        CScriptCheck check(coins[tx.vin[i].prevout.GetN()].GetTxOut(), tx, i,
+                           STANDARD_SCRIPT_VERIFY_FLAGS, false,
+                           deferred_txdata);
+        vChecks.push_back(CScriptCheck());
+        check.swap(vChecks.back());
+        control.Add(vChecks);
+    }
+    BOOST_CHECK(control.Wait());
+    BOOST_CHECK(deferred_txdata.Get().m_inputs_spent_outputs_merkle_root ==
+                txdata.m_inputs_spent_outputs_merkle_root);
+
     threadGroup.interrupt_all();
     threadGroup.join_all();
 }
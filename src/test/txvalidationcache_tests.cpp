@@ -3,15 +3,18 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chain.h>
+#include <chainparams.h>
 #include <config.h>
 #include <consensus/validation.h>
 #include <key.h>
+#include <miner.h>
 #include <policy/policy.h>
 #include <script/scriptcache.h>
 #include <script/sighashtype.h>
 #include <script/sign.h>
 #include <script/signingprovider.h>
 #include <txmempool.h>
+#include <undo.h>
 #include <validation.h>
 
 #include <test/lcg.h>
@@ -20,6 +23,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+#include <thread>
+
 BOOST_AUTO_TEST_SUITE(txvalidationcache_tests)
 
 BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup) {
@@ -103,6 +109,144 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup) {
     BOOST_CHECK_EQUAL(m_node.mempool->size(), 0U);
 }
 
+BOOST_FIXTURE_TEST_CASE(connect_block_threads, TestChain100Setup) {
+    // Check the transactions of large blocks ahead of spending them, and make
+    // sure double spends within the block are still caught.
+    const int old_connect_block_threads = g_connect_block_threads;
+    g_connect_block_threads = 4;
+
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+    // Sign for the fork id the next blocks use, which depends on the upgrades
+    // activated by then.
+    const uint32_t flags = WITH_LOCK(
+        cs_main, return GetNextBlockScriptFlags(
+                     GetConfig().GetChainParams().GetConsensus(),
+                     ::ChainActive().Tip()));
+    const auto Sign = [&](CMutableTransaction &tx, const Amount amount) {
+        std::vector<uint8_t> vchSig;
+        uint256 hash;
+        BOOST_CHECK(SignatureHash(
+            hash, std::optional(ScriptExecutionData(scriptPubKey)),
+            scriptPubKey, CTransaction(tx), 0, SigHashType().withForkId(),
+            amount, nullptr, flags));
+        BOOST_CHECK(coinbaseKey.SignECDSA(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        tx.vin[0].scriptSig << vchSig;
+    };
+
+    // Split a mature coinbase output into enough outputs for a large block.
+    constexpr size_t NUM_SPENDS = 100;
+    CMutableTransaction fund;
+    fund.nVersion = 1;
+    fund.vin.resize(1);
+    fund.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetId(), 1);
+    const Amount value = m_coinbase_txns[0]->vout[1].nValue / 200;
+    fund.vout.assign(NUM_SPENDS, CTxOut(value, scriptPubKey));
+    Sign(fund, m_coinbase_txns[0]->vout[1].nValue);
+    CreateAndProcessBlock({fund}, scriptPubKey);
+
+    std::vector<CMutableTransaction> spends(NUM_SPENDS);
+    for (size_t i = 0; i < NUM_SPENDS; i++) {
+        spends[i].nVersion = 1;
+        spends[i].vin.resize(1);
+        spends[i].vin[0].prevout = COutPoint(fund.GetId(), i);
+        spends[i].vout.assign(1, CTxOut(value / 2, scriptPubKey));
+        Sign(spends[i], value);
+    }
+
+    // A second spend of any output invalidates the block.
+    CMutableTransaction doubleSpend = spends[42];
+    doubleSpend.vout[0].nValue = value / 3;
+    doubleSpend.vin[0].scriptSig = CScript();
+    Sign(doubleSpend, value);
+    std::vector<CMutableTransaction> txs = spends;
+    txs.push_back(doubleSpend);
+    CBlock block = CreateAndProcessBlock(txs, scriptPubKey);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() != block.GetHash());
+    }
+
+    // Checking the transactions ahead or one by one accounts for the same
+    // fees: a coinbase claiming the reward they allow is valid either way, one
+    // claiming a satoshi more is not.
+    const Config &config = GetConfig();
+    CTxMemPool empty_pool;
+    CBlock feeBlock =
+        BlockAssembler(config, empty_pool).CreateNewBlock(scriptPubKey)->block;
+    for (const CMutableTransaction &tx : spends) {
+        feeBlock.vtx.push_back(MakeTransactionRef(tx));
+    }
+    std::sort(feeBlock.vtx.begin() + 1, feeBlock.vtx.end(),
+              [](const CTransactionRef &txa, const CTransactionRef &txb) {
+                  return txa->GetId() < txb->GetId();
+              });
+    const Amount fees = int64_t(NUM_SPENDS) * (value - value / 2);
+    const Consensus::Params &params = config.GetChainParams().GetConsensus();
+    const Amount reward = GetBlockSubsidy(feeBlock.nBits, params) + fees / 2;
+    const auto TestCoinbaseValue = [&](const Amount coinbaseValue) {
+        CMutableTransaction coinbase(*feeBlock.vtx[0]);
+        coinbase.vout[0].nValue +=
+            coinbaseValue - feeBlock.vtx[0]->GetValueOut();
+        CBlock testBlock = feeBlock;
+        testBlock.vtx[0] = MakeTransactionRef(coinbase);
+        testBlock.SetSize(::GetSerializeSize(testBlock));
+
+        LOCK(cs_main);
+        BlockValidationState state;
+        const bool valid = TestBlockValidity(
+            state, config.GetChainParams(), testBlock, ::ChainActive().Tip(),
+            BlockValidationOptions(config)
+                .withCheckPoW(false)
+                .withCheckMerkleRoot(false)
+                .withMinerFund(false));
+        BOOST_CHECK(valid || state.GetRejectReason() == "bad-cb-amount");
+        return valid;
+    };
+    for (const int threads : {0, 4}) {
+        g_connect_block_threads = threads;
+        BOOST_CHECK(TestCoinbaseValue(reward));
+        BOOST_CHECK(!TestCoinbaseValue(reward + SATOSHI));
+    }
+
+    const auto ReadUndo = [](const CBlock &connected) {
+        LOCK(cs_main);
+        const CBlockIndex *pindex = ::ChainActive().Tip();
+        BOOST_CHECK(pindex->GetBlockHash() == connected.GetHash());
+        CBlockUndo blockundo;
+        BOOST_CHECK(UndoReadFromDisk(blockundo, pindex));
+        CDataStream stream(SER_DISK, CLIENT_VERSION);
+        stream << blockundo;
+        return stream.str();
+    };
+
+    // Both ways also record the same undo data.
+    g_connect_block_threads = 4;
+    block = CreateAndProcessBlock(spends, scriptPubKey);
+    const std::string undo = ReadUndo(block);
+    {
+        LOCK(cs_main);
+        BlockValidationState state;
+        BOOST_CHECK(::ChainstateActive().InvalidateBlock(
+            config, state, ::ChainActive().Tip()));
+    }
+    g_connect_block_threads = 0;
+    block = CreateAndProcessBlock(spends, CScript() << OP_TRUE);
+    BOOST_CHECK(ReadUndo(block) == undo);
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < NUM_SPENDS; i++) {
+            BOOST_CHECK(!::ChainstateActive().CoinsTip().HaveCoin(
+                COutPoint(fund.GetId(), i)));
+            BOOST_CHECK(::ChainstateActive().CoinsTip().HaveCoin(
+                COutPoint(spends[i].GetId(), 0)));
+        }
+    }
+
+    g_connect_block_threads = old_connect_block_threads;
+}
+
 static inline bool
 CheckInputScripts(const CTransaction &tx, TxValidationState &state,
                   const CCoinsViewCache &view, const uint32_t flags,
@@ -620,8 +764,8 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, TestChain100Setup) {
 }
 
 BOOST_AUTO_TEST_CASE(scriptcache_values) {
-    LOCK(cs_main);
-    // Test insertion and querying of keys&values from the script cache.
+    // Test insertion and querying of keys&values from the script cache. This
+    // doesn't require cs_main.
 
     // Define a couple of macros (handier than functions since errors will print
     // out the correct line number)
@@ -700,6 +844,54 @@ BOOST_AUTO_TEST_CASE(scriptcache_values) {
     // It would also be acceptable to overwrite, but if we ever come to a
     // situation where this matters then neither alternative is better.
     CHECK_CACHE_HAS(key1A, 42);
+
+    const ScriptCacheStats stats = GetScriptCacheStats();
+    BOOST_CHECK(stats.capacity > 0);
+    BOOST_CHECK_EQUAL(stats.hits, 5U);
+    BOOST_CHECK_EQUAL(stats.misses, 5U);
+    BOOST_CHECK_EQUAL(stats.inserts, 4U);
+    BOOST_CHECK_EQUAL(stats.evictions, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(scriptcache_concurrent) {
+    InitScriptExecutionCache();
+
+    // Threads insert and look up their own keys while the others do the same.
+    constexpr int NUM_THREADS = 4;
+    constexpr int KEYS_PER_THREAD = 200;
+    std::vector<std::vector<ScriptCacheKey>> keys(NUM_THREADS);
+    for (int t = 0; t < NUM_THREADS; t++) {
+        for (int i = 0; i < KEYS_PER_THREAD; i++) {
+            CMutableTransaction tx;
+            tx.nVersion = t;
+            tx.nLockTime = i;
+            keys[t].emplace_back(CTransaction(tx), 0);
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::atomic<int> num_found{0};
+    for (int t = 0; t < NUM_THREADS; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < KEYS_PER_THREAD; i++) {
+                AddKeyInScriptCache(keys[t][i], i);
+                int nSigChecks;
+                if (IsKeyInScriptCache(keys[t][i], false, nSigChecks) &&
+                    nSigChecks == i) {
+                    num_found++;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    const uint64_t num_keys = NUM_THREADS * KEYS_PER_THREAD;
+    BOOST_CHECK_EQUAL(num_found.load(), num_keys);
+    const ScriptCacheStats stats = GetScriptCacheStats();
+    BOOST_CHECK_EQUAL(stats.hits, num_keys);
+    BOOST_CHECK_EQUAL(stats.inserts, num_keys);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 #include <consensus/validation.h>
 #include <consensus/merkle.h>
 #include <crypto/sha256.h>
+#include <crypto/sha3.h>
 #include <init.h>
 #include <interfaces/chain.h>
 #include <logging.h>
@@ -29,6 +30,7 @@
 #include <streams.h>
 #include <txdb.h>
 #include <txmempool.h>
+#include <util/parallel.h>
 #include <util/strencodings.h>
 #include <util/time.h>
 #include <util/translation.h>
@@ -130,11 +132,16 @@ BasicTestingSetup::BasicTestingSetup(
     AppInitParameterInteraction(config, *m_node.args);
     LogInstance().StartLogging();
     SHA256AutoDetect();
+    SHA3AutoDetect();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitTaprootCommitmentCache();
+    // Enough for the tests to run parallel loops on 4 threads.
+    constexpr int parallel_workers = 3;
+    StartParallelWorkers(parallel_workers);
 
     m_node.chain = interfaces::MakeChain(m_node, config.GetChainParams());
     g_wallet_init_interface.Construct(m_node);
@@ -148,6 +155,7 @@ BasicTestingSetup::BasicTestingSetup(
 }
 
 BasicTestingSetup::~BasicTestingSetup() {
+    StopParallelWorkers();
     LogInstance().DisconnectTestLogger();
     fs::remove_all(m_path_root);
     gArgs.ClearArgs();
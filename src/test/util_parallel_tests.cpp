@@ -0,0 +1,97 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <util/parallel.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(util_parallel_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(parallel_for) {
+    BOOST_CHECK_GT(GetParallelWorkers(), 0);
+    for (const size_t num_threads : {1, 2, 4, 16}) {
+        std::vector<std::atomic<int>> calls(1000);
+        ParallelFor(calls.size(), num_threads, 10,
+                    [&](size_t i) { ++calls[i]; });
+        for (const std::atomic<int> &count : calls) {
+            BOOST_CHECK_EQUAL(count.load(), 1);
+        }
+    }
+
+    // Too little work to share runs on the calling thread.
+    const std::thread::id caller = std::this_thread::get_id();
+    ParallelFor(15, 4, 10, [&](size_t) {
+        BOOST_CHECK(std::this_thread::get_id() == caller);
+    });
+
+    // Loops can nest.
+    std::atomic<size_t> inner_calls{0};
+    ParallelFor(8, 4, 1, [&](size_t) {
+        ParallelFor(8, 4, 1, [&](size_t) { ++inner_calls; });
+    });
+    BOOST_CHECK_EQUAL(inner_calls.load(), 64);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_for_while) {
+    // No index past the one stopping the loop is handed out, but the calls in
+    // progress complete.
+    std::vector<std::atomic<int>> calls(1000);
+    ParallelForWhile(calls.size(), 4, 1, [&](size_t i) {
+        ++calls[i];
+        return i != 500;
+    });
+    for (size_t i = 0; i <= 500; ++i) {
+        BOOST_CHECK_EQUAL(calls[i].load(), 1);
+    }
+    size_t calls_past_stop = 0;
+    for (size_t i = 501; i < calls.size(); ++i) {
+        calls_past_stop += calls[i];
+    }
+    BOOST_CHECK_LT(calls_past_stop, 4);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_for_exceptions) {
+    // Exceptions of any type reach the caller.
+    BOOST_CHECK_THROW(ParallelFor(1000, 4, 1,
+                                  [](size_t i) {
+                                      if (i == 700) {
+                                          throw std::runtime_error("oops");
+                                      }
+                                  }),
+                      std::runtime_error);
+    BOOST_CHECK_THROW(ParallelFor(1000, 4, 1,
+                                  [](size_t i) {
+                                      if (i % 100 == 99) {
+                                          throw 42;
+                                      }
+                                  }),
+                      int);
+
+    // The workers are still there afterwards.
+    std::atomic<size_t> calls{0};
+    ParallelFor(1000, 4, 1, [&](size_t) { ++calls; });
+    BOOST_CHECK_EQUAL(calls.load(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_for_without_workers) {
+    StopParallelWorkers();
+    BOOST_CHECK_EQUAL(GetParallelWorkers(), 0);
+    const std::thread::id caller = std::this_thread::get_id();
+    size_t calls = 0;
+    ParallelFor(1000, 4, 1, [&](size_t) {
+        BOOST_CHECK(std::this_thread::get_id() == caller);
+        ++calls;
+    });
+    BOOST_CHECK_EQUAL(calls, 1000);
+    StartParallelWorkers(2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
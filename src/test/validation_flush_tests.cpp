@@ -2,10 +2,14 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 //
+#include <chainparams.h>
+#include <consensus/validation.h>
 #include <sync.h>
 #include <test/util/setup_common.h>
 #include <txmempool.h>
+#include <util/time.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -55,13 +59,14 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate) {
             "CCoinsViewCache memory usage: " << _view.DynamicMemoryUsage());
     };
 
-    constexpr size_t MAX_COINS_CACHE_BYTES = 1024;
+    // The cache starts with the first 256 KiB chunk of its memory pool.
+    constexpr size_t MAX_COINS_CACHE_BYTES = 256 * 1024 + 512;
 
     // Without any coins in the cache, we shouldn't need to flush.
-    BOOST_CHECK_EQUAL(
+    BOOST_CHECK(
         chainstate.GetCoinsCacheSizeState(&tx_pool, MAX_COINS_CACHE_BYTES,
-                                          /*max_mempool_size_bytes*/ 0),
-        CoinsCacheSizeState::OK);
+                                          /*max_mempool_size_bytes*/ 0) !=
+        CoinsCacheSizeState::CRITICAL);
 
     // If the initial memory allocations of cacheCoins don't match these common
     // cases, we can't really continue to make assertions about memory usage.
@@ -176,4 +181,50 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate) {
         CoinsCacheSizeState::CRITICAL);
 }
 
+struct FlushListener final : public CValidationInterface {
+    std::vector<CBlockLocator> flushed;
+
+    void ChainStateFlushed(const CBlockLocator &locator) override {
+        flushed.push_back(locator);
+    }
+};
+
+//! ChainStateFlushed is only signalled once the coins written in the
+//! background are on disk.
+BOOST_FIXTURE_TEST_CASE(background_flush_signal, TestChain100Setup) {
+    CChainState &chainstate = ::ChainstateActive();
+    BlockValidationState state;
+    FlushListener listener;
+    RegisterValidationInterface(&listener);
+
+    // Flushes which must be durable are signalled right away.
+    BOOST_CHECK(chainstate.FlushStateToDisk(Params(), state,
+                                            FlushStateMode::ALWAYS));
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(listener.flushed.size(), 1);
+
+    // Periodic flushes write the coins in the background.
+    SetMockTime(GetTime() + 2 * 24 * 60 * 60);
+    BOOST_CHECK(chainstate.FlushStateToDisk(Params(), state,
+                                            FlushStateMode::PERIODIC));
+    BOOST_CHECK(WITH_LOCK(cs_main, return chainstate.CoinsDB()
+                                              .IsWritingInBackground()));
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(listener.flushed.size(), 1);
+
+    // The next flush finds the write completed.
+    BOOST_CHECK(WITH_LOCK(cs_main, return chainstate.CoinsDB()
+                                              .FinishBackgroundWrite()));
+    BOOST_CHECK(
+        chainstate.FlushStateToDisk(Params(), state, FlushStateMode::NONE));
+    SyncWithValidationInterfaceQueue();
+    BOOST_REQUIRE_EQUAL(listener.flushed.size(), 2);
+    BOOST_CHECK(listener.flushed[1].vHave ==
+                WITH_LOCK(cs_main, return chainstate.m_chain.GetLocator())
+                    .vHave);
+
+    UnregisterValidationInterface(&listener);
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,15 +7,20 @@
 
 #include <blockdb.h>
 #include <chain.h>
+#include <hash.h>
 #include <node/ui_interface.h>
 #include <pow/pow.h>
 #include <random.h>
 #include <shutdown.h>
+#include <streams.h>
+#include <util/parallel.h>
 #include <util/system.h>
+#include <util/threadnames.h>
 #include <util/translation.h>
 #include <util/vector.h>
 #include <version.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 
@@ -29,6 +34,10 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_BLOCK_INDEX_SNAPSHOT = 'S';
+
+//! Below this many coins per thread, sharing the lookups isn't worth it
+static constexpr size_t MIN_COINS_PER_THREAD = 16;
 
 namespace {
 
@@ -53,7 +62,12 @@ CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory,
                                         true)),
       m_ldb_path(ldb_path), m_is_memory(fMemory) {}
 
+CCoinsViewDB::~CCoinsViewDB() {
+    FinishBackgroundWrite();
+}
+
 void CCoinsViewDB::ResizeCache(size_t new_cache_size) {
+    FinishBackgroundWrite();
     // Have to do a reset first to get the original `m_db` state to release its
     // filesystem lock.
     m_db.reset();
@@ -62,14 +76,52 @@ void CCoinsViewDB::ResizeCache(size_t new_cache_size) {
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    if (m_generation) {
+        CCoinsMap::const_iterator it = m_generation->coins.find(outpoint);
+        if (it != m_generation->coins.end()) {
+            if (it->second.coin.IsSpent()) {
+                return false;
+            }
+            coin = it->second.coin;
+            return true;
+        }
+    }
     return m_db->Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    if (m_generation) {
+        CCoinsMap::const_iterator it = m_generation->coins.find(outpoint);
+        if (it != m_generation->coins.end()) {
+            return !it->second.coin.IsSpent();
+        }
+    }
     return m_db->Exists(CoinEntry(&outpoint));
 }
 
+void CCoinsViewDB::GetCoins(const std::vector<COutPoint> &outpoints,
+                            std::vector<Coin> &coins,
+                            size_t num_threads) const {
+    coins.assign(outpoints.size(), Coin());
+    ParallelFor(outpoints.size(), num_threads, MIN_COINS_PER_THREAD,
+                [&](size_t i) {
+                    try {
+                        GetCoin(outpoints[i], coins[i]);
+                    } catch (const std::runtime_error &) {
+                        // The caller runs into the error again and handles it.
+                        coins[i].Clear();
+                    }
+                });
+}
+
 BlockHash CCoinsViewDB::GetBestBlock() const {
+    if (m_generation) {
+        return m_generation->hashBlock;
+    }
+    return ReadBestBlock();
+}
+
+BlockHash CCoinsViewDB::ReadBestBlock() const {
     BlockHash hashBestChain;
     if (!m_db->Read(DB_BEST_BLOCK, hashBestChain)) {
         return BlockHash();
@@ -86,6 +138,48 @@ std::vector<BlockHash> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) {
+    // Writes must land in order.
+    bool ok = FinishBackgroundWrite();
+    ok &= WriteCoins(mapCoins, hashBlock);
+    mapCoins.clear();
+    return ok;
+}
+
+bool CCoinsViewDB::WriteInBackground(
+    std::unique_ptr<CCoinsMapGeneration> generation) {
+    const bool ok = FinishBackgroundWrite();
+    m_generation = std::move(generation);
+    m_write_done = false;
+    m_write_thread = std::thread([this] {
+        util::ThreadRename("coinswrite");
+        try {
+            m_write_ok =
+                WriteCoins(m_generation->coins, m_generation->hashBlock);
+        } catch (const std::runtime_error &e) {
+            LogPrintf("Error writing coins in the background: %s\n",
+                      e.what());
+            m_write_ok = false;
+        }
+        m_write_done = true;
+    });
+    return ok;
+}
+
+bool CCoinsViewDB::FinishBackgroundWrite(bool wait) {
+    if (!m_generation || (!wait && !m_write_done)) {
+        return true;
+    }
+    m_write_thread.join();
+    m_generation.reset();
+    return std::exchange(m_write_ok, true);
+}
+
+size_t CCoinsViewDB::BackgroundWriteMemoryUsage() const {
+    return m_generation ? m_generation->DynamicMemoryUsage() : 0;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins,
+                              const BlockHash &hashBlock) {
     CDBBatch batch(*m_db);
     size_t count = 0;
     size_t changed = 0;
@@ -94,7 +188,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) {
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
-    BlockHash old_tip = GetBestBlock();
+    BlockHash old_tip = ReadBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
         std::vector<BlockHash> old_heads = GetHeadBlocks();
@@ -111,7 +205,8 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, Vector(hashBlock, old_tip));
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin();
+         it != mapCoins.end(); ++it) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent()) {
@@ -122,8 +217,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n",
                      batch.SizeEstimate() * (1.0 / 1048576.0));
@@ -159,7 +252,9 @@ size_t CCoinsViewDB::EstimateSize() const {
 
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe)
     : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory,
-                 fWipe) {}
+                 fWipe),
+      m_snapshot_path(fMemory ? fs::path()
+                              : GetDataDir() / "blocks" / "index.snapshot") {}
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
     return Read(std::make_pair(DB_BLOCK_FILES, nFile), info);
@@ -182,8 +277,10 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 }
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const {
+    // The coins of a background write are not in the database yet, describe
+    // what it actually holds.
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(
-        const_cast<CDBWrapper &>(*m_db).NewIterator(), GetBestBlock());
+        const_cast<CDBWrapper &>(*m_db).NewIterator(), ReadBestBlock());
     /**
      * It seems that there are no "const iterators" for LevelDB. Since we only
      * need read operations on it, use a const-cast to get around that
@@ -237,7 +334,8 @@ void CCoinsViewDBCursor::Next() {
 
 bool CBlockTreeDB::WriteBatchSync(
     const std::vector<std::pair<int, const CBlockFileInfo *>> &fileInfo,
-    int nLastFile, const std::vector<const CBlockIndex *> &blockinfo) {
+    int nLastFile, const std::vector<const CBlockIndex *> &blockinfo,
+    const uint256 &snapshot_id) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<int, const CBlockFileInfo *>>::const_iterator
              it = fileInfo.begin();
@@ -251,9 +349,155 @@ bool CBlockTreeDB::WriteBatchSync(
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()),
                     CDiskBlockIndex(*it));
     }
+    // Any write to the block index makes an older snapshot stale.
+    if (snapshot_id.IsNull()) {
+        batch.Erase(DB_BLOCK_INDEX_SNAPSHOT);
+    } else {
+        batch.Write(DB_BLOCK_INDEX_SNAPSHOT, snapshot_id);
+    }
     return WriteBatch(batch, true);
 }
 
+bool CBlockTreeDB::WriteBlockIndexSnapshot(
+    const std::vector<const CBlockIndex *> &blockinfo, uint256 &snapshot_id) {
+    if (m_snapshot_path.empty()) {
+        return false;
+    }
+    const uint256 id = GetRandHash();
+
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << int(CLIENT_VERSION) << id << uint64_t(blockinfo.size());
+    for (const CBlockIndex *pindex : blockinfo) {
+        stream << pindex->GetBlockHash() << CDiskBlockIndex(pindex);
+    }
+    stream << Hash(stream);
+
+    fs::path path_tmp = m_snapshot_path;
+    path_tmp += ".new";
+    CAutoFile file(fsbridge::fopen(path_tmp, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        return error("%s: Failed to open file %s", __func__,
+                     fs::PathToString(path_tmp));
+    }
+    try {
+        file.write(stream.data(), stream.size());
+    } catch (const std::exception &e) {
+        file.fclose();
+        fs::remove(path_tmp);
+        return error("%s: I/O error - %s", __func__, e.what());
+    }
+    if (!FileCommit(file.Get())) {
+        file.fclose();
+        fs::remove(path_tmp);
+        return error("%s: Failed to flush file %s", __func__,
+                     fs::PathToString(path_tmp));
+    }
+    file.fclose();
+    if (!RenameOver(path_tmp, m_snapshot_path)) {
+        fs::remove(path_tmp);
+        return error("%s: Rename-into-place failed", __func__);
+    }
+    snapshot_id = id;
+    return true;
+}
+
+bool CBlockTreeDB::LoadBlockIndexSnapshot(
+    const Consensus::Params &params,
+    const std::function<CBlockIndex *(const BlockHash &)> &insertBlockIndex) {
+    uint256 snapshot_id;
+    if (m_snapshot_path.empty() ||
+        !Read(DB_BLOCK_INDEX_SNAPSHOT, snapshot_id)) {
+        return false;
+    }
+
+    // Read the whole snapshot at once, straight from the page cache if
+    // possible.
+    size_t size = 0;
+    try {
+        size = fs::file_size(m_snapshot_path);
+    } catch (const fs::filesystem_error &) {
+        return false;
+    }
+    FlatFileData data;
+    if (std::shared_ptr<const FlatFileMapping> mapping =
+            MapFlatFile(m_snapshot_path, size)) {
+        data = FlatFileData(mapping, mapping->data());
+    } else {
+        CAutoFile file(fsbridge::fopen(m_snapshot_path, "rb"), SER_DISK,
+                       CLIENT_VERSION);
+        std::vector<uint8_t> bytes(size);
+        try {
+            file.read((char *)bytes.data(), bytes.size());
+        } catch (const std::exception &e) {
+            return false;
+        }
+        data = FlatFileData(std::move(bytes));
+    }
+
+    // Validate the whole snapshot before touching the block index, so that
+    // the database can still be used if it doesn't check out.
+    if (data.bytes().size() < sizeof(uint256)) {
+        return false;
+    }
+    const Span<const uint8_t> bytes =
+        data.bytes().first(data.bytes().size() - sizeof(uint256));
+    uint256 checksum;
+    VectorReader(SER_DISK, CLIENT_VERSION, data.bytes(), bytes.size(),
+                 checksum);
+    if (Hash(bytes) != checksum) {
+        LogPrintf("%s: Checksum mismatch, ignoring the snapshot\n", __func__);
+        return false;
+    }
+    VectorReader reader(SER_DISK, CLIENT_VERSION, bytes, 0);
+    int version = 0;
+    uint256 file_snapshot_id;
+    uint64_t count = 0;
+    try {
+        reader >> version >> file_snapshot_id >> count;
+    } catch (const std::exception &e) {
+        return false;
+    }
+    if (version != CLIENT_VERSION || file_snapshot_id != snapshot_id) {
+        LogPrintf("%s: The snapshot is stale, ignoring it\n", __func__);
+        return false;
+    }
+
+    try {
+        for (uint64_t i = 0; i < count; ++i) {
+            BlockHash hash;
+            CDiskBlockIndex diskindex;
+            reader >> hash >> diskindex;
+
+            // The hash is covered by the checksum, no need to recompute it.
+            CBlockIndex *pindexNew = insertBlockIndex(hash);
+            pindexNew->pprev = insertBlockIndex(diskindex.hashPrev);
+            pindexNew->nFile = diskindex.nFile;
+            pindexNew->nDataPos = diskindex.nDataPos;
+            pindexNew->nUndoPos = diskindex.nUndoPos;
+            pindexNew->nBits = diskindex.nBits;
+            pindexNew->nTime = diskindex.nTime;
+            pindexNew->nReserved = diskindex.nReserved;
+            pindexNew->nNonce = diskindex.nNonce;
+            pindexNew->nHeaderVersion = diskindex.nHeaderVersion;
+            pindexNew->nSize = diskindex.nSize;
+            pindexNew->nHeight = diskindex.nHeight;
+            pindexNew->hashEpochBlock = diskindex.hashEpochBlock;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->hashExtendedMetadata = diskindex.hashExtendedMetadata;
+            pindexNew->nStatus = diskindex.nStatus;
+            pindexNew->nTx = diskindex.nTx;
+
+            if (!CheckProofOfWork(hash, pindexNew->nBits, params)) {
+                return error("%s: CheckProofOfWork failed: %s", __func__,
+                             pindexNew->ToString());
+            }
+        }
+    } catch (const std::exception &e) {
+        return error("%s: Deserialize error - %s", __func__, e.what());
+    }
+    return reader.empty();
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -283,6 +527,14 @@ bool CBlockTreeDB::LoadBlockIndexGuts(
                      version);
     }
 
+    // Entries loaded from a snapshot which turns out to be unusable are all in
+    // the database too, and get overwritten by the scan below.
+    if (LoadBlockIndexSnapshot(params, insertBlockIndex)) {
+        LogPrintf("Loaded the block index from %s\n",
+                  fs::PathToString(m_snapshot_path));
+        return true;
+    }
+
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
     // Load m_block_index
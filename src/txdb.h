@@ -12,8 +12,10 @@
 #include <flatfile.h>
 #include <primitives/block.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -56,6 +58,15 @@ protected:
     fs::path m_ldb_path;
     bool m_is_memory;
 
+    //! Coins being written by m_write_thread, served until it is finished.
+    std::unique_ptr<const CCoinsMapGeneration> m_generation;
+    std::thread m_write_thread;
+    std::atomic<bool> m_write_done{false};
+    bool m_write_ok{true};
+
+    BlockHash ReadBestBlock() const;
+    bool WriteCoins(const CCoinsMap &mapCoins, const BlockHash &hashBlock);
+
 public:
     /**
      * @param[in] ldb_path    Location in the filesystem where leveldb data will
@@ -63,6 +74,7 @@ public:
      */
     explicit CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory,
                           bool fWipe);
+    ~CCoinsViewDB();
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
@@ -71,6 +83,14 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    /**
+     * Look up the coin of each outpoint into coins, from up to num_threads
+     * threads, see ParallelFor. Coins that are not found, or fail to be read,
+     * are left spent.
+     */
+    void GetCoins(const std::vector<COutPoint> &outpoints,
+                  std::vector<Coin> &coins, size_t num_threads) const;
+
     //! Attempt to update from an older database format.
     //! Returns whether an error occurred.
     bool Upgrade();
@@ -78,6 +98,26 @@ public:
 
     //! Dynamically alter the underlying leveldb cache size.
     void ResizeCache(size_t new_cache_size) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /**
+     * Write the coins of the generation to the database from a background
+     * thread, after finishing the previous background write. Until the write
+     * is finished, this view serves the generation's coins from memory.
+     * Returns false if the previous background write failed.
+     */
+    bool WriteInBackground(std::unique_ptr<CCoinsMapGeneration> generation);
+
+    /**
+     * Finish the background write, if any, and release its coins. If wait is
+     * false, only do so if the write already completed.
+     * Returns false if the write failed.
+     */
+    bool FinishBackgroundWrite(bool wait = true);
+
+    bool IsWritingInBackground() const { return m_generation != nullptr; }
+
+    //! Memory used by the coins being written in the background.
+    size_t BackgroundWriteMemoryUsage() const;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -103,13 +143,41 @@ private:
 
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper {
+private:
+    //! Flat snapshot of the block index, empty for an in-memory database
+    const fs::path m_snapshot_path;
+
+    /**
+     * Load the block index from the snapshot, if there is one matching the
+     * database. The whole snapshot is checksummed before any entry is loaded.
+     */
+    bool LoadBlockIndexSnapshot(
+        const Consensus::Params &params,
+        const std::function<CBlockIndex *(const BlockHash &)>
+            &insertBlockIndex);
+
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false,
                           bool fWipe = false);
 
+    /**
+     * Write block file information and block index entries. Unless the id of
+     * a snapshot written just before is passed, an existing snapshot becomes
+     * stale and will no longer be loaded.
+     */
     bool WriteBatchSync(
         const std::vector<std::pair<int, const CBlockFileInfo *>> &fileInfo,
-        int nLastFile, const std::vector<const CBlockIndex *> &blockinfo);
+        int nLastFile, const std::vector<const CBlockIndex *> &blockinfo,
+        const uint256 &snapshot_id = uint256());
+    /**
+     * Write the whole block index to a flat file, which is much faster to load
+     * at startup than scanning the database. The snapshot is tagged with a
+     * fresh snapshot_id, to be passed to the WriteBatchSync() writing the
+     * dirty entries of the same block index.
+     */
+    bool WriteBlockIndexSnapshot(
+        const std::vector<const CBlockIndex *> &blockinfo,
+        uint256 &snapshot_id);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
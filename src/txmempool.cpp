@@ -464,6 +464,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry,
 
     vTxHashes.emplace_back(tx.GetHash(), newit);
     newit->vTxHashesIdx = vTxHashes.size() - 1;
+    newit->m_entry_sequence = m_next_entry_sequence++;
 }
 
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
@@ -185,6 +185,8 @@ public:
 
     //! Index in mempool's vTxHashes
     mutable size_t vTxHashesIdx;
+    //! Order in which entries were added to the mempool, unique per mempool
+    mutable uint64_t m_entry_sequence{0};
     //! epoch when last touched, useful for graph algorithms
     mutable uint64_t m_epoch;
 };
@@ -517,6 +519,10 @@ private:
     // is added or removed from the mempool for any reason.
     mutable uint64_t m_sequence_number{1};
 
+    //! Sequence given to the next entry added, see
+    //! CTxMemPoolEntry::m_entry_sequence
+    uint64_t m_next_entry_sequence GUARDED_BY(cs){1};
+
     void trackPackageRemoved(const CFeeRate &rate) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     bool m_is_loaded GUARDED_BY(cs){false};
@@ -0,0 +1,161 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <util/parallel.h>
+
+#include <sync.h>
+#include <tinyformat.h>
+#include <util/threadnames.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace {
+/** One call to ParallelForWhile */
+struct ParallelJob {
+    const size_t count;
+    const std::function<bool(size_t)> &f;
+    //! Next index to hand out
+    std::atomic<size_t> next{0};
+    //! Number of workers which may still join, the job is queued while > 0
+    size_t helpers = 0;
+    //! Number of workers running the job
+    size_t running = 0;
+    //! First exception thrown by f
+    std::exception_ptr error;
+
+    ParallelJob(size_t count_in, const std::function<bool(size_t)> &f_in)
+        : count(count_in), f(f_in) {}
+};
+
+Mutex g_parallel_mutex;
+//! Workers wait on this for jobs to be queued
+std::condition_variable g_parallel_job_queued;
+//! Callers wait on this for the workers to leave their job
+std::condition_variable g_parallel_job_left;
+std::deque<ParallelJob *> g_parallel_jobs GUARDED_BY(g_parallel_mutex);
+std::vector<std::thread> g_parallel_workers GUARDED_BY(g_parallel_mutex);
+bool g_parallel_stop GUARDED_BY(g_parallel_mutex) = false;
+
+void RunJob(ParallelJob &job) {
+    try {
+        for (size_t i = job.next++; i < job.count; i = job.next++) {
+            if (!job.f(i)) {
+                job.next = job.count;
+            }
+        }
+    } catch (...) {
+        job.next = job.count;
+        LOCK(g_parallel_mutex);
+        if (!job.error) {
+            job.error = std::current_exception();
+        }
+    }
+}
+
+void ParallelWorkerThread(int worker_num) {
+    util::ThreadRename(strprintf("parallel.%i", worker_num));
+    WAIT_LOCK(g_parallel_mutex, lock);
+    while (true) {
+        while (!g_parallel_stop && g_parallel_jobs.empty()) {
+            g_parallel_job_queued.wait(lock);
+        }
+        if (g_parallel_stop) {
+            return;
+        }
+        ParallelJob &job = *g_parallel_jobs.front();
+        if (--job.helpers == 0) {
+            g_parallel_jobs.pop_front();
+        }
+        ++job.running;
+        {
+            REVERSE_LOCK(lock);
+            RunJob(job);
+        }
+        if (--job.running == 0) {
+            g_parallel_job_left.notify_all();
+        }
+    }
+}
+} // namespace
+
+void StartParallelWorkers(int num_workers) {
+    LOCK(g_parallel_mutex);
+    assert(g_parallel_workers.empty());
+    g_parallel_stop = false;
+    for (int i = 0; i < num_workers; ++i) {
+        g_parallel_workers.emplace_back(ParallelWorkerThread, i);
+    }
+}
+
+void StopParallelWorkers() {
+    std::vector<std::thread> workers;
+    {
+        LOCK(g_parallel_mutex);
+        g_parallel_stop = true;
+        workers.swap(g_parallel_workers);
+    }
+    g_parallel_job_queued.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+size_t GetParallelWorkers() {
+    LOCK(g_parallel_mutex);
+    return g_parallel_workers.size();
+}
+
+void ParallelForWhile(size_t count, size_t num_threads, size_t min_per_thread,
+                      const std::function<bool(size_t)> &f) {
+    num_threads = std::max<size_t>(
+        1, std::min(num_threads, count / std::max<size_t>(min_per_thread, 1)));
+    ParallelJob job(count, f);
+    size_t helpers;
+    {
+        LOCK(g_parallel_mutex);
+        helpers = std::min(num_threads - 1, g_parallel_workers.size());
+        job.helpers = helpers;
+        if (helpers > 0) {
+            g_parallel_jobs.push_back(&job);
+        }
+    }
+    for (size_t i = 0; i < helpers; ++i) {
+        g_parallel_job_queued.notify_one();
+    }
+
+    RunJob(job);
+
+    std::exception_ptr error;
+    {
+        WAIT_LOCK(g_parallel_mutex, lock);
+        // Every index is handed out, the workers which did not join yet have
+        // nothing left to do.
+        if (job.helpers > 0) {
+            g_parallel_jobs.erase(std::find(g_parallel_jobs.begin(),
+                                            g_parallel_jobs.end(), &job));
+        }
+        while (job.running > 0) {
+            g_parallel_job_left.wait(lock);
+        }
+        error = job.error;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ParallelFor(size_t count, size_t num_threads, size_t min_per_thread,
+                 const std::function<void(size_t)> &f) {
+    ParallelForWhile(count, num_threads, min_per_thread, [&](size_t i) {
+        f(i);
+        return true;
+    });
+}
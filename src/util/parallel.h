@@ -0,0 +1,42 @@
+// Copyright (c) 2022 The Lotus developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_PARALLEL_H
+#define BITCOIN_UTIL_PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * Start num_workers persistent threads helping the callers of ParallelFor.
+ * Without them, ParallelFor runs everything on the calling thread.
+ */
+void StartParallelWorkers(int num_workers);
+
+/** Stop the threads started by StartParallelWorkers, once idle. */
+void StopParallelWorkers();
+
+/** Number of threads started by StartParallelWorkers */
+size_t GetParallelWorkers();
+
+/**
+ * Call f(i) for each i in [0, count), on the calling thread and up to
+ * num_threads - 1 of the parallel workers, each handling at least
+ * min_per_thread calls. Indexes are handed out in increasing order.
+ *
+ * f must be safe to call concurrently for different i. If it throws, no
+ * further index is handed out, and the first exception is rethrown once every
+ * call in progress has returned.
+ */
+void ParallelFor(size_t count, size_t num_threads, size_t min_per_thread,
+                 const std::function<void(size_t)> &f);
+
+/**
+ * Like ParallelFor, but no further index is handed out once f returned false.
+ * The calls already in progress still run to completion.
+ */
+void ParallelForWhile(size_t count, size_t num_threads, size_t min_per_thread,
+                      const std::function<bool(size_t)> &f);
+
+#endif // BITCOIN_UTIL_PARALLEL_H
@@ -24,6 +24,7 @@
 #include <index/txindex.h>
 #include <logging.h>
 #include <logging/timer.h>
+#include <memusage.h>
 #include <minerfund.h>
 #include <node/ui_interface.h>
 #include <policy/fees.h>
@@ -49,6 +50,7 @@
 #include <util/check.h> // For NDEBUG compile time check
 #include <util/intmath.h>
 #include <util/moneystr.h>
+#include <util/parallel.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 #include <util/translation.h>
@@ -57,9 +59,13 @@
 
 #include <boost/algorithm/string/replace.hpp>
 
+#include <algorithm>
+#include <functional>
 #include <optional>
 #include <string>
 #include <thread>
+#include <type_traits>
+#include <unordered_set>
 
 #define MICRO 0.000001
 #define MILLI 0.001
@@ -123,6 +129,10 @@ BlockHash hashAssumeValid;
 arith_uint256 nMinimumChainWork;
 
 CFeeRate minRelayTxFee = CFeeRate(DEFAULT_MIN_RELAY_TX_FEE_PER_KB);
+FlatFileMappingCache g_block_file_mappings{DEFAULT_BLOCK_FILE_MAPPINGS};
+int g_coins_prefetch_threads = DEFAULT_COINS_PREFETCH_THREADS;
+int g_connect_block_threads = DEFAULT_CONNECT_BLOCK_THREADS;
+bool g_block_index_snapshot = DEFAULT_BLOCK_INDEX_SNAPSHOT;
 
 // Internal stuff
 namespace {
@@ -178,9 +188,6 @@ CBlockIndex *FindForkInGlobalIndex(const CChain &chain,
 
 std::unique_ptr<CBlockTreeDB> pblocktree;
 
-static uint32_t GetNextBlockScriptFlags(const Consensus::Params &params,
-                                        const CBlockIndex *pindex);
-
 bool TestLockPointValidity(const LockPoints *lp) {
     AssertLockHeld(cs_main);
     assert(lp);
@@ -1177,11 +1184,24 @@ void UpdateCoins(CCoinsViewCache &view, const CTransaction &tx, int nHeight) {
     AddCoins(view, tx, nHeight);
 }
 
-bool CScriptCheck::operator()() {
+const PrecomputedTransactionData &DeferredTxData::Get() {
+    std::call_once(m_once, [this] {
+        m_txdata =
+            PrecomputedTransactionData(*m_tx, std::move(m_spent_outputs));
+    });
+    return m_txdata;
+}
+
+bool CScriptCheck::Check(SchnorrSignatureBatch *batch) {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
+    const PrecomputedTransactionData &data =
+        deferredTxdata ? deferredTxdata->Get() : *txdata;
+    const PreparsedPubKeys *preparsed =
+        deferredTxdata ? deferredTxdata->GetPreparsedPubKeys() : nullptr;
     if (!VerifyScript(scriptSig, m_tx_out.scriptPubKey, nFlags,
                       CachingTransactionSignatureChecker(
-                          ptxTo, nIn, m_tx_out.nValue, cacheStore, txdata),
+                          ptxTo, nIn, m_tx_out.nValue, cacheStore, data, batch,
+                          preparsed),
                       metrics, &error)) {
         return false;
     }
@@ -1204,14 +1224,16 @@ int GetSpendHeight(const CCoinsViewCache &inputs) {
     return pindexPrev->nHeight + 1;
 }
 
-bool CheckInputScripts(const CTransaction &tx, TxValidationState &state,
-                       const CCoinsViewCache &inputs, const uint32_t flags,
-                       bool sigCacheStore, bool scriptCacheStore,
-                       const PrecomputedTransactionData &txdata,
-                       int &nSigChecksOut, TxSigCheckLimiter &txLimitSigChecks,
-                       CheckInputsLimiter *pBlockLimitSigChecks,
-                       std::vector<CScriptCheck> *pvChecks) {
-    AssertLockHeld(cs_main);
+template <typename TxData>
+static bool CheckInputScriptsImpl(const CTransaction &tx,
+                                  TxValidationState &state,
+                                  const CCoinsViewCache &inputs,
+                                  const uint32_t flags, bool sigCacheStore,
+                                  bool scriptCacheStore, TxData &txdata,
+                                  int &nSigChecksOut,
+                                  TxSigCheckLimiter &txLimitSigChecks,
+                                  CheckInputsLimiter *pBlockLimitSigChecks,
+                                  std::vector<CScriptCheck> *pvChecks) {
     assert(!tx.IsCoinBase());
 
     if (pvChecks) {
@@ -1309,6 +1331,32 @@ bool CheckInputScripts(const CTransaction &tx, TxValidationState &state,
     return true;
 }
 
+bool CheckInputScripts(const CTransaction &tx, TxValidationState &state,
+                       const CCoinsViewCache &inputs, const uint32_t flags,
+                       bool sigCacheStore, bool scriptCacheStore,
+                       const PrecomputedTransactionData &txdata,
+                       int &nSigChecksOut, TxSigCheckLimiter &txLimitSigChecks,
+                       CheckInputsLimiter *pBlockLimitSigChecks,
+                       std::vector<CScriptCheck> *pvChecks) {
+    return CheckInputScriptsImpl(tx, state, inputs, flags, sigCacheStore,
+                                 scriptCacheStore, txdata, nSigChecksOut,
+                                 txLimitSigChecks, pBlockLimitSigChecks,
+                                 pvChecks);
+}
+
+bool CheckInputScripts(const CTransaction &tx, TxValidationState &state,
+                       const CCoinsViewCache &inputs, const uint32_t flags,
+                       bool sigCacheStore, bool scriptCacheStore,
+                       DeferredTxData &txdata, int &nSigChecksOut,
+                       TxSigCheckLimiter &txLimitSigChecks,
+                       CheckInputsLimiter *pBlockLimitSigChecks,
+                       std::vector<CScriptCheck> *pvChecks) {
+    return CheckInputScriptsImpl(tx, state, inputs, flags, sigCacheStore,
+                                 scriptCacheStore, txdata, nSigChecksOut,
+                                 txLimitSigChecks, pBlockLimitSigChecks,
+                                 pvChecks);
+}
+
 static bool UndoWriteToDisk(const CBlockUndo &blockundo, FlatFilePos &pos,
                             const BlockHash &hashBlock,
                             const CMessageHeader::MessageMagic &messageStart) {
@@ -1339,35 +1387,133 @@ static bool UndoWriteToDisk(const CBlockUndo &blockundo, FlatFilePos &pos,
     return true;
 }
 
-bool UndoReadFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex) {
-    FlatFilePos pos = pindex->GetUndoPos();
-    if (pos.IsNull()) {
-        return error("%s: no undo data available", __func__);
+std::shared_ptr<const FlatFileMapping>
+MapFinalizedBlockFile(int nFile, bool undo, uint64_t min_size) {
+    size_t final_size;
+    {
+        LOCK(cs_LastBlockFile);
+        if (nFile < 0 || nFile >= nLastBlockFile ||
+            size_t(nFile) >= vinfoBlockFile.size()) {
+            return nullptr;
+        }
+        // Files are only ever truncated down to these sizes, which never
+        // shrink, so the bytes below them stay valid while mapped.
+        final_size = undo ? vinfoBlockFile[nFile].nUndoSize
+                          : vinfoBlockFile[nFile].nSize;
     }
+    if (min_size > final_size) {
+        return nullptr;
+    }
+    const FlatFilePos pos(nFile, 0);
+    return g_block_file_mappings.Get(undo ? UndoFileSeq().FileName(pos)
+                                          : BlockFileSeq().FileName(pos),
+                                     min_size, final_size);
+}
 
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+/** Read num_bytes at pos of a block or undo file, mapped if possible */
+static bool ReadBlockFileBytes(FlatFileData &data, const FlatFilePos &pos,
+                               bool undo, uint32_t num_bytes) {
+    const uint64_t end_pos = uint64_t(pos.nPos) + num_bytes;
+    if (std::shared_ptr<const FlatFileMapping> mapping =
+            MapFinalizedBlockFile(pos.nFile, undo, end_pos)) {
+        data = FlatFileData(mapping,
+                            mapping->data().subspan(pos.nPos, num_bytes));
+        return true;
+    }
+    CAutoFile filein(undo ? OpenUndoFile(pos, true) : OpenBlockFile(pos, true),
+                     SER_DISK, CLIENT_VERSION);
     if (filein.IsNull()) {
-        return error("%s: OpenUndoFile failed", __func__);
+        return false;
+    }
+    std::vector<uint8_t> bytes(num_bytes);
+    try {
+        filein.read((char *)bytes.data(), bytes.size());
+    } catch (const std::exception &e) {
+        return false;
+    }
+    data = FlatFileData(std::move(bytes));
+    return true;
+}
+
+/** Read the size stored in front of a block or undo record */
+static bool ReadRecordSize(uint32_t &size, const FlatFilePos &pos, bool undo) {
+    FlatFileData size_data;
+    if (pos.nPos < sizeof(size) ||
+        !ReadBlockFileBytes(size_data,
+                            FlatFilePos(pos.nFile, pos.nPos - sizeof(size)),
+                            undo, sizeof(size))) {
+        return false;
     }
+    size = ReadLE32(size_data.bytes().data());
+    return size <= MAX_BLOCKFILE_SIZE;
+}
 
-    // Read block
-    uint256 hashChecksum;
-    // We need a CHashVerifier as reserializing may lose data
-    CHashVerifier<CAutoFile> verifier(&filein);
+bool ReadRawBlockFromDisk(FlatFileData &data, const CBlockIndex *pindex,
+                          const Consensus::Params &params) {
+    const FlatFilePos pos = pindex->GetBlockPos();
+    uint32_t size;
+    if (!ReadRecordSize(size, pos, /* undo */ false) ||
+        !ReadBlockFileBytes(data, pos, /* undo */ false, size)) {
+        return error("%s: failed to read block at %s", __func__,
+                     pos.ToString());
+    }
+    CBlockHeader header;
     try {
-        verifier << pindex->pprev->GetBlockHash();
-        verifier >> blockundo;
-        filein >> hashChecksum;
+        VectorReader(SER_DISK, CLIENT_VERSION, data.bytes(), 0, header);
     } catch (const std::exception &e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        return error("%s: Deserialize or I/O error - %s at %s", __func__,
+                     e.what(), pos.ToString());
+    }
+    // Check the header like ReadBlockFromDisk does
+    const BlockHash hash = header.GetHash();
+    if (!CheckProofOfWork(hash, header.nBits, params)) {
+        return error("%s: Errors in block header at %s", __func__,
+                     pos.ToString());
     }
+    if (hash != pindex->GetBlockHash()) {
+        return error("%s: GetHash() doesn't match index for %s at %s",
+                     __func__, pindex->ToString(), pos.ToString());
+    }
+    return true;
+}
 
-    // Verify checksum
-    if (hashChecksum != verifier.GetHash()) {
+bool ReadRawUndoFromDisk(FlatFileData &data, const CBlockIndex *pindex) {
+    const FlatFilePos pos = pindex->GetUndoPos();
+    if (pos.IsNull()) {
+        return error("%s: no undo data available", __func__);
+    }
+    uint32_t size;
+    FlatFileData record;
+    if (!ReadRecordSize(size, pos, /* undo */ true) ||
+        !ReadBlockFileBytes(record, pos, /* undo */ true,
+                            size + sizeof(uint256))) {
+        return error("%s: failed to read undo data at %s", __func__,
+                     pos.ToString());
+    }
+    uint256 checksum;
+    VectorReader(SER_DISK, CLIENT_VERSION, record.bytes(), size, checksum);
+    record.Truncate(size);
+    CHashWriter hasher(SER_GETHASH, 0);
+    hasher << pindex->pprev->GetBlockHash();
+    hasher.write((const char *)record.bytes().data(), record.bytes().size());
+    if (hasher.GetHash() != checksum) {
         return error("%s: Checksum mismatch", __func__);
     }
+    data = std::move(record);
+    return true;
+}
 
+bool UndoReadFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex) {
+    FlatFileData undo_data;
+    if (!ReadRawUndoFromDisk(undo_data, pindex)) {
+        return false;
+    }
+    try {
+        VectorReader(SER_DISK, CLIENT_VERSION, undo_data.bytes(), 0,
+                     blockundo);
+    } catch (const std::exception &e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
     return true;
 }
 
@@ -1573,15 +1719,66 @@ static bool WriteUndoDataForBlock(const CBlockUndo &blockundo,
 
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
 
+/**
+ * Collect the public keys pushed by more than one input of the block, either
+ * in the scriptSig or in the spent scriptPubKey. Parsing those up front saves
+ * the script checks from parsing them once per signature. Transactions whose
+ * scripts are in the script cache for these flags won't run any script, so
+ * their keys are skipped.
+ */
+static std::vector<CPubKey> GetRepeatedPubKeys(const CBlock &block,
+                                               const CCoinsViewCache &view,
+                                               uint32_t flags) {
+    std::vector<CPubKey> keys;
+    auto collect = [&keys](const CScript &script) {
+        CScript::const_iterator pc = script.begin();
+        opcodetype opcode;
+        std::vector<uint8_t> data;
+        while (script.GetOp(pc, opcode, data)) {
+            if (data.size() != CPubKey::COMPRESSED_SIZE &&
+                data.size() != CPubKey::SIZE) {
+                continue;
+            }
+            CPubKey pubkey(data);
+            if (pubkey.IsValid()) {
+                keys.push_back(std::move(pubkey));
+            }
+        }
+    };
+    for (const auto &ptx : block.vtx) {
+        if (ptx->IsCoinBase()) {
+            continue;
+        }
+        int nSigChecks;
+        if (IsKeyInScriptCache(ScriptCacheKey(*ptx, flags), false,
+                               nSigChecks)) {
+            continue;
+        }
+        for (const CTxIn &input : ptx->vin) {
+            collect(input.scriptSig);
+            collect(view.AccessCoin(input.prevout).GetTxOut().scriptPubKey);
+        }
+    }
+
+    // Keep one copy of each key seen at least twice.
+    std::sort(keys.begin(), keys.end());
+    std::vector<CPubKey> repeated;
+    for (size_t i = 1; i < keys.size(); ++i) {
+        if (keys[i] == keys[i - 1] &&
+            (repeated.empty() || repeated.back() != keys[i])) {
+            repeated.push_back(keys[i]);
+        }
+    }
+    return repeated;
+}
+
 void ThreadScriptCheck(int worker_num) {
     util::ThreadRename(strprintf("scriptch.%i", worker_num));
     scriptcheckqueue.Thread();
 }
 
-// Returns the script flags which should be checked for the block after
-// the given block.
-static uint32_t GetNextBlockScriptFlags(const Consensus::Params &params,
-                                        const CBlockIndex *pindex) {
+uint32_t GetNextBlockScriptFlags(const Consensus::Params &params,
+                                 const CBlockIndex *pindex) {
     uint32_t flags = SCRIPT_VERIFY_NONE;
     // Always enforce CLEANSTACK
     flags |= SCRIPT_VERIFY_CLEANSTACK;
@@ -1602,6 +1799,27 @@ static uint32_t GetNextBlockScriptFlags(const Consensus::Params &params,
     return flags;
 }
 
+//! Below this many transactions per thread, checking them ahead isn't worth it
+static constexpr size_t MIN_TXS_PER_CONNECT_THREAD = 32;
+
+/** Outcome of the checks of one transaction in ConnectBlock */
+struct TxCheckResult {
+    enum class Failure {
+        NONE,
+        INPUTS,
+        NONSTANDARD,
+        TAPROOT,
+        NONFINAL,
+        SCRIPTS,
+    };
+
+    Failure failure = Failure::NONE;
+    TxValidationState state;
+    Amount fee = Amount::zero();
+    //! Script checks deferred to the check queue
+    std::vector<CScriptCheck> checks;
+};
+
 static int64_t nTimeCheck = 0;
 static int64_t nTimeForks = 0;
 static int64_t nTimeVerify = 0;
@@ -1746,7 +1964,6 @@ bool CChainState::ConnectBlock(const CBlock &block, BlockValidationState &state,
              MILLI * (nTime2 - nTime1), nTimeForks * MICRO,
              nTimeForks * MILLI / nBlocksTotal);
 
-    std::vector<int> prevheights;
     Amount nFees = Amount::zero();
     int nInputs = 0;
 
@@ -1764,6 +1981,12 @@ bool CChainState::ConnectBlock(const CBlock &block, BlockValidationState &state,
     CBlockUndo blockundo;
     blockundo.vtxundo.resize(block.vtx.size() - 1);
 
+    // Block-scoped storage for the PrecomputedTransactionData the script
+    // checks refer to. It must outlive control, which waits for them.
+    std::vector<DeferredTxData> txsdata(block.vtx.size() - 1);
+    // Same for the public keys used by several inputs, parsed once for all.
+    PreparsedPubKeys preparsed_pubkeys;
+
     CCheckQueueControl<CScriptCheck> control(fScriptChecks ? &scriptcheckqueue
                                                            : nullptr);
 
@@ -1786,28 +2009,24 @@ bool CChainState::ConnectBlock(const CBlock &block, BlockValidationState &state,
                              "tx-duplicate");
     }
 
-    size_t txIndex = 0;
-    for (const auto &ptx : block.vtx) {
-        const CTransaction &tx = *ptx;
+    if (fScriptChecks) {
+        // The view now holds every coin spent by the block, including the
+        // ones created in it.
+        preparsed_pubkeys =
+            PreparsedPubKeys(GetRepeatedPubKeys(block, view, flags));
+    }
+
+    // The checks of a transaction that only read the view. The first one
+    // failing is recorded in the result, to be reported in block order.
+    auto checkTx = [&](size_t i, TxCheckResult &result) {
+        const CTransaction &tx = *block.vtx[i];
         const bool isCoinBase = tx.IsCoinBase();
-        nInputs += tx.vin.size();
 
-        {
-            Amount txfee = Amount::zero();
-            TxValidationState tx_state;
-            if (!isCoinBase &&
-                !Consensus::CheckTxInputs(tx, tx_state, view, pindex->nHeight,
-                                          txfee)) {
-                // Any transaction validation failure in ConnectBlock is a block
-                // consensus failure.
-                state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
-                              tx_state.GetRejectReason(),
-                              tx_state.GetDebugMessage());
-
-                return error("%s: Consensus::CheckTxInputs: %s, %s", __func__,
-                             tx.GetId().ToString(), state.ToString());
-            }
-            nFees += txfee;
+        if (!isCoinBase &&
+            !Consensus::CheckTxInputs(tx, result.state, view, pindex->nHeight,
+                                      result.fee)) {
+            result.failure = TxCheckResult::Failure::INPUTS;
+            return;
         }
 
         // Enforce standardness on all txs.
@@ -1815,82 +2034,177 @@ bool CChainState::ConnectBlock(const CBlock &block, BlockValidationState &state,
             std::string reason;
             if (!IsStandardTx(tx, fIsBareMultisigStd, CFeeRate(Amount::zero()),
                               reason)) {
-                LogPrintf("ERROR: %s: contains a non-standard transaction "
-                          "(and fRequireStandardConsensus is true)\n",
-                          __func__);
-                return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                result.state.Invalid(TxValidationResult::TX_NOT_STANDARD,
                                      reason);
+                result.failure = TxCheckResult::Failure::NONSTANDARD;
+                return;
             }
             // Taproot is phased out after the Numbers update
             if (IsNumbersEnabled(consensusParams, pindex->pprev)) {
                 if (TxHasPayToTaproot(tx)) {
-                    return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
-                                         "bad-taproot-phased-out");
+                    result.failure = TxCheckResult::Failure::TAPROOT;
+                    return;
                 }
             }
         }
 
-        if (!MoneyRange(nFees)) {
-            LogPrintf("ERROR: %s: accumulated fee in the block out of range.\n",
-                      __func__);
-            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
-                                 "bad-txns-accumulated-fee-outofrange");
-        }
-
         // The following checks do not apply to the coinbase.
         if (isCoinBase) {
-            continue;
+            return;
         }
+        const size_t txIndex = i - 1;
 
         // Check that transaction is BIP68 final BIP68 lock checks (as
         // opposed to nLockTime checks) must be in ConnectBlock because they
         // require the UTXO set.
-        prevheights.resize(tx.vin.size());
+        std::vector<int> prevheights(tx.vin.size());
         for (size_t j = 0; j < tx.vin.size(); j++) {
             prevheights[j] = view.AccessCoin(tx.vin[j].prevout).GetHeight();
         }
 
         if (!SequenceLocks(tx, nLockTimeFlags, prevheights, *pindex)) {
-            LogPrintf("ERROR: %s: contains a non-BIP68-final transaction\n",
-                      __func__);
-            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
-                                 "bad-txns-nonfinal");
+            result.failure = TxCheckResult::Failure::NONFINAL;
+            return;
         }
 
         // Don't cache results if we're actually connecting blocks (still
         // consult the cache, though).
         bool fCacheResults = fJustCheck;
 
-        std::vector<CScriptCheck> vChecks;
         // nSigChecksRet may be accurate (found in cache) or 0 (checks were
-        // deferred into vChecks).
+        // deferred into result.checks).
         int nSigChecksRet;
-        TxValidationState tx_state;
+        if (fScriptChecks) {
+            // Only gather the spent outputs here, which needs the view. The
+            // rest of the precomputation is left to the script check threads.
+            std::vector<CTxOut> spent_outputs;
+            spent_outputs.reserve(tx.vin.size());
+            for (const CTxIn &input : tx.vin) {
+                spent_outputs.push_back(
+                    view.AccessCoin(input.prevout).GetTxOut());
+            }
+            txsdata[txIndex].Init(tx, std::move(spent_outputs),
+                                  &preparsed_pubkeys);
+        }
         if (fScriptChecks &&
-            !CheckInputScripts(
-                tx, tx_state, view, flags, fCacheResults, fCacheResults,
-                PrecomputedTransactionData::FromCoinsView(tx, view),
-                nSigChecksRet, nSigChecksTxLimiters[txIndex],
-                &nSigChecksBlockLimiter, &vChecks)) {
+            !CheckInputScripts(tx, result.state, view, flags, fCacheResults,
+                               fCacheResults, txsdata[txIndex], nSigChecksRet,
+                               nSigChecksTxLimiters[txIndex],
+                               &nSigChecksBlockLimiter, &result.checks)) {
+            result.failure = TxCheckResult::Failure::SCRIPTS;
+        }
+    };
+
+    std::vector<TxCheckResult> txResults(block.vtx.size());
+    // Transactions not checked ahead, which happens right before they are
+    // spent instead.
+    std::vector<bool> checkInline(block.vtx.size(), true);
+    if (g_connect_block_threads > 0 &&
+        block.vtx.size() >= 2 * MIN_TXS_PER_CONNECT_THREAD) {
+        // Resolve every input, so that checking the transactions only reads
+        // the view and can be done concurrently. A transaction spending a
+        // missing coin, or one that another transaction of the block spends
+        // too, is left to be checked inline, after the transactions before it
+        // are spent.
+        std::vector<std::pair<const Coin *, size_t>> spentCoins;
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            checkInline[i] = false;
+            for (const CTxIn &txin : block.vtx[i]->vin) {
+                const Coin &coin = view.AccessCoin(txin.prevout);
+                if (coin.IsSpent()) {
+                    checkInline[i] = true;
+                } else {
+                    spentCoins.emplace_back(&coin, i);
+                }
+            }
+        }
+        std::sort(spentCoins.begin(), spentCoins.end());
+        for (size_t k = 1; k < spentCoins.size(); k++) {
+            if (spentCoins[k].first == spentCoins[k - 1].first) {
+                checkInline[spentCoins[k - 1].second] = true;
+                checkInline[spentCoins[k].second] = true;
+            }
+        }
+
+        ParallelFor(block.vtx.size(), g_connect_block_threads,
+                    MIN_TXS_PER_CONNECT_THREAD, [&](size_t i) {
+                        if (!checkInline[i]) {
+                            checkTx(i, txResults[i]);
+                        }
+                    });
+    }
+
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction &tx = *block.vtx[i];
+        TxCheckResult &result = txResults[i];
+        nInputs += tx.vin.size();
+        if (checkInline[i]) {
+            checkTx(i, result);
+        }
+
+        if (result.failure == TxCheckResult::Failure::INPUTS) {
+            // Any transaction validation failure in ConnectBlock is a block
+            // consensus failure.
+            state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                          result.state.GetRejectReason(),
+                          result.state.GetDebugMessage());
+
+            return error("%s: Consensus::CheckTxInputs: %s, %s", __func__,
+                         tx.GetId().ToString(), state.ToString());
+        }
+        nFees += result.fee;
+
+        if (result.failure == TxCheckResult::Failure::NONSTANDARD) {
+            LogPrintf("ERROR: %s: contains a non-standard transaction "
+                      "(and fRequireStandardConsensus is true)\n",
+                      __func__);
+            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                                 result.state.GetRejectReason());
+        }
+        if (result.failure == TxCheckResult::Failure::TAPROOT) {
+            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                                 "bad-taproot-phased-out");
+        }
+
+        if (!MoneyRange(nFees)) {
+            LogPrintf("ERROR: %s: accumulated fee in the block out of range.\n",
+                      __func__);
+            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                                 "bad-txns-accumulated-fee-outofrange");
+        }
+
+        // The following checks do not apply to the coinbase.
+        if (tx.IsCoinBase()) {
+            continue;
+        }
+
+        if (result.failure == TxCheckResult::Failure::NONFINAL) {
+            LogPrintf("ERROR: %s: contains a non-BIP68-final transaction\n",
+                      __func__);
+            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
+                                 "bad-txns-nonfinal");
+        }
+
+        if (result.failure == TxCheckResult::Failure::SCRIPTS) {
             // Any transaction validation failure in ConnectBlock is a block
             // consensus failure
             state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
-                          tx_state.GetRejectReason(),
-                          tx_state.GetDebugMessage());
+                          result.state.GetRejectReason(),
+                          result.state.GetDebugMessage());
             return error(
                 "ConnectBlock(): CheckInputScripts on %s failed with %s",
                 tx.GetId().ToString(), state.ToString());
         }
 
-        control.Add(vChecks);
+        control.Add(result.checks);
 
-        // Note: this must execute in the same iteration as CheckTxInputs (not
-        // in a separate loop) in order to detect double spends. However,
-        // this does not prevent double-spending by duplicated transaction
-        // inputs in the same transaction (cf. CVE-2018-17144) -- that check is
-        // done in CheckBlock (CheckRegularTransaction).
-        SpendCoins(view, tx, blockundo.vtxundo.at(txIndex), pindex->nHeight);
-        txIndex++;
+        // Note: when checked inline, this must execute in the same iteration
+        // as CheckTxInputs (not in a separate loop) in order to detect double
+        // spends. Transactions checked ahead never double spend, see above.
+        // However, this does not prevent double-spending by duplicated
+        // transaction inputs in the same transaction (cf. CVE-2018-17144) --
+        // that check is done in CheckBlock (CheckRegularTransaction).
+        SpendCoins(view, tx, blockundo.vtxundo.at(i - 1), pindex->nHeight);
     }
 
     int64_t nTime3 = GetTimeMicros();
@@ -1999,7 +2313,8 @@ CChainState::GetCoinsCacheSizeState(const CTxMemPool *tx_pool,
                                     size_t max_coins_cache_size_bytes,
                                     size_t max_mempool_size_bytes) {
     int64_t nMempoolUsage = tx_pool->DynamicMemoryUsage();
-    int64_t cacheSize = CoinsTip().DynamicMemoryUsage();
+    int64_t cacheSize = CoinsTip().DynamicMemoryUsage() +
+                        CoinsDB().BackgroundWriteMemoryUsage();
     int64_t nTotalSpace =
         max_coins_cache_size_bytes +
         std::max<int64_t>(max_mempool_size_bytes - nMempoolUsage, 0);
@@ -2030,11 +2345,20 @@ bool CChainState::FlushStateToDisk(const CChainParams &chainparams,
     static std::chrono::microseconds nLastFlush{0};
     std::set<int> setFilesToPrune;
     bool full_flush_completed = false;
+    bool background_flush_started = false;
 
     const size_t coins_count = CoinsTip().GetCacheSize();
     const size_t coins_mem_usage = CoinsTip().DynamicMemoryUsage();
 
     try {
+        // Release the coins of a completed background write.
+        if (!CoinsDB().FinishBackgroundWrite(/*wait*/ false)) {
+            return AbortNode(state, "Failed to write to coin database");
+        }
+        if (m_background_flush_locator && !CoinsDB().IsWritingInBackground()) {
+            GetMainSignals().ChainStateFlushed(*m_background_flush_locator);
+            m_background_flush_locator.reset();
+        }
         {
             bool fFlushForPrune = false;
             bool fDoFullFlush = false;
@@ -2074,8 +2398,10 @@ bool CChainState::FlushStateToDisk(const CChainParams &chainparams,
             }
             // The cache is large and we're within 10% and 10 MiB of the limit,
             // but we have time now (not in the middle of a block processing).
+            // A background write in progress is about to make room already.
             bool fCacheLarge = mode == FlushStateMode::PERIODIC &&
-                               cache_state >= CoinsCacheSizeState::LARGE;
+                               cache_state >= CoinsCacheSizeState::LARGE &&
+                               !CoinsDB().IsWritingInBackground();
             // The cache is over the limit, we have to write now.
             bool fCacheCritical = mode == FlushStateMode::IF_NEEDED &&
                                   cache_state >= CoinsCacheSizeState::CRITICAL;
@@ -2090,6 +2416,12 @@ bool CChainState::FlushStateToDisk(const CChainParams &chainparams,
             // Combine all conditions that result in a full cache flush.
             fDoFullFlush = (mode == FlushStateMode::ALWAYS) || fCacheLarge ||
                            fCacheCritical || fPeriodicFlush || fFlushForPrune;
+            // Unless the coins must be on disk when we return, write them from
+            // a background thread while block connection goes on. Only wipe
+            // the cache if it is short of room.
+            const bool fBackgroundFlush =
+                mode != FlushStateMode::ALWAYS && !fFlushForPrune;
+            const bool fWipeCache = fCacheLarge || fCacheCritical;
             // Write blocks and block index to disk.
             if (fDoFullFlush || fPeriodicWrite) {
                 // Depend on nMinDiskSpace to ensure we can write block index
@@ -2128,8 +2460,23 @@ bool CChainState::FlushStateToDisk(const CChainParams &chainparams,
 
                     setDirtyBlockIndex.clear();
 
+                    // On shutdown and from time to time, also snapshot the
+                    // whole block index so the next startup can skip scanning
+                    // the database. Failing to do so only costs startup time.
+                    uint256 snapshot_id;
+                    if (g_block_index_snapshot &&
+                        (mode == FlushStateMode::ALWAYS || fPeriodicWrite)) {
+                        std::vector<const CBlockIndex *> vAllBlocks;
+                        vAllBlocks.reserve(m_blockman.m_block_index.size());
+                        for (const auto &entry : m_blockman.m_block_index) {
+                            vAllBlocks.push_back(entry.second);
+                        }
+                        pblocktree->WriteBlockIndexSnapshot(vAllBlocks,
+                                                            snapshot_id);
+                    }
+
                     if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile,
-                                                    vBlocks)) {
+                                                    vBlocks, snapshot_id)) {
                         return AbortNode(
                             state, "Failed to write to block index database");
                     }
@@ -2147,9 +2494,10 @@ bool CChainState::FlushStateToDisk(const CChainParams &chainparams,
             // Flush best chain related state. This can only be done if the
             // blocks / block index write was also done.
             if (fDoFullFlush && !CoinsTip().GetBestBlock().IsNull()) {
-                LOG_TIME_SECONDS(
-                    strprintf("write coins cache to disk (%d coins, %.2fkB)",
-                              coins_count, coins_mem_usage / 1000));
+                LOG_TIME_SECONDS(strprintf(
+                    "%s coins cache to disk (%d coins, %.2fkB)",
+                    fBackgroundFlush ? "start writing" : "write", coins_count,
+                    coins_mem_usage / 1000));
 
                 // Typical Coin structures on disk are around 48 bytes in size.
                 // Pushing a new one to the database can cause it to be written
@@ -2165,7 +2513,15 @@ bool CChainState::FlushStateToDisk(const CChainParams &chainparams,
 
                 // Flush the chainstate (which may refer to block index
                 // entries).
-                if (!CoinsTip().Flush()) {
+                if (fBackgroundFlush) {
+                    auto generation = std::make_unique<CCoinsMapGeneration>();
+                    CoinsTip().Freeze(*generation, fWipeCache);
+                    if (!CoinsDB().WriteInBackground(std::move(generation))) {
+                        return AbortNode(state,
+                                         "Failed to write to coin database");
+                    }
+                    background_flush_started = true;
+                } else if (!CoinsTip().Flush()) {
                     return AbortNode(state, "Failed to write to coin database");
                 }
                 nLastFlush = nNow;
@@ -2173,7 +2529,12 @@ bool CChainState::FlushStateToDisk(const CChainParams &chainparams,
             }
         }
 
-        if (full_flush_completed) {
+        if (background_flush_started) {
+            // Signalled by a later call, once the write is durable. If another
+            // background write starts first, this one is covered by it.
+            m_background_flush_locator = m_chain.GetLocator();
+        } else if (full_flush_completed) {
+            m_background_flush_locator.reset();
             // Update best block in wallet (so we can detect restored wallets).
             GetMainSignals().ChainStateFlushed(m_chain.GetLocator());
         }
@@ -2314,6 +2675,7 @@ bool CChainState::DisconnectTip(const CChainParams &params,
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2439,6 +2801,44 @@ static const CBlockIndex *FindBlockToFinalize(CBlockIndex *pindexNew)
     return nullptr;
 }
 
+/**
+ * Look up the coins spent by the block in the coins database from several
+ * threads, and cache them, so that connecting the block doesn't wait on one
+ * database read after the other. Coins created by the block itself, or
+ * already cached, are left alone.
+ */
+static void PrefetchBlockInputs(const CBlock &block, CCoinsViewCache &cache,
+                                const CCoinsViewDB &db) {
+    if (g_coins_prefetch_threads <= 0) {
+        return;
+    }
+
+    std::unordered_set<TxId, SaltedTxIdHasher> created;
+    for (const CTransactionRef &tx : block.vtx) {
+        created.insert(tx->GetId());
+    }
+    std::vector<COutPoint> outpoints;
+    for (const CTransactionRef &tx : block.vtx) {
+        if (tx->IsCoinBase()) {
+            continue;
+        }
+        for (const CTxIn &txin : tx->vin) {
+            if (!created.count(txin.prevout.GetTxId()) &&
+                !cache.HaveCoinInCache(txin.prevout)) {
+                outpoints.push_back(txin.prevout);
+            }
+        }
+    }
+
+    std::vector<Coin> coins;
+    db.GetCoins(outpoints, coins, g_coins_prefetch_threads);
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        if (!coins[i].IsSpent()) {
+            cache.CacheCoin(outpoints[i], std::move(coins[i]));
+        }
+    }
+}
+
 /**
  * Connect a new block to m_chain. pblock is either nullptr or a pointer to
  * a CBlock corresponding to pindexNew, to bypass loading it again from disk.
@@ -2481,6 +2881,12 @@ bool CChainState::ConnectTip(const Config &config, BlockValidationState &state,
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n",
              (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
     {
+        PrefetchBlockInputs(blockConnecting, CoinsTip(), CoinsDB());
+        int64_t nTimePrefetched = GetTimeMicros();
+        nTimePrefetch += nTimePrefetched - nTime2;
+        LogPrint(BCLog::BENCH, "  - Prefetch coins: %.2fms [%.2fs]\n",
+                 (nTimePrefetched - nTime2) * MILLI, nTimePrefetch * MICRO);
+
         CCoinsViewCache view(&CoinsTip());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, params,
                                BlockValidationOptions(config));
@@ -3463,17 +3869,22 @@ const CBlockIndex *CChainState::GetFinalizedBlock() const {
 }
 
 CBlockIndex *BlockManager::AddToBlockIndex(const CBlockHeader &block) {
+    return AddToBlockIndex(block, block.GetHash());
+}
+
+CBlockIndex *BlockManager::AddToBlockIndex(const CBlockHeader &block,
+                                           const BlockHash &hash) {
     AssertLockHeld(cs_main);
 
     // Check for duplicate
-    BlockHash hash = block.GetHash();
     BlockMap::iterator it = m_block_index.find(hash);
     if (it != m_block_index.end()) {
         return it->second;
     }
 
     // Construct new block index object
-    CBlockIndex *pindexNew = new CBlockIndex(block);
+    CBlockIndex *pindexNew = ::new (m_block_index_memory_resource->Allocate(
+        sizeof(CBlockIndex), alignof(CBlockIndex))) CBlockIndex(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3659,13 +4070,13 @@ static bool FindUndoPos(BlockValidationState &state, int nFile,
  * Do not call this for any check that depends on the context.
  * For context-dependent calls, see ContextualCheckBlockHeader.
  */
-static bool CheckBlockHeader(const CBlockHeader &block,
+static bool CheckBlockHeader(const CBlockHeader &block, const BlockHash &hash,
                              BlockValidationState &state,
                              const Consensus::Params &params,
                              BlockValidationOptions validationOptions) {
     // Check proof of work matches claimed amount
     if (validationOptions.shouldValidatePoW() &&
-        !CheckProofOfWork(block.GetHash(), block.nBits, params)) {
+        !CheckProofOfWork(hash, block.nBits, params)) {
         return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER,
                              "high-hash", "proof of work failed");
     }
@@ -3707,7 +4118,8 @@ bool CheckBlock(const CBlock &block, BlockValidationState &state,
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, params, validationOptions)) {
+    if (!CheckBlockHeader(block, block.GetHash(), state, params,
+                          validationOptions)) {
         return false;
     }
 
@@ -4096,13 +4508,13 @@ static bool ContextualCheckBlock(const CBlock &block,
  */
 bool BlockManager::AcceptBlockHeader(const Config &config,
                                      const CBlockHeader &block,
+                                     const BlockHash &hash,
                                      BlockValidationState &state,
                                      CBlockIndex **ppindex) {
     AssertLockHeld(cs_main);
     const CChainParams &chainparams = config.GetChainParams();
 
     // Check for duplicate
-    BlockHash hash = block.GetHash();
     BlockMap::iterator miSelf = m_block_index.find(hash);
     CBlockIndex *pindex = nullptr;
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
@@ -4123,7 +4535,7 @@ bool BlockManager::AcceptBlockHeader(const Config &config,
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(),
+        if (!CheckBlockHeader(block, hash, state, chainparams.GetConsensus(),
                               BlockValidationOptions(config))) {
             LogPrint(BCLog::VALIDATION,
                      "%s: Consensus::CheckBlockHeader: %s, %s\n", __func__,
@@ -4198,7 +4610,7 @@ bool BlockManager::AcceptBlockHeader(const Config &config,
     }
 
     if (pindex == nullptr) {
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, hash);
     }
 
     if (ppindex) {
@@ -4212,14 +4624,25 @@ bool BlockManager::AcceptBlockHeader(const Config &config,
 bool ChainstateManager::ProcessNewBlockHeaders(
     const Config &config, const std::vector<CBlockHeader> &headers,
     BlockValidationState &state, const CBlockIndex **ppindex) {
+    // Hash all the headers at once before grabbing cs_main.
+    return ProcessNewBlockHeaders(config, headers,
+                                  GetBlockHeaderHashes(headers), state,
+                                  ppindex);
+}
+
+bool ChainstateManager::ProcessNewBlockHeaders(
+    const Config &config, const std::vector<CBlockHeader> &headers,
+    const std::vector<BlockHash> &hashes, BlockValidationState &state,
+    const CBlockIndex **ppindex) {
     AssertLockNotHeld(cs_main);
+    assert(hashes.size() == headers.size());
     {
         LOCK(cs_main);
-        for (const CBlockHeader &header : headers) {
+        for (size_t i = 0; i < headers.size(); ++i) {
             // Use a temp pindex instead of ppindex to avoid a const_cast
             CBlockIndex *pindex = nullptr;
-            bool accepted =
-                m_blockman.AcceptBlockHeader(config, header, state, &pindex);
+            bool accepted = m_blockman.AcceptBlockHeader(
+                config, headers[i], hashes[i], state, &pindex);
             ::ChainstateActive().CheckBlockIndex(
                 config.GetChainParams().GetConsensus());
 
@@ -4298,8 +4721,8 @@ bool CChainState::AcceptBlock(const Config &config,
 
     CBlockIndex *pindex = nullptr;
 
-    bool accepted_header =
-        m_blockman.AcceptBlockHeader(config, block, state, &pindex);
+    bool accepted_header = m_blockman.AcceptBlockHeader(
+        config, block, block.GetHash(), state, &pindex);
     CheckBlockIndex(config.GetChainParams().GetConsensus());
 
     if (!accepted_header) {
@@ -4584,6 +5007,8 @@ void BlockManager::PruneOneBlockFile(const int fileNumber) {
 void UnlinkPrunedFiles(const std::set<int> &setFilesToPrune) {
     for (const int i : setFilesToPrune) {
         FlatFilePos pos(i, 0);
+        g_block_file_mappings.Erase(BlockFileSeq().FileName(pos));
+        g_block_file_mappings.Erase(UndoFileSeq().FileName(pos));
         fs::remove(BlockFileSeq().FileName(pos));
         fs::remove(UndoFileSeq().FileName(pos));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, i);
@@ -4709,7 +5134,8 @@ CBlockIndex *BlockManager::InsertBlockIndex(const BlockHash &hash) {
     }
 
     // Create new
-    CBlockIndex *pindexNew = new CBlockIndex();
+    CBlockIndex *pindexNew = ::new (m_block_index_memory_resource->Allocate(
+        sizeof(CBlockIndex), alignof(CBlockIndex))) CBlockIndex();
     mi = m_block_index.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -4795,11 +5221,19 @@ void BlockManager::Unload() {
     m_failed_blocks.clear();
     m_blocks_unlinked.clear();
 
-    for (const BlockMap::value_type &entry : m_block_index) {
-        delete entry.second;
-    }
-
+    // The entries live in m_block_index_memory_resource and need no
+    // destruction, releasing the resource frees them all at once.
+    static_assert(std::is_trivially_destructible_v<CBlockIndex>,
+                  "Block index entries are never destructed");
     m_block_index.clear();
+    m_block_index_memory_resource.emplace();
+}
+
+size_t BlockManager::DynamicMemoryUsage() const {
+    AssertLockHeld(cs_main);
+    return memusage::DynamicUsage(m_block_index) +
+           m_block_index_memory_resource->NumAllocatedChunks() *
+               m_block_index_memory_resource->ChunkSizeBytes();
 }
 
 static bool LoadBlockIndexDB(ChainstateManager &chainman,
@@ -23,6 +23,7 @@
 #include <protocol.h> // For CMessageHeader::MessageMagic
 #include <script/script_error.h>
 #include <script/script_metrics.h>
+#include <support/allocators/pool.h>
 #include <sync.h>
 #include <txdb.h>
 #include <txmempool.h> // For CTxMemPool::cs
@@ -31,6 +32,7 @@
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <set>
 #include <string>
@@ -51,7 +53,10 @@ class Config;
 class CScriptCheck;
 class CTxMemPool;
 class CTxUndo;
+class DeferredTxData;
 class DisconnectedBlockTransactions;
+class PreparsedPubKeys;
+class SchnorrSignatureBatch;
 class TxValidationState;
 
 struct ChainTxData;
@@ -85,6 +90,18 @@ static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false;
 static const char *const DEFAULT_BLOCKFILTERINDEX = "0";
+/** Default for -blockfilemappings, memory mapping is opt-in */
+static const int DEFAULT_BLOCK_FILE_MAPPINGS = 0;
+/** Maximum number of threads looking up the coins spent by a block */
+static const int MAX_COINS_PREFETCH_THREADS = 64;
+/** Default for -coinsprefetchthreads */
+static const int DEFAULT_COINS_PREFETCH_THREADS = 4;
+/** Maximum number of threads checking the transactions of a block */
+static const int MAX_CONNECT_BLOCK_THREADS = 16;
+/** Default for -connectblockthreads, checking transactions ahead is opt-in */
+static const int DEFAULT_CONNECT_BLOCK_THREADS = 0;
+/** Default for -blockindexsnapshot */
+static const bool DEFAULT_BLOCK_INDEX_SNAPSHOT = false;
 
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -131,6 +148,12 @@ enum class SynchronizationState { INIT_REINDEX, INIT_DOWNLOAD, POST_INIT };
 
 extern RecursiveMutex cs_main;
 typedef std::unordered_map<BlockHash, CBlockIndex *, BlockHasher> BlockMap;
+/**
+ * Block index entries are only ever freed all at once, so they are served
+ * back to back from large chunks rather than allocated one by one.
+ */
+using BlockIndexMemoryResource =
+    PoolResource<sizeof(CBlockIndex), alignof(CBlockIndex)>;
 extern Mutex g_best_block_mutex;
 extern std::condition_variable g_best_block_cv;
 extern uint256 g_best_block;
@@ -177,6 +200,14 @@ extern bool fPruneMode;
 extern uint64_t nPruneTarget;
 /** Documentation for argument 'checklevel'. */
 extern const std::vector<std::string> CHECKLEVEL_DOC;
+/** Memory mappings of finalized block and undo files, see -blockfilemappings */
+extern FlatFileMappingCache g_block_file_mappings;
+/** Threads looking up the coins spent by a block before connecting it */
+extern int g_coins_prefetch_threads;
+/** Threads checking the transactions of a block ahead of connecting them */
+extern int g_connect_block_threads;
+/** Whether to keep a snapshot of the block index for faster startup */
+extern bool g_block_index_snapshot;
 
 class BlockValidationOptions {
 private:
@@ -243,6 +274,13 @@ void UnloadBlockIndex(CTxMemPool *mempool, ChainstateManager &chainman);
  */
 void ThreadScriptCheck(int worker_num);
 
+/**
+ * Returns the script flags which should be checked for the block after the
+ * given block.
+ */
+uint32_t GetNextBlockScriptFlags(const Consensus::Params &params,
+                                 const CBlockIndex *pindex);
+
 /**
  * Return transaction from the block at block_index.
  * If block_index is not provided, fall back to mempool.
@@ -355,6 +393,9 @@ class ConnectTrace;
  * This function should only be called after the cheap sanity checks in
  * CheckTxInputs passed.
  *
+ * The script execution and signature caches have their own locks, so this
+ * doesn't require cs_main, as long as the caller keeps view consistent.
+ *
  * If pvChecks is not nullptr, script checks are pushed onto it instead of being
  * performed inline. Any script checks which are not necessary (eg due to script
  * execution cache hits) are, obviously, not pushed onto pvChecks/run.
@@ -383,8 +424,19 @@ bool CheckInputScripts(const CTransaction &tx, TxValidationState &state,
                        const PrecomputedTransactionData &txdata,
                        int &nSigChecksOut, TxSigCheckLimiter &txLimitSigChecks,
                        CheckInputsLimiter *pBlockLimitSigChecks,
-                       std::vector<CScriptCheck> *pvChecks)
-    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+                       std::vector<CScriptCheck> *pvChecks);
+
+/**
+ * Same as above, but the PrecomputedTransactionData is only built if a script
+ * actually needs to be run.
+ */
+bool CheckInputScripts(const CTransaction &tx, TxValidationState &state,
+                       const CCoinsViewCache &view, const uint32_t flags,
+                       bool sigCacheStore, bool scriptCacheStore,
+                       DeferredTxData &txdata, int &nSigChecksOut,
+                       TxSigCheckLimiter &txLimitSigChecks,
+                       CheckInputsLimiter *pBlockLimitSigChecks,
+                       std::vector<CScriptCheck> *pvChecks);
 
 /**
  * Handy shortcut to full fledged CheckInputScripts call.
@@ -393,8 +445,8 @@ static inline bool
 CheckInputScripts(const CTransaction &tx, TxValidationState &state,
                   const CCoinsViewCache &view, const uint32_t flags,
                   bool sigCacheStore, bool scriptCacheStore,
-                  const PrecomputedTransactionData &txdata, int &nSigChecksOut)
-    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+                  const PrecomputedTransactionData &txdata,
+                  int &nSigChecksOut) {
     TxSigCheckLimiter nSigChecksTxLimiter;
     return CheckInputScripts(tx, state, view, flags, sigCacheStore,
                              scriptCacheStore, txdata, nSigChecksOut,
@@ -440,9 +492,45 @@ bool CheckSequenceLocks(const CTxMemPool &pool, const CTransaction &tx,
                         bool useExistingLockPoints = false)
     EXCLUSIVE_LOCKS_REQUIRED(::cs_main, pool.cs);
 
+/**
+ * PrecomputedTransactionData of a transaction being connected, built on first
+ * use. ConnectBlock keeps one per transaction in a block-scoped vector and
+ * hands them to the script checks, so the precomputation runs on the script
+ * check threads instead of serially on the validation thread. It is skipped
+ * altogether for transactions found in the script cache.
+ */
+class DeferredTxData {
+private:
+    const CTransaction *m_tx = nullptr;
+    std::vector<CTxOut> m_spent_outputs;
+    std::once_flag m_once;
+    PrecomputedTransactionData m_txdata;
+    const PreparsedPubKeys *m_preparsed_pubkeys = nullptr;
+
+public:
+    /**
+     * Set the transaction. Must happen before the checks are queued.
+     * preparsed_pubkeys, if set, must outlive the checks.
+     */
+    void Init(const CTransaction &tx, std::vector<CTxOut> &&spent_outputs,
+              const PreparsedPubKeys *preparsed_pubkeys = nullptr) {
+        m_tx = &tx;
+        m_spent_outputs = std::move(spent_outputs);
+        m_preparsed_pubkeys = preparsed_pubkeys;
+    }
+
+    /** Thread safe, the first call does the precomputation. */
+    const PrecomputedTransactionData &Get();
+
+    const PreparsedPubKeys *GetPreparsedPubKeys() const {
+        return m_preparsed_pubkeys;
+    }
+};
+
 /**
  * Closure representing one script verification.
- * Note that this stores references to the spending transaction.
+ * Note that this stores references to the spending transaction and to its
+ * PrecomputedTransactionData.
  *
  * Note that if pLimitSigChecks is passed, then failure does not imply that
  * scripts have failed.
@@ -456,14 +544,22 @@ private:
     bool cacheStore;
     ScriptError error;
     ScriptExecutionMetrics metrics;
-    PrecomputedTransactionData txdata;
+    const PrecomputedTransactionData *txdata;
+    DeferredTxData *deferredTxdata;
     TxSigCheckLimiter *pTxLimitSigChecks;
     CheckInputsLimiter *pBlockLimitSigChecks;
 
+    /**
+     * Run the script check. If batch is set, the verification of Schnorr
+     * signatures is deferred to it, and only valid once the batch verifies.
+     */
+    bool Check(SchnorrSignatureBatch *batch);
+
 public:
     CScriptCheck()
         : ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false),
-          error(ScriptError::UNKNOWN), txdata(), pTxLimitSigChecks(nullptr),
+          error(ScriptError::UNKNOWN), txdata(nullptr),
+          deferredTxdata(nullptr), pTxLimitSigChecks(nullptr),
           pBlockLimitSigChecks(nullptr) {}
 
     CScriptCheck(const CTxOut &outIn, const CTransaction &txToIn,
@@ -472,11 +568,25 @@ public:
                  TxSigCheckLimiter *pTxLimitSigChecksIn = nullptr,
                  CheckInputsLimiter *pBlockLimitSigChecksIn = nullptr)
         : m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn),
-          cacheStore(cacheIn), error(ScriptError::UNKNOWN), txdata(txdataIn),
-          pTxLimitSigChecks(pTxLimitSigChecksIn),
+          cacheStore(cacheIn), error(ScriptError::UNKNOWN), txdata(&txdataIn),
+          deferredTxdata(nullptr), pTxLimitSigChecks(pTxLimitSigChecksIn),
           pBlockLimitSigChecks(pBlockLimitSigChecksIn) {}
 
-    bool operator()();
+    CScriptCheck(const CTxOut &outIn, const CTransaction &txToIn,
+                 unsigned int nInIn, uint32_t nFlagsIn, bool cacheIn,
+                 DeferredTxData &txdataIn,
+                 TxSigCheckLimiter *pTxLimitSigChecksIn = nullptr,
+                 CheckInputsLimiter *pBlockLimitSigChecksIn = nullptr)
+        : m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn),
+          cacheStore(cacheIn), error(ScriptError::UNKNOWN), txdata(nullptr),
+          deferredTxdata(&txdataIn), pTxLimitSigChecks(pTxLimitSigChecksIn),
+          pBlockLimitSigChecks(pBlockLimitSigChecksIn) {}
+
+    //! Schnorr signatures are batched per script check worker
+    using Batch = SchnorrSignatureBatch;
+
+    bool operator()() { return Check(nullptr); }
+    bool operator()(SchnorrSignatureBatch &batch) { return Check(&batch); }
 
     void swap(CScriptCheck &check) {
         std::swap(ptxTo, check.ptxTo);
@@ -487,6 +597,7 @@ public:
         std::swap(error, check.error);
         std::swap(metrics, check.metrics);
         std::swap(txdata, check.txdata);
+        std::swap(deferredTxdata, check.deferredTxdata);
         std::swap(pTxLimitSigChecks, check.pTxLimitSigChecks);
         std::swap(pBlockLimitSigChecks, check.pBlockLimitSigChecks);
     }
@@ -498,6 +609,29 @@ public:
 
 bool UndoReadFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex);
 
+/**
+ * Get a memory mapping covering at least the first min_size bytes of a block
+ * (or undo) file. Only files the node no longer appends blocks to are mapped.
+ * Returns nullptr if that's not the case or if mapping is disabled.
+ */
+std::shared_ptr<const FlatFileMapping>
+MapFinalizedBlockFile(int nFile, bool undo, uint64_t min_size);
+
+/**
+ * Read a block as serialized on disk, without deserializing it. The bytes are
+ * served from a memory mapping if possible, and copied from the file
+ * otherwise. Only the header is checked, for its proof of work and against
+ * pindex.
+ */
+bool ReadRawBlockFromDisk(FlatFileData &data, const CBlockIndex *pindex,
+                          const Consensus::Params &params);
+
+/**
+ * Read the undo data of a block as serialized on disk (as in CBlockUndo),
+ * after verifying its checksum.
+ */
+bool ReadRawUndoFromDisk(FlatFileData &data, const CBlockIndex *pindex);
+
 /** Functions for validating blocks and updating the block tree */
 
 /**
@@ -601,6 +735,10 @@ private:
                           uint64_t nPruneAfterHeight, int chain_tip_height,
                           bool is_ibd);
 
+    //! Backing storage of the entries of m_block_index, released by Unload()
+    std::optional<BlockIndexMemoryResource>
+        m_block_index_memory_resource GUARDED_BY(cs_main){std::in_place};
+
 public:
     BlockMap m_block_index GUARDED_BY(cs_main);
 
@@ -649,8 +787,15 @@ public:
     /** Clear all data members. */
     void Unload() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    //! Memory used by the block index entries and the map of them
+    size_t DynamicMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     CBlockIndex *AddToBlockIndex(const CBlockHeader &block)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /** Same as above, for a header whose hash is already known. */
+    CBlockIndex *AddToBlockIndex(const CBlockHeader &block,
+                                 const BlockHash &hash)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
     CBlockIndex *InsertBlockIndex(const BlockHash &hash)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -662,10 +807,12 @@ public:
     /**
      * If a block header hasn't already been seen, call CheckBlockHeader on it,
      * ensure that it doesn't descend from an invalid block, and then add it to
-     * m_block_index.
+     * m_block_index. The hash of the header is passed in by the caller so it
+     * can be computed in batches and outside of cs_main.
      */
     bool AcceptBlockHeader(const Config &config, const CBlockHeader &block,
-                           BlockValidationState &state, CBlockIndex **ppindex)
+                           const BlockHash &hash, BlockValidationState &state,
+                           CBlockIndex **ppindex)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     ~BlockManager() { Unload(); }
@@ -847,6 +994,13 @@ public:
     //! The cache size of the in-memory coins view.
     size_t m_coinstip_cache_size_bytes{0};
 
+    /**
+     * Chain written by the background coins write in flight, if any.
+     * ChainStateFlushed is only signalled once that write completed.
+     */
+    std::optional<CBlockLocator>
+        m_background_flush_locator GUARDED_BY(::cs_main);
+
     //! Resize the CoinsViews caches dynamically and flush state to disk.
     //! @returns true unless an error occurred during the flush.
     bool ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
@@ -1245,6 +1399,16 @@ public:
                                 BlockValidationState &state,
                                 const CBlockIndex **ppindex = nullptr)
         LOCKS_EXCLUDED(cs_main);
+    /**
+     * Same as above, for headers whose hashes were already computed, e.g. by
+     * GetBlockHeaderHashes. hashes[i] must be the hash of block[i].
+     */
+    bool ProcessNewBlockHeaders(const Config &config,
+                                const std::vector<CBlockHeader> &block,
+                                const std::vector<BlockHash> &hashes,
+                                BlockValidationState &state,
+                                const CBlockIndex **ppindex = nullptr)
+        LOCKS_EXCLUDED(cs_main);
 
     //! Load the block tree and coins database from disk, initializing state if
     //! we're running with -reindex
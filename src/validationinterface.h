@@ -168,9 +168,11 @@ protected:
      * (ie clients need to handle shutdown/restart safety by being able to
      * understand when some updates were lost due to unclean shutdown).
      *
-     * When this callback is invoked, the validation changes done by any prior
-     * callback are guaranteed to exist on disk and survive a restart, including
-     * an unclean shutdown.
+     * When this callback is invoked, the chain state up to the block described
+     * by the locator is guaranteed to exist on disk and survive a restart,
+     * including an unclean shutdown. The coins may be written in the
+     * background, in which case this is only called once the write
+     * completed, and later blocks may have been connected in the meantime.
      *
      * Provides a locator describing the best chain, which is likely useful for
      * storing current state on disk in client DBs.
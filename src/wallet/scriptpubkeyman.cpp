@@ -9,8 +9,10 @@
 #include <script/descriptor.h>
 #include <script/sign.h>
 #include <util/bip32.h>
+#include <util/parallel.h>
 #include <util/strencodings.h>
 #include <util/string.h>
+#include <util/system.h>
 #include <util/translation.h>
 #include <wallet/scriptpubkeyman.h>
 
@@ -18,6 +20,11 @@
 //! and as a value. See BIP 32 for more details.
 const uint32_t BIP32_HARDENED_KEY_LIMIT = 0x80000000;
 
+//! Number of keys derived at once when topping up a keypool
+static constexpr size_t KEY_DERIVATION_BATCH_SIZE = 4096;
+//! Below this many keys per thread, sharing the derivation isn't worth it
+static constexpr size_t MIN_KEYS_PER_THREAD = 256;
+
 bool LegacyScriptPubKeyMan::GetNewDestination(const OutputType type,
                                               CTxDestination &dest,
                                               std::string &error) {
@@ -290,9 +297,7 @@ bool LegacyScriptPubKeyMan::TopUpInactiveHDChain(const CKeyID seed_id,
 
     if (missing > 0) {
         WalletBatch batch(m_storage.GetDatabase());
-        for (int64_t i = missing; i > 0; --i) {
-            GenerateNewKey(batch, chain, internal);
-        }
+        GenerateNewKeys(batch, chain, internal, missing);
         if (internal) {
             WalletLogPrintf("inactive seed with id %s added %d internal keys\n",
                             HexStr(seed_id), missing);
@@ -1024,21 +1029,14 @@ CPubKey LegacyScriptPubKeyMan::GenerateNewKey(WalletBatch &batch,
     return pubkey;
 }
 
-void LegacyScriptPubKeyMan::DeriveNewChildKey(WalletBatch &batch,
-                                              CKeyMetadata &metadata,
-                                              CKey &secret, CHDChain &hd_chain,
-                                              bool internal) {
+void LegacyScriptPubKeyMan::DeriveHDChainKey(const CHDChain &hd_chain,
+                                             bool internal, CExtKey &masterKey,
+                                             CExtKey &chainChildKey) {
     // for now we use a fixed keypath scheme of m/0'/0'/k
     // seed (256bit)
     CKey seed;
-    // hd master key
-    CExtKey masterKey;
     // key at m/0'
     CExtKey accountKey;
-    // key at m/0'/0' (external) or m/0'/1' (internal)
-    CExtKey chainChildKey;
-    // key at m/0'/0'/<n>'
-    CExtKey childKey;
 
     // try to get the seed
     if (!GetKey(hd_chain.seed_id, seed)) {
@@ -1056,6 +1054,20 @@ void LegacyScriptPubKeyMan::DeriveNewChildKey(WalletBatch &batch,
     assert(internal ? m_storage.CanSupportFeature(FEATURE_HD_SPLIT) : true);
     accountKey.Derive(chainChildKey,
                       BIP32_HARDENED_KEY_LIMIT + (internal ? 1 : 0));
+}
+
+void LegacyScriptPubKeyMan::DeriveNewChildKey(WalletBatch &batch,
+                                              CKeyMetadata &metadata,
+                                              CKey &secret, CHDChain &hd_chain,
+                                              bool internal) {
+    // hd master key
+    CExtKey masterKey;
+    // key at m/0'/0' (external) or m/0'/1' (internal)
+    CExtKey chainChildKey;
+    // key at m/0'/0'/<n>'
+    CExtKey childKey;
+
+    DeriveHDChainKey(hd_chain, internal, masterKey, chainChildKey);
 
     // derive child key at next index, skip keys already known to the wallet
     do {
@@ -1099,6 +1111,93 @@ void LegacyScriptPubKeyMan::DeriveNewChildKey(WalletBatch &batch,
     }
 }
 
+std::vector<CPubKey> LegacyScriptPubKeyMan::GenerateNewKeys(WalletBatch &batch,
+                                                           CHDChain &hd_chain,
+                                                           bool internal,
+                                                           size_t count) {
+    AssertLockHeld(cs_KeyStore);
+    std::vector<CPubKey> pubkeys;
+    pubkeys.reserve(count);
+    if (!IsHDEnabled() || count == 0) {
+        while (pubkeys.size() < count) {
+            pubkeys.push_back(GenerateNewKey(batch, hd_chain, internal));
+        }
+        return pubkeys;
+    }
+    assert(!m_storage.IsWalletFlagSet(WALLET_FLAG_DISABLE_PRIVATE_KEYS));
+    assert(!m_storage.IsWalletFlagSet(WALLET_FLAG_BLANK_WALLET));
+
+    internal = m_storage.CanSupportFeature(FEATURE_HD_SPLIT) && internal;
+    CExtKey masterKey;
+    CExtKey chainChildKey;
+    DeriveHDChainKey(hd_chain, internal, masterKey, chainChildKey);
+    CKeyID master_id = masterKey.key.GetPubKey().GetID();
+    uint32_t &counter = internal ? hd_chain.nInternalChainCounter
+                                 : hd_chain.nExternalChainCounter;
+
+    if (m_storage.CanSupportFeature(FEATURE_COMPRPUBKEY)) {
+        m_storage.SetMinVersion(FEATURE_COMPRPUBKEY);
+    }
+
+    while (pubkeys.size() < count) {
+        // Bound the number of private keys held at once.
+        const size_t batch_size =
+            std::min(count - pubkeys.size(), KEY_DERIVATION_BATCH_SIZE);
+        std::vector<CExtKey> children;
+        chainChildKey.DeriveRange(children, counter | BIP32_HARDENED_KEY_LIMIT,
+                                  batch_size);
+        std::vector<CPubKey> child_pubkeys(batch_size);
+        std::vector<uint8_t> verified(batch_size);
+        const auto derive = [&](size_t i) {
+            child_pubkeys[i] = children[i].key.GetPubKey();
+            verified[i] = children[i].key.VerifyPubKey(child_pubkeys[i]);
+        };
+        ParallelFor(batch_size, GetNumCores(), MIN_KEYS_PER_THREAD, derive);
+
+        // Like DeriveNewChildKey, skip keys already known to the wallet and
+        // update the chain model before adding the keys.
+        const uint32_t first_index = counter;
+        counter += batch_size;
+        if (hd_chain.seed_id == m_hd_chain.seed_id &&
+            !batch.WriteHDChain(hd_chain)) {
+            throw std::runtime_error(std::string(__func__) +
+                                     ": writing HD chain model failed");
+        }
+        const int64_t nCreationTime = GetTime();
+        for (size_t i = 0; i < batch_size; ++i) {
+            const CPubKey &pubkey = child_pubkeys[i];
+            if (HaveKey(pubkey.GetID())) {
+                continue;
+            }
+            assert(verified[i]);
+
+            const uint32_t index = first_index + i;
+            CKeyMetadata metadata(nCreationTime);
+            metadata.hdKeypath = std::string("m/0'/") +
+                                 (internal ? "1'/" : "0'/") + ToString(index) +
+                                 "'";
+            metadata.key_origin.path.push_back(0 | BIP32_HARDENED_KEY_LIMIT);
+            metadata.key_origin.path.push_back((internal ? 1 : 0) |
+                                               BIP32_HARDENED_KEY_LIMIT);
+            metadata.key_origin.path.push_back(index |
+                                               BIP32_HARDENED_KEY_LIMIT);
+            metadata.hd_seed_id = hd_chain.seed_id;
+            std::copy(master_id.begin(), master_id.begin() + 4,
+                      metadata.key_origin.fingerprint);
+            metadata.has_key_origin = true;
+
+            mapKeyMetadata[pubkey.GetID()] = metadata;
+            UpdateTimeFirstKey(nCreationTime);
+            if (!AddKeyPubKeyWithDB(batch, children[i].key, pubkey)) {
+                throw std::runtime_error(std::string(__func__) +
+                                         ": AddKey failed");
+            }
+            pubkeys.push_back(pubkey);
+        }
+    }
+    return pubkeys;
+}
+
 void LegacyScriptPubKeyMan::LoadKeyPool(int64_t nIndex,
                                         const CKeyPool &keypool) {
     LOCK(cs_KeyStore);
@@ -1245,15 +1344,13 @@ bool LegacyScriptPubKeyMan::TopUp(unsigned int kpSize) {
             // don't create extra internal keys
             missingInternal = 0;
         }
-        bool internal = false;
         WalletBatch batch(m_storage.GetDatabase());
-        for (int64_t i = missingInternal + missingExternal; i--;) {
-            if (i < missingInternal) {
-                internal = true;
+        for (const bool internal : {false, true}) {
+            for (const CPubKey &pubkey : GenerateNewKeys(
+                     batch, m_hd_chain, internal,
+                     internal ? missingInternal : missingExternal)) {
+                AddKeypoolPubkeyWithDB(pubkey, internal, batch);
             }
-
-            CPubKey pubkey(GenerateNewKey(batch, m_hd_chain, internal));
-            AddKeypoolPubkeyWithDB(pubkey, internal, batch);
         }
         if (missingInternal + missingExternal > 0) {
             WalletLogPrintf(
@@ -1816,18 +1913,53 @@ bool DescriptorScriptPubKeyMan::TopUp(unsigned int size) {
 
     WalletBatch batch(m_storage.GetDatabase());
     uint256 id = GetID();
-    for (int32_t i = m_max_cached_index + 1; i < new_range_end; ++i) {
+
+    //! One expanded index of the descriptor
+    struct Expansion {
+        bool ok{false};
         FlatSigningProvider out_keys;
         std::vector<CScript> scripts_temp;
         DescriptorCache temp_cache;
-        // Maybe we have a cached xpub and we can expand from the cache first
-        if (!m_wallet_descriptor.descriptor->ExpandFromCache(
-                i, m_wallet_descriptor.cache, scripts_temp, out_keys)) {
-            if (!m_wallet_descriptor.descriptor->Expand(
-                    i, provider, scripts_temp, out_keys, &temp_cache)) {
-                return false;
-            }
+    };
+    std::vector<Expansion> expansions;
+    const int32_t range_start = m_max_cached_index + 1;
+    for (int32_t i = range_start; i < new_range_end; ++i) {
+        if (expansions.empty()) {
+            // Expand the next indexes in parallel. The first one is expanded
+            // alone, so that it fills the xpub cache for the others.
+            const int32_t first = i;
+            const size_t batch_size =
+                i == range_start
+                    ? 1
+                    : std::min<size_t>(new_range_end - i,
+                                       KEY_DERIVATION_BATCH_SIZE);
+            const Descriptor &descriptor = *m_wallet_descriptor.descriptor;
+            const DescriptorCache &cache = m_wallet_descriptor.cache;
+            expansions.resize(batch_size);
+            const auto expand = [&](size_t n) {
+                Expansion &expansion = expansions[n];
+                // Maybe we have a cached xpub and we can expand from the
+                // cache first
+                expansion.ok =
+                    descriptor.ExpandFromCache(first + int32_t(n), cache,
+                                               expansion.scripts_temp,
+                                               expansion.out_keys) ||
+                    descriptor.Expand(
+                        first + int32_t(n), provider, expansion.scripts_temp,
+                        expansion.out_keys, &expansion.temp_cache);
+            };
+            ParallelFor(batch_size, GetNumCores(), MIN_KEYS_PER_THREAD,
+                        expand);
+            std::reverse(expansions.begin(), expansions.end());
+        }
+        Expansion expansion = std::move(expansions.back());
+        expansions.pop_back();
+        if (!expansion.ok) {
+            return false;
         }
+        const FlatSigningProvider &out_keys = expansion.out_keys;
+        const std::vector<CScript> &scripts_temp = expansion.scripts_temp;
+        const DescriptorCache &temp_cache = expansion.temp_cache;
         // Add all of the scriptPubKeys to the scriptPubKey set
         for (const CScript &script : scripts_temp) {
             m_map_script_pub_keys[script] = i;
@@ -385,6 +385,20 @@ private:
                            bool internal = false)
         EXCLUSIVE_LOCKS_REQUIRED(cs_KeyStore);
 
+    /* HD derive the master key and the internal or external chain key */
+    void DeriveHDChainKey(const CHDChain &hd_chain, bool internal,
+                          CExtKey &masterKey, CExtKey &chainChildKey)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_KeyStore);
+
+    /**
+     * Generate count new keys, like as many GenerateNewKey calls. HD keys
+     * are derived in batches, and their public keys computed in parallel.
+     */
+    std::vector<CPubKey> GenerateNewKeys(WalletBatch &batch,
+                                         CHDChain &hd_chain, bool internal,
+                                         size_t count)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_KeyStore);
+
     std::set<int64_t> setInternalKeyPool GUARDED_BY(cs_KeyStore);
     std::set<int64_t> setExternalKeyPool GUARDED_BY(cs_KeyStore);
     std::set<int64_t> set_pre_split_keypool GUARDED_BY(cs_KeyStore);
@@ -6,11 +6,14 @@
 #include <key.h>
 #include <script/standard.h>
 #include <test/util/setup_common.h>
+#include <util/parallel.h>
 #include <wallet/scriptpubkeyman.h>
 #include <wallet/wallet.h>
 
 #include <boost/test/unit_test.hpp>
 
+#include <map>
+
 BOOST_FIXTURE_TEST_SUITE(scriptpubkeyman_tests, BasicTestingSetup)
 
 // Test LegacyScriptPubKeyMan::CanProvide behavior, making sure it returns true
@@ -41,4 +44,62 @@ BOOST_AUTO_TEST_CASE(CanProvide) {
     BOOST_CHECK(keyman.CanProvide(p2sh_script, data));
 }
 
+//! Top up the keypool of a legacy wallet with the given seed to half of size
+//! and then to size, and return the keypool index of each key.
+static std::map<CKeyID, int64_t> TopUpKeypool(const CKey &seed,
+                                              unsigned int size) {
+    NodeContext node;
+    std::unique_ptr<interfaces::Chain> chain =
+        interfaces::MakeChain(node, Params());
+    CWallet wallet(chain.get(), "", CreateDummyWalletDatabase());
+    wallet.SetMinVersion(FEATURE_LATEST);
+    LegacyScriptPubKeyMan &keyman = *wallet.GetOrCreateLegacyScriptPubKeyMan();
+    keyman.SetHDSeed(keyman.DeriveNewSeed(seed));
+    BOOST_CHECK(keyman.TopUp(size / 2));
+    BOOST_CHECK(keyman.TopUp(size));
+    return keyman.GetAllReserveKeys();
+}
+
+// Test that the keys topping up a legacy keypool, which are derived in
+// batches and on several threads, are the ones DeriveNewChildKey derives one
+// at a time, in the same keypool order.
+BOOST_AUTO_TEST_CASE(TopUpDerivation) {
+    CKey seed;
+    seed.MakeNewKey(true);
+    // Large enough for the derivation to be shared between threads.
+    constexpr unsigned int KEYPOOL_SIZE = 600;
+
+    // Derive m/0'/0'/k' and m/0'/1'/k' the way DeriveNewChildKey does, the
+    // external keys being added to the keypool first.
+    constexpr uint32_t HARDENED = 0x80000000;
+    CExtKey master;
+    master.SetSeed(seed.begin(), seed.size());
+    CExtKey account;
+    BOOST_REQUIRE(master.Derive(account, HARDENED));
+    std::map<CKeyID, int64_t> expected;
+    int64_t index = 0;
+    uint32_t counters[2] = {0, 0};
+    for (const unsigned int target : {KEYPOOL_SIZE / 2, KEYPOOL_SIZE}) {
+        for (const uint32_t internal : {0, 1}) {
+            CExtKey chain_key;
+            BOOST_REQUIRE(account.Derive(chain_key, HARDENED | internal));
+            for (uint32_t &counter = counters[internal]; counter < target;
+                 ++counter) {
+                CExtKey child;
+                BOOST_REQUIRE(chain_key.Derive(child, HARDENED | counter));
+                expected[child.key.GetPubKey().GetID()] = ++index;
+            }
+        }
+    }
+    BOOST_CHECK_EQUAL(expected.size(), 2 * KEYPOOL_SIZE);
+
+    BOOST_CHECK(TopUpKeypool(seed, KEYPOOL_SIZE) == expected);
+
+    // Same without any thread to share the derivation with.
+    const size_t parallel_workers = GetParallelWorkers();
+    StopParallelWorkers();
+    BOOST_CHECK(TopUpKeypool(seed, KEYPOOL_SIZE) == expected);
+    StartParallelWorkers(parallel_workers);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -72,6 +72,8 @@ class NngInterfaceTest(BitcoinTestFramework):
             await self._test_get_block_slice_errors(rpc_sock)
             await self._test_send_tx(node, rpc_sock)
             await self._test_get_block_range(node, rpc_sock)
+            await self._test_get_raw_block_range(node, rpc_sock)
+        self._test_rpc_metrics(node)
         with pynng.Sub0() as pub_sock:
             pub_sock.dial(PUB_URL)
             await self._test_update_chain_tip(node, pub_sock)
@@ -81,6 +83,7 @@ class NngInterfaceTest(BitcoinTestFramework):
             await self._test_block_connected(node, pub_sock)
             await self._test_block_disconnected(node, pub_sock)
             await self._test_chain_state_flushed(node, pub_sock)
+        self._test_pub_metrics(node)
         self._test_invalid_params(node)
 
     def _make_get_block_request_fbb(self, *, height=None, blockhash=None):
@@ -139,6 +142,26 @@ class NngInterfaceTest(BitcoinTestFramework):
         fbb.Finish(rpc)
         return bytes(fbb.Output())
 
+    def _make_get_raw_block_range_request_fbb(self, start_height, num_blocks, max_bytes=0):
+        from NngInterface import (
+            RpcCall,
+            RpcRequest,
+            GetRawBlockRangeRequest,
+        )
+        import flatbuffers
+        fbb = flatbuffers.Builder()
+        GetRawBlockRangeRequest.Start(fbb)
+        GetRawBlockRangeRequest.AddStartHeight(fbb, start_height)
+        GetRawBlockRangeRequest.AddNumBlocks(fbb, num_blocks)
+        GetRawBlockRangeRequest.AddMaxBytes(fbb, max_bytes)
+        get_raw_block_range_request = GetRawBlockRangeRequest.End(fbb)
+        RpcCall.Start(fbb)
+        RpcCall.AddRpcType(fbb, RpcRequest.RpcRequest.GetRawBlockRangeRequest)
+        RpcCall.AddRpc(fbb, get_raw_block_range_request)
+        rpc = RpcCall.End(fbb)
+        fbb.Finish(rpc)
+        return bytes(fbb.Output())
+
     def _make_get_block_slice_request_fbb(self, file_num, data_pos, num_bytes):
         from NngInterface import (
             RpcCall,
@@ -179,7 +202,38 @@ class NngInterfaceTest(BitcoinTestFramework):
         fbb.Finish(rpc)
         return bytes(fbb.Output())
 
-    def _make_get_mempool_request_fbs(self):
+    def _make_get_slices_request_fbb(self, slices):
+        from NngInterface import (
+            RpcCall,
+            RpcRequest,
+            GetSlicesRequest,
+            Slice,
+        )
+        import flatbuffers
+        fbb = flatbuffers.Builder()
+        slice_offsets = []
+        for file_type, file_num, pos, num_bytes in slices:
+            Slice.Start(fbb)
+            Slice.AddFile(fbb, file_type)
+            Slice.AddFileNum(fbb, file_num)
+            Slice.AddPos(fbb, pos)
+            Slice.AddNumBytes(fbb, num_bytes)
+            slice_offsets.append(Slice.End(fbb))
+        GetSlicesRequest.StartSlicesVector(fbb, len(slice_offsets))
+        for slice_offset in reversed(slice_offsets):
+            fbb.PrependUOffsetTRelative(slice_offset)
+        slices_vector = fbb.EndVector()
+        GetSlicesRequest.Start(fbb)
+        GetSlicesRequest.AddSlices(fbb, slices_vector)
+        get_slices_request = GetSlicesRequest.End(fbb)
+        RpcCall.Start(fbb)
+        RpcCall.AddRpcType(fbb, RpcRequest.RpcRequest.GetSlicesRequest)
+        RpcCall.AddRpc(fbb, get_slices_request)
+        rpc = RpcCall.End(fbb)
+        fbb.Finish(rpc)
+        return bytes(fbb.Output())
+
+    def _make_get_mempool_request_fbs(self, start_entry_sequence=0, max_txs=0):
         from NngInterface import (
             RpcCall,
             RpcRequest,
@@ -188,6 +242,8 @@ class NngInterfaceTest(BitcoinTestFramework):
         import flatbuffers
         fbb = flatbuffers.Builder()
         GetMempoolRequest.Start(fbb)
+        GetMempoolRequest.AddStartEntrySequence(fbb, start_entry_sequence)
+        GetMempoolRequest.AddMaxTxs(fbb, max_txs)
         get_mempool_request = GetMempoolRequest.End(fbb)
         RpcCall.Start(fbb)
         RpcCall.AddRpcType(fbb, RpcRequest.RpcRequest.GetMempoolRequest)
@@ -299,6 +355,29 @@ class NngInterfaceTest(BitcoinTestFramework):
         # num_bytes too long
         await self._send_request(rpc_sock, self._make_get_block_slice_request_fbb(1, 0, 1000))
         await self._recv_response(rpc_sock, expect_error='Invalid block slice')
+        # num_bytes too large to be sent, for both block and undo slices
+        for make_request in (self._make_get_block_slice_request_fbb,
+                             self._make_get_undo_slice_request_fbb):
+            for num_bytes in ((32 << 20) + 1, 0xffffffff):
+                await self._send_request(rpc_sock, make_request(0, 0, num_bytes))
+                await self._recv_response(rpc_sock, expect_error='Slices exceed 32 MiB')
+        # the node is still up and serving slices
+        await self._send_request(rpc_sock, self._make_get_block_slice_request_fbb(0, 0, 10))
+        await self._recv_response(rpc_sock)
+        self.nodes[0].getblockcount()
+        # one of many slices out of bounds
+        from NngInterface.SliceFile import SliceFile
+        await self._send_request(rpc_sock, self._make_get_slices_request_fbb(
+            [(SliceFile.Block, 0, 0, 10), (SliceFile.Block, 0, 1000000000, 10)]))
+        await self._recv_response(rpc_sock, expect_error='Invalid block slice')
+        # undo file doesn't exist
+        await self._send_request(rpc_sock, self._make_get_slices_request_fbb(
+            [(SliceFile.Undo, 1, 0, 10)]))
+        await self._recv_response(rpc_sock, expect_error='Invalid block slice')
+        # too large in total
+        await self._send_request(rpc_sock, self._make_get_slices_request_fbb(
+            [(SliceFile.Block, 0, 0, 20 << 20), (SliceFile.Block, 0, 0, 20 << 20)]))
+        await self._recv_response(rpc_sock, expect_error='Slices exceed 32 MiB')
 
     async def _test_send_tx(self, node, rpc_sock):
         from NngInterface import (
@@ -397,6 +476,24 @@ class NngInterfaceTest(BitcoinTestFramework):
         assert_equal(spent_coin.Height(), -1)
         assert_equal(other_tx_fbb.Time(), self.TIMESTAMP)
 
+        # Txs are returned in the order they entered the mempool, and can be
+        # fetched one page at a time
+        assert_equal(bytes(response.Txs(0).Tx().Txid().Hash().Data()[::-1]).hex(), tx.txid_hex)
+        assert_equal(response.NextEntrySequence(), response.Txs(1).EntrySequence() + 1)
+        next_entry_sequence = 0
+        for expected_tx in [tx, other_tx]:
+            await self._send_request(rpc_sock, self._make_get_mempool_request_fbs(next_entry_sequence, 1))
+            response = await self._recv_response(rpc_sock)
+            response = GetMempoolResponse.GetMempoolResponse.GetRootAs(response, 0)
+            assert_equal(response.TxsLength(), 1)
+            assert_equal(get_fb_bytes(response.Txs(0).Tx(), 'Raw').hex(), expected_tx.serialize().hex())
+            next_entry_sequence = response.NextEntrySequence()
+        await self._send_request(rpc_sock, self._make_get_mempool_request_fbs(next_entry_sequence, 1))
+        response = await self._recv_response(rpc_sock)
+        response = GetMempoolResponse.GetMempoolResponse.GetRootAs(response, 0)
+        assert_equal(response.TxsLength(), 0)
+        assert_equal(response.NextEntrySequence(), next_entry_sequence)
+
         # Mine tx
         hashes = node.generatetoaddress(1, self.burn_addr)
         # Mempool empty again
@@ -448,6 +545,24 @@ class NngInterfaceTest(BitcoinTestFramework):
         await self._check_undo_slice(rpc_sock, block.FileNum(), block.Txs(1).UndoPos(), undo_data)
         undo_data = bytes.fromhex('01805e00808de81a0169d7ef8f42a25e8791bb37d5fb48456f10')
         await self._check_undo_slice(rpc_sock, block.FileNum(), block.Txs(2).UndoPos(), undo_data)
+        # Fetch all of the above at once, out of order and with gaps
+        from NngInterface import GetSlicesResponse
+        from NngInterface.SliceFile import SliceFile
+        undo_data1 = bytes.fromhex('010300806e01da1745e9b549bd0bfa1a569971c77eba30cd5a4b')
+        slices = [
+            (SliceFile.Undo, block.Txs(2).UndoPos(), undo_data),
+            (SliceFile.Block, block.Txs(2).DataPos(), tx2_raw),
+            (SliceFile.Block, block.Txs(0).DataPos(), tx0_raw),
+            (SliceFile.Undo, block.Txs(1).UndoPos(), undo_data1),
+            (SliceFile.Block, block.Txs(1).DataPos() + 4, tx1_raw[4:20]),
+            (SliceFile.Block, block.Txs(1).DataPos(), tx1_raw),
+        ]
+        await self._send_request(rpc_sock, self._make_get_slices_request_fbb(
+            [(file_type, block.FileNum(), pos, len(data)) for file_type, pos, data in slices]))
+        response = await self._recv_response(rpc_sock)
+        response = GetSlicesResponse.GetSlicesResponse.GetRootAs(response, 0)
+        assert_equal(get_fb_bytes(response, 'Data').hex(),
+                     b''.join(data for _, _, data in slices).hex())
         
         assert_equal(block.Txs(1).Tx().SpentCoinsLength(), 1)
         spent_coin = block.Txs(1).Tx().SpentCoins(0)
@@ -485,6 +600,43 @@ class NngInterfaceTest(BitcoinTestFramework):
         response = GetBlockRangeResponse.GetBlockRangeResponse.GetRootAs(response, 0)
         assert_equal(response.BlocksLength(), 12)
 
+    async def _test_get_raw_block_range(self, node, rpc_sock):
+        from NngInterface import GetRawBlockRangeResponse
+        for start_height, num_blocks in [(0, 10), (10, 30), (100, 5)]:
+            await self._send_request(rpc_sock, self._make_get_raw_block_range_request_fbb(start_height, num_blocks))
+            response = await self._recv_response(rpc_sock)
+            response = GetRawBlockRangeResponse.GetRawBlockRangeResponse.GetRootAs(response, 0)
+            assert_equal(response.BlocksLength(), num_blocks)
+            assert_equal(response.NextHeight(), start_height + num_blocks)
+            for idx in range(num_blocks):
+                block_hash = node.getblockhash(start_height + idx)
+                block = response.Blocks(idx)
+                assert_equal(bytes(block.BlockHash().Hash().Data())[::-1].hex(), block_hash)
+                assert_equal(block.Height(), start_height + idx)
+                assert_equal(get_fb_bytes(block, 'Raw').hex(), node.getblock(block_hash, 0))
+                # Only the genesis block has no undo data
+                assert_equal(block.RawUndoLength() == 0, start_height + idx == 0)
+        # negative index -> empty list
+        await self._send_request(rpc_sock, self._make_get_raw_block_range_request_fbb(-1, 4))
+        response = await self._recv_response(rpc_sock)
+        response = GetRawBlockRangeResponse.GetRawBlockRangeResponse.GetRootAs(response, 0)
+        assert_equal(response.BlocksLength(), 0)
+        # too many blocks -> rest cut off
+        await self._send_request(rpc_sock, self._make_get_raw_block_range_request_fbb(100, 30))
+        response = await self._recv_response(rpc_sock)
+        response = GetRawBlockRangeResponse.GetRawBlockRangeResponse.GetRootAs(response, 0)
+        assert_equal(response.BlocksLength(), 12)
+        assert_equal(response.NextHeight(), 112)
+        # tiny max_bytes -> stream the range one block at a time
+        next_height = 5
+        while next_height < 8:
+            await self._send_request(rpc_sock, self._make_get_raw_block_range_request_fbb(next_height, 8 - next_height, 1))
+            response = await self._recv_response(rpc_sock)
+            response = GetRawBlockRangeResponse.GetRawBlockRangeResponse.GetRootAs(response, 0)
+            assert_equal(response.BlocksLength(), 1)
+            assert_equal(response.Blocks(0).Height(), next_height)
+            next_height = response.NextHeight()
+
     async def _recv_message(self, pub_sock, expected_msg_type, timeout=2):
         received_msg = await asyncio.wait_for(pub_sock.arecv_msg(), timeout=timeout)
         actual_msg_type = received_msg.bytes[:12]
@@ -657,14 +809,43 @@ class NngInterfaceTest(BitcoinTestFramework):
         assert_equal(bytes(msg.BlockHash().Hash().Data())[::-1].hex(), tip)
         pub_sock.unsubscribe('chainstflush')
 
+    def _test_rpc_metrics(self, node):
+        rpc_info = node.getnnginfo()['rpc']
+        assert_equal(rpc_info['workers'], 64)
+        methods = rpc_info['methods']
+        for method in ['GetBlock', 'GetBlockRange', 'GetBlockSlice', 'GetUndoSlice',
+                       'GetMempool', 'GetRawBlockRange', 'GetSlices']:
+            assert methods[method]['calls'] > 0
+            # Each call lands in exactly one bucket of each histogram
+            assert_equal(sum(methods[method]['latency_us'].values()), methods[method]['calls'])
+            assert_equal(sum(methods[method]['response_bytes'].values()), methods[method]['calls'])
+        # Two 'Block not found' errors, plus the ones in _test_send_tx
+        assert methods['GetBlock']['errors'] >= 2
+        assert methods['GetBlockSlice']['errors'] >= 3
+        # The invalid flatbuffer
+        assert_equal(methods['Invalid']['calls'], 1)
+        assert_equal(methods['Invalid']['errors'], 1)
+
+    def _test_pub_metrics(self, node):
+        pub_info = node.getnnginfo()['pub']
+        assert pub_info['published'] > 0
+        assert pub_info['maxqueuedepth'] > 0
+        assert_equal(pub_info['dropped'], 0)
+
     def _test_invalid_params(self, node):
         self.stop_node(0)
         node.assert_start_raises_init_error(
             ["-nngrpc=a"], "Error: Failed listening on -nngrpc=a: Invalid argument")
+        node.assert_start_raises_init_error(
+            [f"-nngrpc={RPC_URL}", "-nngrpcworkers=0"], "Error: Invalid -nngrpcworkers=0, must be positive.")
         node.assert_start_raises_init_error(
             ["-nngpub=a"], "Error: Failed listening on -nngpub=a: Invalid argument")
         node.assert_start_raises_init_error(
             [f"-nngpub={PUB_URL}", "-nngpubmsg=a"], "Error: Invalid message type 'a' in -nngpubmsg.")
+        node.assert_start_raises_init_error(
+            [f"-nngpub={PUB_URL}", "-nngpubqueuesize=0"], "Error: Invalid -nngpubqueuesize=0, must be positive.")
+        node.assert_start_raises_init_error(
+            [f"-nngpub={PUB_URL}", "-nngpubpolicy=a"], "Error: Invalid -nngpubpolicy 'a', must be 'block' or 'drop'.")
 
 if __name__ == '__main__':
     NngInterfaceTest().main()
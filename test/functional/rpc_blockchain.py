@@ -65,6 +65,8 @@ class BlockchainTest(BitcoinTestFramework):
         self._test_getblockheader()
         self._test_getdifficulty()
         self._test_getnetworkhashps()
+        self._test_getscriptcacheinfo()
+        self._test_scriptprofile()
         self._test_stopatheight()
         self._test_waitforblockheight()
         if self.is_wallet_compiled():
@@ -306,6 +308,49 @@ class BlockchainTest(BitcoinTestFramework):
         # binary => decimal => binary math is why we do this check
         assert abs(difficulty * 2**31 - 1) < 0.0001
 
+    def _test_getscriptcacheinfo(self):
+        self.log.info("Test getscriptcacheinfo")
+        info = self.nodes[0].getscriptcacheinfo()
+        stats_keys = ['capacity', 'evictions', 'hits', 'inserts', 'misses']
+        assert_equal(sorted(info.keys()), stats_keys + ['taprootcommitments'])
+        for stats in [info, info['taprootcommitments']]:
+            assert_equal(sorted(stats.keys()), stats_keys)
+            assert_greater_than(stats['capacity'], 0)
+            assert_greater_than_or_equal(stats['inserts'], stats['evictions'])
+
+    def _test_scriptprofile(self):
+        self.log.info("Test getblockscriptprofile and gettxscriptprofile")
+        node = self.nodes[0]
+        # Blocks only contain their coinbase, which has no scripts to verify
+        profile = node.getblockscriptprofile(200)
+        assert_equal(profile['inputs'], 0)
+        assert_equal(profile['top'], [])
+        assert_equal(node.getblockscriptprofile(node.getblockhash(200)),
+                     profile)
+        assert_raises_rpc_error(-8, "Negative count",
+                                node.getblockscriptprofile, 200, -1)
+        assert_raises_rpc_error(-8, "Target block height 201 after current "
+                                "tip 200", node.getblockscriptprofile, 201)
+
+        # Spend a coinbase output without signing it
+        coinbase = node.getblock(node.getblockhash(1), 2)['tx'][0]
+        vout = next(out for out in coinbase['vout']
+                    if out['scriptPubKey']['type'] != 'nulldata')
+        raw_tx = node.createrawtransaction(
+            [{'txid': coinbase['txid'], 'vout': vout['n']}],
+            {node.get_deterministic_priv_key().address: 1})
+        profile = node.gettxscriptprofile(raw_tx)
+        assert_equal(profile['inputs'], 1)
+        assert_equal(len(profile['top']), 1)
+        top = profile['top'][0]
+        assert_equal(top['txid'], node.decoderawtransaction(raw_tx)['txid'])
+        assert_equal(top['vin'], 0)
+        assert_equal(top['valid'], False)
+        assert 'error' in top
+        assert_equal(node.gettxscriptprofile(raw_tx, 0)['top'], [])
+        assert_raises_rpc_error(-22, "TX decode failed",
+                                node.gettxscriptprofile, "00")
+
     def _test_getnetworkhashps(self):
         hashes_per_second = self.nodes[0].getnetworkhashps()
         # This should be 2 hashes every 10 minutes or 1/300
@@ -111,7 +111,12 @@ class HelpRpcTest(BitcoinTestFramework):
         titles = [line[3:-3]
                   for line in node.help().splitlines() if line.startswith('==')]
         components = ['Avalanche', 'Blockchain', 'Control', 'Generating',
-                      'Mining', 'Network', 'Rawtransactions', 'Util']
+                      'Mining', 'Network']
+
+        if self.is_nng_interface_compiled():
+            components.append('Nng')
+
+        components += ['Rawtransactions', 'Util']
 
         if self.is_wallet_compiled():
             components.append('Wallet')